@@ -0,0 +1,20 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 fragUv;
+layout(location = 1) in vec3 fragColor;
+layout(location = 2) flat in int fragTextureIndex;
+
+layout (location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+void main()
+{
+	vec4 color = vec4(fragColor, 1.0);
+	if (fragTextureIndex >= 0)
+	{
+		color *= texture(textures[nonuniformEXT(fragTextureIndex)], fragUv);
+	}
+	outColor = color;
+}
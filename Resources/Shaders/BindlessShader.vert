@@ -0,0 +1,25 @@
+#version 450
+
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec3 color;
+
+// Per instance, from the instance buffer
+layout(location = 2) in vec2 instanceTransform0;
+layout(location = 3) in vec2 instanceTransform1;
+layout(location = 4) in vec2 instanceOffset;
+layout(location = 5) in vec3 instanceColor;
+layout(location = 6) in int instanceTextureIndex;
+
+layout(location = 0) out vec2 fragUv;
+layout(location = 1) out vec3 fragColor;
+layout(location = 2) flat out int fragTextureIndex;
+
+void main()
+{
+	mat2 transform = mat2(instanceTransform0, instanceTransform1);
+	gl_Position = vec4(transform * position + instanceOffset, 0.0, 1.0);
+	// Models have no uv yet, map the model space [-0.5, 0.5] square to [0, 1]
+	fragUv = position + vec2(0.5);
+	fragColor = instanceColor;
+	fragTextureIndex = instanceTextureIndex;
+}
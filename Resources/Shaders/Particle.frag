@@ -0,0 +1,17 @@
+#version 450
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragCorner;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	// Round, soft edged sprite
+	float distanceSquared = dot(fragCorner, fragCorner);
+	if (distanceSquared > 1.0)
+	{
+		discard;
+	}
+	outColor = vec4(fragColor.rgb, fragColor.a * (1.0 - distanceSquared));
+}
@@ -0,0 +1,33 @@
+#version 450
+
+struct Particle
+{
+	vec2 position;
+	vec2 velocity;
+	float life;
+	float maxLife;
+	uint color;
+	float size;
+};
+
+// Particles of the last simulated step
+layout(std430, set = 0, binding = 0) readonly buffer Particles { Particle particles[]; };
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragCorner;
+
+const vec2 CORNERS[6] = vec2[](
+	vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+	vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main()
+{
+	Particle particle = particles[gl_InstanceIndex];
+	vec2 corner = CORNERS[gl_VertexIndex];
+	gl_Position = vec4(particle.position + corner * particle.size, 0.0, 1.0);
+
+	// Fades out over its life
+	fragColor = unpackUnorm4x8(particle.color);
+	fragColor.a *= clamp(particle.life / particle.maxLife, 0.0, 1.0);
+	fragCorner = corner;
+}
@@ -3,14 +3,18 @@
 layout(location = 0) in vec2 position;
 layout(location = 1) in vec3 color;
 
-layout(push_constant) uniform Push
-{
-	mat2 transform;
-	vec2 offset;
-	vec3 color;
-}push;
+// Per instance, from the instance buffer
+layout(location = 2) in vec2 instanceTransform0;
+layout(location = 3) in vec2 instanceTransform1;
+layout(location = 4) in vec2 instanceOffset;
+layout(location = 5) in vec3 instanceColor;
+layout(location = 6) in int instanceTextureIndex;
+
+layout(location = 0) out vec3 fragColor;
 
 void main()
 {
-	gl_Position = vec4(push.transform * position + push.offset, 0.0, 1.0);
+	mat2 transform = mat2(instanceTransform0, instanceTransform1);
+	gl_Position = vec4(transform * position + instanceOffset, 0.0, 1.0);
+	fragColor = instanceColor;
 }
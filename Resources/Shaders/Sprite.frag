@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in vec2 fragUv;
+layout(location = 1) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	outColor = fragColor;
+}
@@ -0,0 +1,25 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 fragUv;
+layout(location = 1) in vec4 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+// One texture per batch
+layout(push_constant) uniform Push
+{
+	int textureIndex;
+}push;
+
+void main()
+{
+	vec4 color = fragColor;
+	if (push.textureIndex >= 0)
+	{
+		color *= texture(textures[nonuniformEXT(push.textureIndex)], fragUv);
+	}
+	outColor = color;
+}
@@ -1,5 +1,9 @@
 #include "../Public/App.h"
 #include "../Public/RenderSystem.h"
+#include "../Public/ParticleSystem.h"
+#include "../Public/SpriteBatcher.h"
+#include "../Public/SceneHierarchy.h"
+#include "../Public/SceneFile.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -8,12 +12,24 @@
 
 #include <stdexcept>
 #include <array>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <cctype>
 
 namespace Application
 {
 	App::App()
 	{
+		if (device.SupportsBindless())
+		{
+			bindless = std::make_unique<BindlessDescriptors>(device);
+		}
 		LoadGameObjects();
+		ImportMeshes();
+		StreamTextures();
 	}
 
 	App::~App()
@@ -22,22 +38,256 @@ namespace Application
 
 	void App::Run()
 	{
-		RenderSystem renderSystem{device, renderer.GetSwapChainRenderPass()};
+		RenderSystem renderSystem{device, renderer.GetSwapChainRenderTarget(), bindless.get(), VERTEX_LAYOUT};
+		ParticleSystem particleSystem{ device, renderer.GetAsyncCompute(), renderer.GetDescriptorAllocator(),
+			renderer.GetSwapChainRenderTarget(), PARTICLE_COUNT };
+		SpriteBatcher spriteBatcher{ device, renderer.GetSwapChainRenderTarget(), bindless.get() };
+		bool showSprites = false;
+		float spriteTime = 0.0f;
+		auto lastFrameTime = std::chrono::high_resolution_clock::now();
+		std::cout << "1-4: lowest latency / vsync / uncapped / adaptive present, F: frames in flight, "
+			"L: frame limiter, G: dump render graph, S: sprites" << std::endl;
 		while (!window.ShouldClose())
 		{
+			framePacer.Wait(renderer);
 			glfwPollEvents();
+			HandleSwapChainSettingsKeys();
+
+			auto frameTime = std::chrono::high_resolution_clock::now();
+			// Clamped so a hitch doesn't throw the particles across the screen
+			float deltaTime = std::min(std::chrono::duration<float>(frameTime - lastFrameTime).count(), 0.1f);
+			lastFrameTime = frameTime;
+
+			if (window.ConsumeKeyPress(GLFW_KEY_S))
+			{
+				if (showSprites)
+				{
+					const auto& stats = spriteBatcher.GetStats();
+					std::cout << "Sprites: " << stats.spriteCount << " in " << stats.batchCount << " batches, "
+						<< stats.GetSpritesPerMs() << " sprites/ms" << std::endl;
+				}
+				showSprites = !showSprites;
+			}
 			
 			if (auto commandBuffer = renderer.BeginFrame())
 			{
-				renderer.BeginSwapChainRenderPass(commandBuffer);
-				renderSystem.RenderGameObjects(commandBuffer, gameObjects);
-				renderer.EndSwapChainRenderPass(commandBuffer);
+				if (bindless)
+				{
+					bindless->NextFrame();
+				}
+				particleSystem.Simulate(renderer.GetFrameIndex(), deltaTime);
+				spriteBatcher.Begin(renderer.GetFrameIndex());
+				if (showSprites)
+				{
+					spriteTime += deltaTime;
+					DrawSpriteDemo(spriteBatcher, spriteTime);
+				}
+				// Hidden textures aren't requested and are the first to lose their mips over budget
+				UpdateStreamedTextures(commandBuffer, spriteBatcher, showSprites);
+				meshImporter.Update();
+				gameObjects.ForEach([](GameObject& obj)
+					{
+						obj.transform2d.SetRotation(glm::mod(obj.transform2d.GetRotation() + 0.01f, glm::two_pi<float>()));
+					});
+				sceneHierarchy.SyncLocals();
+				sceneHierarchy.Update();
+				spatialIndex.Sync(gameObjects, instanceBuffer.GetChangeList(), &sceneHierarchy);
+				renderGraph.Reset();
+				auto backbuffer = renderer.ImportSwapChainImage(renderGraph);
+				auto depth = renderer.ImportSwapChainDepth(renderGraph);
+				// Read by the previous frames, the copies wait for their vertex input
+				auto instances = renderGraph.ImportBuffer("Instances", instanceBuffer.GetBuffer(),
+					InstanceBuffer::READ_STAGES);
+				renderGraph.AddPass("Instance upload",
+					[&](RenderGraph::PassBuilder& pass)
+					{
+						pass.WriteBuffer(instances, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+					},
+					[&](VkCommandBuffer commandBuffer)
+					{
+						instanceBuffer.Flush(renderer.GetFrameIndex(), commandBuffer, gameObjects, &sceneHierarchy);
+					});
+				renderGraph.AddPass("Scene",
+					[&](RenderGraph::PassBuilder& pass)
+					{
+						pass.ReadBuffer(instances, InstanceBuffer::READ_STAGES, InstanceBuffer::READ_ACCESS);
+						pass.WriteColor(backbuffer, RenderGraph::LoadOp::Clear, { 0.01f, 0.01f, 0.01f, 1.0f });
+						pass.WriteDepth(depth);
+					},
+					[&](VkCommandBuffer commandBuffer)
+					{
+						renderSystem.RenderGameObjects(commandBuffer, gameObjects, models, instanceBuffer, &spatialIndex);
+						particleSystem.Render(commandBuffer);
+						spriteBatcher.Render(commandBuffer);
+					});
+				renderGraph.MarkOutput(backbuffer);
+				renderGraph.Compile();
+				if (window.ConsumeKeyPress(GLFW_KEY_G))
+				{
+					renderGraph.Dump(std::cout);
+				}
+				renderGraph.Execute(commandBuffer);
 				renderer.EndFrame();
 			}
+			window.ClearKeyPresses();
 		}
 
 		// Blocking cpu until gpu finish it's work
 		vkDeviceWaitIdle(device.GetDevice());
+		framePacer.ReportHistogram(framePacer.GetTargetFrameRate() > 0.0 ? "limited" : "unlimited");
+	}
+
+	void App::RunBenchmarks(const std::string& name)
+	{
+		if (name.empty() || name == "particles")
+		{
+			ParticleSystem::RunBenchmark(device, renderer.GetAsyncCompute(), renderer.GetDescriptorAllocator(),
+				renderer.GetSwapChainRenderTarget());
+		}
+		if (name.empty() || name == "sprites")
+		{
+			SpriteBatcher::RunBenchmark(device, renderer.GetSwapChainRenderTarget(), bindless.get());
+		}
+		if (name.empty() || name == "spatial")
+		{
+			SpatialIndex::RunBenchmark();
+		}
+		if (name.empty() || name == "hierarchy")
+		{
+			SceneHierarchy::RunBenchmark();
+		}
+		if (name.empty() || name == "pool")
+		{
+			GameObject::RunPoolBenchmark();
+		}
+		if (name.empty() || name == "scene")
+		{
+			SceneFile::RunBenchmark();
+		}
+		if (name.empty() || name == "meshes")
+		{
+			MeshImporter::RunBenchmark();
+		}
+		if (name.empty() || name == "meshopt")
+		{
+			MeshOptimizer::RunBenchmark();
+		}
+		if (name.empty() || name == "layouts")
+		{
+			Model::VertexLayout::RunPrecisionTest();
+		}
+
+		vkDeviceWaitIdle(device.GetDevice());
+	}
+
+	void App::HandleSwapChainSettingsKeys()
+	{
+		SwapChainSettings settings = renderer.GetSwapChainSettings();
+		bool changed = false;
+
+		const std::array<std::pair<int, PresentPolicy>, 4> policyKeys =
+		{{
+			{ GLFW_KEY_1, PresentPolicy::LowestLatency },
+			{ GLFW_KEY_2, PresentPolicy::VSync },
+			{ GLFW_KEY_3, PresentPolicy::Uncapped },
+			{ GLFW_KEY_4, PresentPolicy::Adaptive }
+		}};
+		for (const auto& [key, policy] : policyKeys)
+		{
+			if (window.ConsumeKeyPress(key))
+			{
+				settings.presentPolicy = policy;
+				changed = true;
+			}
+		}
+
+		if (window.ConsumeKeyPress(GLFW_KEY_F))
+		{
+			settings.framesInFlight = settings.framesInFlight % SwapChain::MAX_FRAMES_IN_FLIGHT + 1;
+			changed = true;
+		}
+
+		if (changed)
+		{
+			renderer.SetSwapChainSettings(settings);
+		}
+
+		// Histogram of the frames before the switch, to compare with the ones after
+		if (window.ConsumeKeyPress(GLFW_KEY_L))
+		{
+			bool limited = framePacer.GetTargetFrameRate() > 0.0;
+			framePacer.ReportHistogram(limited ? "limited" : "unlimited");
+			framePacer.SetTargetFrameRate(limited ? 0.0 : TARGET_FRAME_RATE);
+		}
+	}
+
+	void App::DrawSpriteDemo(SpriteBatcher& spriteBatcher, float time)
+	{
+		// Rings of small quads turning in opposite directions, the outer ones additive
+		constexpr uint32_t RINGS = 20;
+		constexpr uint32_t SPRITES_PER_RING = 500;
+		std::vector<SpriteBatcher::Sprite> sprites(RINGS * SPRITES_PER_RING);
+		for (uint32_t ring = 0; ring < RINGS; ring++)
+		{
+			float radius = 0.2f + 0.035f * ring;
+			float speed = (ring % 2 == 0 ? 1.0f : -1.0f) * (0.2f + 0.02f * ring);
+			for (uint32_t i = 0; i < SPRITES_PER_RING; i++)
+			{
+				float angle = glm::two_pi<float>() * i / SPRITES_PER_RING + time * speed;
+				auto& sprite = sprites[ring * SPRITES_PER_RING + i];
+				sprite.position = { std::cos(angle) * radius, std::sin(angle) * radius };
+				sprite.size = glm::vec2{ 0.008f };
+				sprite.rotation = angle;
+				sprite.color = { static_cast<float>(ring) / RINGS, 0.4f, 1.0f - static_cast<float>(ring) / RINGS, 0.8f };
+				sprite.blendMode = ring < RINGS / 2 ? SpriteBatcher::BlendMode::Alpha : SpriteBatcher::BlendMode::Additive;
+			}
+		}
+		spriteBatcher.Draw(sprites.data(), sprites.size());
+	}
+
+	void App::UpdateStreamedTextures(VkCommandBuffer commandBuffer, SpriteBatcher& spriteBatcher, bool visible)
+	{
+		const VkExtent2D extent = renderer.GetSwapChainExtent();
+		if (visible)
+		{
+			// Clip space spans two units across the screen
+			for (const auto& sprite : streamedSprites)
+			{
+				textureStreamer.RequestSize(sprite.handle, STREAMED_SPRITE_SIZE * extent.width / 2.0f,
+					STREAMED_SPRITE_SIZE * extent.height / 2.0f);
+			}
+		}
+		textureStreamer.Update(commandBuffer);
+
+		if (!bindless)
+		{
+			return;
+		}
+		for (size_t i = 0; i < streamedSprites.size(); i++)
+		{
+			auto& streamed = streamedSprites[i];
+			const VkDescriptorImageInfo imageInfo = textureStreamer.GetDescriptorInfo(streamed.handle);
+			// A rebuilt image gets a new slot, frames in flight keep reading the old one until it is retired
+			if (imageInfo.imageView != streamed.imageView)
+			{
+				if (streamed.textureIndex != BindlessDescriptors::INVALID_INDEX)
+				{
+					bindless->RemoveTexture(streamed.textureIndex);
+				}
+				streamed.textureIndex = bindless->AddTexture(imageInfo);
+				streamed.imageView = imageInfo.imageView;
+			}
+
+			if (visible)
+			{
+				const float spacing = STREAMED_SPRITE_SIZE + 0.05f;
+				SpriteBatcher::Sprite sprite;
+				sprite.position = { -0.8f + spacing * static_cast<float>(i % 5), -0.75f + spacing * static_cast<float>(i / 5) };
+				sprite.size = glm::vec2{ STREAMED_SPRITE_SIZE };
+				sprite.textureIndex = streamed.textureIndex;
+				spriteBatcher.Draw(sprite);
+			}
+		}
 	}
 
 	void App::LoadGameObjects()
@@ -49,14 +299,104 @@ namespace Application
 			{{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}}
 		};
 
-		auto model = std::make_shared<Model>(device, vertices);
-		auto triangle = GameObject::CreateGameObject();
+		auto model = models.Create(device, vertices, std::vector<uint32_t>{}, VERTEX_LAYOUT);
+		const SceneFile::ModelTable modelTable{ { "Triangle", model } };
+
+		// A saved scene replaces the one built here
+		if (std::filesystem::exists(SCENE_PATH))
+		{
+			SceneFile scene{ SCENE_PATH };
+			std::vector<Handle<Model>> sceneModels;
+			for (uint32_t i = 0; i < scene.GetModelCount(); i++)
+			{
+				const std::string name = scene.GetModelName(i);
+				auto it = std::find_if(modelTable.begin(), modelTable.end(), [&](const auto& entry) { return entry.first == name; });
+				if (it == modelTable.end())
+				{
+					throw std::runtime_error("Scene uses an unknown model: " + name);
+				}
+				sceneModels.push_back(it->second);
+			}
+			scene.Instantiate(gameObjects, sceneModels);
+			instanceBuffer.Assign(gameObjects);
+			gameObjects.ForEach([this](GameObject& obj) { spatialIndex.Insert(obj, &sceneHierarchy); });
+			return;
+		}
+
+		auto& triangle = *gameObjects.Get(gameObjects.CreateIndexed());
 		triangle.model = model;
 		triangle.color = { 0.1f, 0.8, 0.1f };
-		triangle.transform2d.translation.x = 0.2f;
-		triangle.transform2d.rotation = 0.25 * glm::two_pi<float>();
+		triangle.transform2d.SetTranslation({ 0.2f, 0.0f });
+		triangle.transform2d.SetRotation(0.25f * glm::two_pi<float>());
+
+		// Relative to the triangle, its rotation carries it around
+		auto& satellite = *gameObjects.Get(gameObjects.CreateIndexed());
+		satellite.model = model;
+		satellite.color = { 0.8f, 0.8f, 0.1f };
+		satellite.transform2d.SetTranslation({ 0.6f, 0.0f });
+		satellite.transform2d.SetScale({ 0.3f, 0.3f });
+		sceneHierarchy.Attach(satellite, &triangle);
 
-		gameObjects.push_back(std::move(triangle));
+		instanceBuffer.Assign(gameObjects);
+		gameObjects.ForEach([this](GameObject& obj) { spatialIndex.Insert(obj, &sceneHierarchy); });
+	}
+
+	void App::ImportMeshes()
+	{
+		if (!std::filesystem::is_directory(MESH_DIRECTORY))
+		{
+			return;
+		}
+
+		uint32_t meshIndex = 0;
+		for (const auto& entry : std::filesystem::directory_iterator{ MESH_DIRECTORY })
+		{
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+			if (extension != ".obj" && extension != ".gltf" && extension != ".glb")
+			{
+				continue;
+			}
+
+			// Spawned when the import finishes, in the slot the file was given here
+			const glm::vec2 position{ -0.8f + 0.2f * (meshIndex % 9), 0.8f - 0.2f * (meshIndex / 9 % 3) };
+			meshImporter.Load(entry.path().string(), [this, position](Handle<Model> model)
+				{
+					auto& object = *gameObjects.Get(gameObjects.CreateIndexed());
+					object.model = model;
+					object.color = { 1.0f, 1.0f, 1.0f };
+					object.transform2d.SetTranslation(position);
+					object.transform2d.SetScale({ 0.18f, 0.18f });
+					instanceBuffer.Track(object);
+					spatialIndex.Insert(object, &sceneHierarchy);
+				});
+			meshIndex++;
+		}
+	}
+
+	void App::StreamTextures()
+	{
+		if (!std::filesystem::is_directory(TEXTURE_DIRECTORY))
+		{
+			return;
+		}
+
+		for (const auto& entry : std::filesystem::directory_iterator{ TEXTURE_DIRECTORY })
+		{
+			if (entry.path().extension() != ".ktx2")
+			{
+				continue;
+			}
+			// Universal textures can't be streamed, they are skipped like any other unsupported file
+			try
+			{
+				streamedSprites.push_back({ textureStreamer.Load(entry.path().string()) });
+			}
+			catch (const std::exception& error)
+			{
+				std::cerr << error.what() << std::endl;
+			}
+		}
 	}
 
 }
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "../Public/AsyncCompute.h"
+
+#include <stdexcept>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+
+namespace Application
+{
+	AsyncCompute::AsyncCompute(Device& device) : device{device}
+	{
+		sharedQueue = device.GetComputeQueue() == device.GetGraphicsQueue() ||
+			device.GetComputeQueue() == device.GetPresentQueue() ||
+			device.GetComputeQueue() == device.GetTransferQueue();
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device.GetComputeQueueFamily();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		if (vkCreateCommandPool(device.GetDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create compute command pool");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+		if (vkAllocateCommandBuffers(device.GetDevice(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate compute command buffers");
+		}
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		if (vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create compute timeline semaphore");
+		}
+	}
+
+	AsyncCompute::~AsyncCompute()
+	{
+		if (submittedValue > 0)
+		{
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &submittedValue;
+			if (vkWaitSemaphores(device.GetDevice(), &waitInfo, UINT64_MAX) != VK_SUCCESS)
+			{
+				std::cerr << "Failed to wait for compute work before destroying it" << std::endl;
+			}
+		}
+		device.ReleaseFrameDependencies(timeline);
+
+		vkDestroySemaphore(device.GetDevice(), timeline, nullptr);
+		vkDestroyCommandPool(device.GetDevice(), commandPool, nullptr);
+	}
+
+	VkCommandBuffer AsyncCompute::Begin(int frameIndex)
+	{
+		Wait(slotValues[frameIndex]);
+
+		VkCommandBuffer commandBuffer = commandBuffers[frameIndex];
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording compute command buffer");
+		}
+		recordingSlot = frameIndex;
+		return commandBuffer;
+	}
+
+	uint64_t AsyncCompute::Submit(VkCommandBuffer commandBuffer, uint64_t waitFrame)
+	{
+		assert(recordingSlot >= 0 && commandBuffer == commandBuffers[recordingSlot] && "Compute command buffer wasn't begun");
+		assert(waitFrame <= device.GetSubmittedFrame() && "Cannot wait for a frame that is not submitted yet");
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record compute command buffer");
+		}
+
+		uint64_t signalValue = ++submittedValue;
+		slotValues[recordingSlot] = signalValue;
+		VkSemaphore waitSemaphore = device.GetFrameTimeline();
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = waitFrame > 0 ? 1 : 0;
+		timelineInfo.pWaitSemaphoreValues = &waitFrame;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.waitSemaphoreCount = waitFrame > 0 ? 1 : 0;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timeline;
+
+		{
+			std::unique_lock<std::mutex> queueLock;
+			if (sharedQueue)
+			{
+				queueLock = device.LockQueueSubmission();
+			}
+			if (vkQueueSubmit(device.GetComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to submit compute command buffer");
+			}
+		}
+
+		// Resources released through DeferDestroy during the frame being recorded outlive the
+		// compute work too. Not a frame wait, that would hold the frame's stages back.
+		device.AddFrameDependency(timeline, signalValue);
+		recordingSlot = -1;
+		return signalValue;
+	}
+
+	bool AsyncCompute::IsComplete(uint64_t value)
+	{
+		if (value > completedValueCache)
+		{
+			vkGetSemaphoreCounterValue(device.GetDevice(), timeline, &completedValueCache);
+		}
+		return value <= completedValueCache;
+	}
+
+	void AsyncCompute::Wait(uint64_t value)
+	{
+		if (value > 0 && !IsComplete(value))
+		{
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &value;
+			if (vkWaitSemaphores(device.GetDevice(), &waitInfo, UINT64_MAX) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to wait for compute work");
+			}
+			completedValueCache = value;
+		}
+	}
+}
@@ -0,0 +1,218 @@
+#include "../Public/BindlessDescriptors.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace Application
+{
+	uint32_t BindlessDescriptors::SlotAllocator::Allocate()
+	{
+		if (!freeSlots.empty())
+		{
+			uint32_t slot = freeSlots.back();
+			freeSlots.pop_back();
+			return slot;
+		}
+		if (next >= capacity)
+		{
+			throw std::runtime_error("Bindless descriptor array is full");
+		}
+		return next++;
+	}
+
+	BindlessDescriptors::BindlessDescriptors(Device& device) : device{device}
+	{
+		if (!device.SupportsBindless())
+		{
+			throw std::runtime_error("Device doesn't support descriptor indexing");
+		}
+
+		// Stay under the update after bind limits of the device
+		VkPhysicalDeviceVulkan12Properties properties12{};
+		properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &properties12;
+		vkGetPhysicalDeviceProperties2(device.GetPhysicalDevice(), &properties2);
+
+		// Combined image samplers count as both a sampled image and a sampler
+		textureSlots.capacity = std::min({ MAX_TEXTURES,
+			properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+			properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+			properties12.maxDescriptorSetUpdateAfterBindSamplers });
+		bufferSlots.capacity = std::min({ MAX_STORAGE_BUFFERS,
+			properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+			properties12.maxDescriptorSetUpdateAfterBindStorageBuffers });
+
+		// Both arrays are visible to every stage and count together against its resource limit,
+		// which is then split in the ratio of the requested sizes
+		const uint32_t stageResources = properties12.maxPerStageUpdateAfterBindResources;
+		if (textureSlots.capacity + bufferSlots.capacity > stageResources)
+		{
+			bufferSlots.capacity = std::min(bufferSlots.capacity, static_cast<uint32_t>(
+				uint64_t{ stageResources } * MAX_STORAGE_BUFFERS / (MAX_TEXTURES + MAX_STORAGE_BUFFERS)));
+			textureSlots.capacity = std::min(textureSlots.capacity, stageResources - bufferSlots.capacity);
+		}
+
+		CreateSetLayout();
+		CreatePool();
+		AllocateSet();
+	}
+
+	BindlessDescriptors::~BindlessDescriptors()
+	{
+		vkDestroyDescriptorPool(device.GetDevice(), descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device.GetDevice(), setLayout, nullptr);
+	}
+
+	void BindlessDescriptors::CreateSetLayout()
+	{
+		std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+		bindings[0].binding = TEXTURE_BINDING;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorCount = textureSlots.capacity;
+		bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+		bindings[1].binding = STORAGE_BUFFER_BINDING;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = bufferSlots.capacity;
+		bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+		// Slots that are never written stay invalid, the shaders only read the ones they are given
+		std::array<VkDescriptorBindingFlags, 2> bindingFlags{};
+		bindingFlags[0] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+		bindingFlags[1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		if (vkCreateDescriptorSetLayout(device.GetDevice(), &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create bindless descriptor set layout");
+		}
+	}
+
+	void BindlessDescriptors::CreatePool()
+	{
+		std::array<VkDescriptorPoolSize, 2> poolSizes{};
+		poolSizes[0] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureSlots.capacity };
+		poolSizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferSlots.capacity };
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolInfo.pPoolSizes = poolSizes.data();
+
+		if (vkCreateDescriptorPool(device.GetDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create bindless descriptor pool");
+		}
+	}
+
+	void BindlessDescriptors::AllocateSet()
+	{
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &setLayout;
+
+		if (vkAllocateDescriptorSets(device.GetDevice(), &allocInfo, &descriptorSet) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate bindless descriptor set");
+		}
+	}
+
+	uint32_t BindlessDescriptors::AddTexture(const VkDescriptorImageInfo& imageInfo)
+	{
+		uint32_t index = textureSlots.Allocate();
+		UpdateTexture(index, imageInfo);
+		return index;
+	}
+
+	void BindlessDescriptors::UpdateTexture(uint32_t index, const VkDescriptorImageInfo& imageInfo)
+	{
+		assert(index < textureSlots.next && "Texture index was never allocated");
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSet;
+		write.dstBinding = TEXTURE_BINDING;
+		write.dstArrayElement = index;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(device.GetDevice(), 1, &write, 0, nullptr);
+	}
+
+	void BindlessDescriptors::RemoveTexture(uint32_t index)
+	{
+		// The frame being recorded is the next one to be submitted
+		textureSlots.retiredSlots.push_back({ index, device.GetSubmittedFrame() + 1 });
+	}
+
+	uint32_t BindlessDescriptors::AddStorageBuffer(const VkDescriptorBufferInfo& bufferInfo)
+	{
+		uint32_t index = bufferSlots.Allocate();
+		UpdateStorageBuffer(index, bufferInfo);
+		return index;
+	}
+
+	void BindlessDescriptors::UpdateStorageBuffer(uint32_t index, const VkDescriptorBufferInfo& bufferInfo)
+	{
+		assert(index < bufferSlots.next && "Storage buffer index was never allocated");
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSet;
+		write.dstBinding = STORAGE_BUFFER_BINDING;
+		write.dstArrayElement = index;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(device.GetDevice(), 1, &write, 0, nullptr);
+	}
+
+	void BindlessDescriptors::RemoveStorageBuffer(uint32_t index)
+	{
+		bufferSlots.retiredSlots.push_back({ index, device.GetSubmittedFrame() + 1 });
+	}
+
+	void BindlessDescriptors::NextFrame()
+	{
+		for (SlotAllocator* slots : { &textureSlots, &bufferSlots })
+		{
+			auto& retired = slots->retiredSlots;
+			auto it = std::remove_if(retired.begin(), retired.end(), [&](const std::pair<uint32_t, uint64_t>& slot)
+				{
+					if (!device.IsFrameComplete(slot.second))
+					{
+						return false;
+					}
+					slots->freeSlots.push_back(slot.first);
+					return true;
+				});
+			retired.erase(it, retired.end());
+		}
+	}
+
+	void BindlessDescriptors::Bind(
+		VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkPipelineBindPoint bindPoint)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	}
+}
@@ -0,0 +1,272 @@
+#include "../Public/Descriptors.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <cassert>
+
+namespace Application
+{
+	namespace
+	{
+		// Descriptors per set reserved for each type when creating a pool
+		constexpr std::pair<VkDescriptorType, float> POOL_RATIOS[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f }
+		};
+	}
+
+	// ---- DescriptorLayoutCache ----
+
+	DescriptorLayoutCache::~DescriptorLayoutCache()
+	{
+		for (auto& [key, layout] : layouts)
+		{
+			vkDestroyDescriptorSetLayout(device.GetDevice(), layout, nullptr);
+		}
+	}
+
+	VkDescriptorSetLayout DescriptorLayoutCache::GetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+	{
+		// Same bindings declared in a different order must give the same layout
+		std::sort(bindings.begin(), bindings.end(),
+			[](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+			{
+				return a.binding < b.binding;
+			});
+
+		LayoutKey key{ std::move(bindings) };
+		auto it = layouts.find(key);
+		if (it != layouts.end())
+		{
+			return it->second;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+		layoutInfo.pBindings = key.bindings.data();
+
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(device.GetDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create descriptor set layout");
+		}
+		layouts.emplace(std::move(key), layout);
+		return layout;
+	}
+
+	bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const
+	{
+		if (bindings.size() != other.bindings.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			const auto& a = bindings[i];
+			const auto& b = other.bindings[i];
+			if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+				a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags ||
+				a.pImmutableSamplers != b.pImmutableSamplers)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const LayoutKey& key) const
+	{
+		size_t result = std::hash<size_t>()(key.bindings.size());
+		for (const auto& binding : key.bindings)
+		{
+			uint64_t packed = static_cast<uint64_t>(binding.binding) |
+				(static_cast<uint64_t>(binding.descriptorType) << 8) |
+				(static_cast<uint64_t>(binding.descriptorCount) << 24) |
+				(static_cast<uint64_t>(binding.stageFlags) << 40);
+			result ^= std::hash<uint64_t>()(packed) + 0x9e3779b9 + (result << 6) + (result >> 2);
+		}
+		return result;
+	}
+
+	// ---- DescriptorAllocator ----
+
+	DescriptorAllocator::DescriptorAllocator(Device& device) : device{device}, layoutCache{device}
+	{
+	}
+
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		DestroyPools(persistentPools);
+		for (auto& pools : framePools)
+		{
+			DestroyPools(pools);
+		}
+	}
+
+	VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+	{
+		return AllocateFrom(persistentPools, layout);
+	}
+
+	VkDescriptorSet DescriptorAllocator::AllocateTransient(VkDescriptorSetLayout layout)
+	{
+		return AllocateFrom(framePools[currentFrame], layout);
+	}
+
+	void DescriptorAllocator::BeginFrame(int frameIndex)
+	{
+		currentFrame = frameIndex;
+
+		// One reset per pool frees every set of the frame, no vkFreeDescriptorSets needed
+		PoolList& pools = framePools[frameIndex];
+		for (VkDescriptorPool pool : pools.used)
+		{
+			vkResetDescriptorPool(device.GetDevice(), pool, 0);
+			pools.available.push_back(pool);
+		}
+		pools.used.clear();
+		pools.current = VK_NULL_HANDLE;
+	}
+
+	VkDescriptorSet DescriptorAllocator::AllocateFrom(PoolList& pools, VkDescriptorSetLayout layout)
+	{
+		if (pools.current == VK_NULL_HANDLE)
+		{
+			pools.current = GrabPool(pools);
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pools.current;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		VkResult result = vkAllocateDescriptorSets(device.GetDevice(), &allocInfo, &set);
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			// Current pool is full, move on to a new one and retry once
+			pools.current = GrabPool(pools);
+			allocInfo.descriptorPool = pools.current;
+			result = vkAllocateDescriptorSets(device.GetDevice(), &allocInfo, &set);
+		}
+
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate descriptor set");
+		}
+		return set;
+	}
+
+	VkDescriptorPool DescriptorAllocator::GrabPool(PoolList& pools)
+	{
+		VkDescriptorPool pool;
+		if (!pools.available.empty())
+		{
+			pool = pools.available.back();
+			pools.available.pop_back();
+		}
+		else
+		{
+			std::vector<VkDescriptorPoolSize> poolSizes;
+			for (const auto& [type, ratio] : POOL_RATIOS)
+			{
+				poolSizes.push_back({ type, static_cast<uint32_t>(ratio * pools.nextPoolSize) });
+			}
+
+			VkDescriptorPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			poolInfo.maxSets = pools.nextPoolSize;
+			poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+			poolInfo.pPoolSizes = poolSizes.data();
+
+			if (vkCreateDescriptorPool(device.GetDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create descriptor pool");
+			}
+
+			// Each new pool is bigger so a busy frame quickly settles on a few pools
+			pools.nextPoolSize = std::min(pools.nextPoolSize * 2, MAX_POOL_SIZE);
+		}
+
+		pools.used.push_back(pool);
+		return pool;
+	}
+
+	void DescriptorAllocator::DestroyPools(PoolList& pools)
+	{
+		for (VkDescriptorPool pool : pools.used)
+		{
+			vkDestroyDescriptorPool(device.GetDevice(), pool, nullptr);
+		}
+		for (VkDescriptorPool pool : pools.available)
+		{
+			vkDestroyDescriptorPool(device.GetDevice(), pool, nullptr);
+		}
+		pools.used.clear();
+		pools.available.clear();
+	}
+
+	// ---- DescriptorWriter ----
+
+	DescriptorWriter& DescriptorWriter::WriteBuffer(
+		uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo& bufferInfo)
+	{
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstBinding = binding;
+		write.descriptorCount = 1;
+		write.descriptorType = type;
+		writes.push_back(write);
+		infoIndices.push_back(bufferInfos.size());
+		bufferInfos.push_back(bufferInfo);
+		return *this;
+	}
+
+	DescriptorWriter& DescriptorWriter::WriteImage(
+		uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo& imageInfo)
+	{
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstBinding = binding;
+		write.descriptorCount = 1;
+		write.descriptorType = type;
+		writes.push_back(write);
+		infoIndices.push_back(imageInfos.size());
+		imageInfos.push_back(imageInfo);
+		return *this;
+	}
+
+	void DescriptorWriter::Update(Device& device, VkDescriptorSet set)
+	{
+		for (size_t i = 0; i < writes.size(); i++)
+		{
+			auto& write = writes[i];
+			write.dstSet = set;
+			switch (write.descriptorType)
+			{
+			case VK_DESCRIPTOR_TYPE_SAMPLER:
+			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+			case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+			case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+			case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+				write.pImageInfo = &imageInfos[infoIndices[i]];
+				break;
+			default:
+				write.pBufferInfo = &bufferInfos[infoIndices[i]];
+				break;
+			}
+		}
+		vkUpdateDescriptorSets(device.GetDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+}
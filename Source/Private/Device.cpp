@@ -1,9 +1,12 @@
 #include "../Public/Device.h"
+#include "../Public/Uploader.h"
 
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <set>
+#include <map>
 #include <unordered_set>
 
 namespace Application {
@@ -60,9 +63,23 @@ namespace Application {
         PickPhysicalDevice();
         CreateLogicalDevice();
         CreateCommandPool();
+        CreateFrameTimeline();
+        uploader = std::make_unique<Uploader>(*this);
     }
 
     Device::~Device() {
+        // Waits for its own submissions, before the queues go away
+        uploader.reset();
+
+        // Everything still queued was released by its owner, nothing can use it anymore
+        vkDeviceWaitIdle(device);
+        for (auto& entry : deferredDestroys)
+        {
+            entry.destroy();
+        }
+        deferredDestroys.clear();
+
+        vkDestroySemaphore(device, frameTimeline, nullptr);
         vkDestroyCommandPool(device, commandPool, nullptr);
         vkDestroyDevice(device, nullptr);
 
@@ -82,13 +99,27 @@ namespace Application {
             throw std::runtime_error("validation layers requested, but not available!");
         }
 
+        // Timeline semaphores and vkGetPhysicalDeviceMemoryProperties2 are core in the 1.2 API the
+        // instance asks for, a 1.0 loader doesn't even export vkEnumerateInstanceVersion
+        uint32_t instanceVersion = VK_API_VERSION_1_0;
+        auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+            vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+        if (enumerateInstanceVersion != nullptr)
+        {
+            enumerateInstanceVersion(&instanceVersion);
+        }
+        if (instanceVersion < VK_API_VERSION_1_2)
+        {
+            throw std::runtime_error("Vulkan 1.2 is not supported by the installed loader");
+        }
+
         VkApplicationInfo appInfo = {};
         appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
         appInfo.pApplicationName = "LittleVulkanEngine App";
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        appInfo.apiVersion = VK_API_VERSION_1_2;
 
         VkInstanceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -155,17 +186,50 @@ namespace Application {
     {
         QueueFamilyIndices indices = FindQueueFamilies(physicalDevice);
 
-        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+        graphicsFamily = indices.graphicsFamily;
+        transferFamily = indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+        computeFamily = indices.computeFamilyHasValue ? indices.computeFamily : indices.graphicsFamily;
+
+        // Each role gets its own queue while its family has one left, the last one is shared otherwise
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> familyProperties(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, familyProperties.data());
+        std::map<uint32_t, uint32_t> queueCounts;
+        auto allocateQueue = [&](uint32_t family)
+            {
+                uint32_t index = std::min(queueCounts[family], familyProperties[family].queueCount - 1);
+                queueCounts[family] = std::max(queueCounts[family], index + 1);
+                return index;
+            };
+        const uint32_t graphicsQueueIndex = allocateQueue(indices.graphicsFamily);
+        const uint32_t presentQueueIndex = indices.presentFamily == indices.graphicsFamily ?
+            graphicsQueueIndex : allocateQueue(indices.presentFamily);
+        const uint32_t computeQueueIndex = allocateQueue(computeFamily);
+        const uint32_t transferQueueIndex = allocateQueue(transferFamily);
+
+        // Graphics first, uploads and async compute go behind rendering when the hardware
+        // arbitrates, in their own family too. A shared queue keeps the highest priority.
+        std::map<uint32_t, std::vector<float>> queuePriorities;
+        auto setPriority = [&](uint32_t family, uint32_t index, float priority)
+            {
+                std::vector<float>& priorities = queuePriorities[family];
+                priorities.resize(queueCounts[family], 0.0f);
+                priorities[index] = std::max(priorities[index], priority);
+            };
+        setPriority(indices.graphicsFamily, graphicsQueueIndex, 1.0f);
+        setPriority(indices.presentFamily, presentQueueIndex, 1.0f);
+        setPriority(computeFamily, computeQueueIndex, 0.5f);
+        setPriority(transferFamily, transferQueueIndex, 0.5f);
 
-        float queuePriority = 1.0f;
-        for (uint32_t queueFamily : uniqueQueueFamilies) 
+        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+        for (const auto& [queueFamily, queueCount] : queueCounts) 
         {
             VkDeviceQueueCreateInfo queueCreateInfo = {};
             queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
             queueCreateInfo.queueFamilyIndex = queueFamily;
-            queueCreateInfo.queueCount = 1;
-            queueCreateInfo.pQueuePriorities = &queuePriority;
+            queueCreateInfo.queueCount = queueCount;
+            queueCreateInfo.pQueuePriorities = queuePriorities[queueFamily].data();
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
@@ -178,9 +242,101 @@ namespace Application {
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+        enabledDeviceExtensions = deviceExtensions;
+        for (const char* optional : optionalDeviceExtensions)
+        {
+            for (const auto& extension : availableExtensions)
+            {
+                if (strcmp(optional, extension.extensionName) == 0)
+                {
+                    std::cout << "optional extension: " << optional << std::endl;
+                    enabledDeviceExtensions.push_back(optional);
+                    break;
+                }
+            }
+        }
+
+        // Opt into the 1.2 features the engine can use, only when the driver exposes them
+        enabledVulkan12Features = {};
+        enabledVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        if (properties.apiVersion >= VK_API_VERSION_1_2)
+        {
+            VkPhysicalDeviceVulkan12Features supported{};
+            supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &supported;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+            enabledVulkan12Features.timelineSemaphore = VK_TRUE;
+            enabledVulkan12Features.descriptorIndexing = supported.descriptorIndexing;
+            enabledVulkan12Features.runtimeDescriptorArray = supported.runtimeDescriptorArray;
+            enabledVulkan12Features.descriptorBindingPartiallyBound = supported.descriptorBindingPartiallyBound;
+            enabledVulkan12Features.descriptorBindingSampledImageUpdateAfterBind =
+                supported.descriptorBindingSampledImageUpdateAfterBind;
+            enabledVulkan12Features.descriptorBindingStorageBufferUpdateAfterBind =
+                supported.descriptorBindingStorageBufferUpdateAfterBind;
+            enabledVulkan12Features.shaderSampledImageArrayNonUniformIndexing =
+                supported.shaderSampledImageArrayNonUniformIndexing;
+            createInfo.pNext = &enabledVulkan12Features;
+        }
+
+        // Present wait needs both extensions and their features, used by the frame pacer
+        enabledPresentIdFeatures = {};
+        enabledPresentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        enabledPresentWaitFeatures = {};
+        enabledPresentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        if (IsExtensionEnabled(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            IsExtensionEnabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+        {
+            VkPhysicalDevicePresentWaitFeaturesKHR supportedWait{};
+            supportedWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+            VkPhysicalDevicePresentIdFeaturesKHR supportedId{};
+            supportedId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+            supportedId.pNext = &supportedWait;
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &supportedId;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+            if (supportedId.presentId && supportedWait.presentWait)
+            {
+                enabledPresentIdFeatures.presentId = VK_TRUE;
+                enabledPresentWaitFeatures.presentWait = VK_TRUE;
+                enabledPresentIdFeatures.pNext = &enabledPresentWaitFeatures;
+                enabledPresentWaitFeatures.pNext = const_cast<void*>(createInfo.pNext);
+                createInfo.pNext = &enabledPresentIdFeatures;
+            }
+        }
+
+        // Rendering straight into image views, no render pass or framebuffer objects
+        enabledDynamicRenderingFeatures = {};
+        enabledDynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        if (IsExtensionEnabled(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME))
+        {
+            VkPhysicalDeviceDynamicRenderingFeaturesKHR supportedRendering{};
+            supportedRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &supportedRendering;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+            if (supportedRendering.dynamicRendering)
+            {
+                enabledDynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+                enabledDynamicRenderingFeatures.pNext = const_cast<void*>(createInfo.pNext);
+                createInfo.pNext = &enabledDynamicRenderingFeatures;
+            }
+        }
+
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledDeviceExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledDeviceExtensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -199,8 +355,22 @@ namespace Application {
             throw std::runtime_error("failed to create logical device!");
         }
 
-        vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
-        vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+        vkGetDeviceQueue(device, indices.graphicsFamily, graphicsQueueIndex, &graphicsQueue);
+        vkGetDeviceQueue(device, indices.presentFamily, presentQueueIndex, &presentQueue);
+        vkGetDeviceQueue(device, transferFamily, transferQueueIndex, &transferQueue);
+        vkGetDeviceQueue(device, computeFamily, computeQueueIndex, &computeQueue);
+        std::cout << "transfer queue: family " << transferFamily
+            << (HasDedicatedTransferQueue() ? " (dedicated)" : " (graphics)") << std::endl;
+        std::cout << "compute queue: family " << computeFamily
+            << (HasAsyncComputeFamily() ? " (async)" : " (graphics)") << std::endl;
+
+        if (SupportsDynamicRendering())
+        {
+            cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+                vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+            cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+                vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+        }
     }
 
     void Device::CreateCommandPool() 
@@ -219,6 +389,95 @@ namespace Application {
         }
     }
 
+    void Device::CreateFrameTimeline()
+    {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frameTimeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create frame timeline semaphore!");
+        }
+    }
+
+    uint64_t Device::GetCompletedFrame()
+    {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(device, frameTimeline, &value);
+        return value;
+    }
+
+    void Device::WaitForFrame(uint64_t frame)
+    {
+        if (frame == 0 || frame <= completedFrameCache)
+        {
+            return;
+        }
+
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &frameTimeline;
+        waitInfo.pValues = &frame;
+        if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to wait for frame timeline!");
+        }
+        completedFrameCache = frame;
+    }
+
+    void Device::DeferDestroy(std::function<void()>&& destroy)
+    {
+        std::lock_guard<std::mutex> lock(deferredDestroysMutex);
+        // The frame being recorded is the next one to be submitted
+        deferredDestroys.push_back({ submittedFrame + 1, std::move(destroy) });
+    }
+
+    uint64_t Device::GetRetiredFrame()
+    {
+        completedFrameCache = std::max(completedFrameCache, GetCompletedFrame());
+        uint64_t retiredFrame = completedFrameCache;
+        while (!frameDependencies.empty() && frameDependencies.front().frame <= retiredFrame)
+        {
+            const FrameDependency& dependency = frameDependencies.front();
+            uint64_t value = 0;
+            vkGetSemaphoreCounterValue(device, dependency.semaphore, &value);
+            if (value < dependency.value)
+            {
+                retiredFrame = dependency.frame - 1;
+                break;
+            }
+            frameDependencies.pop_front();
+        }
+        return retiredFrame;
+    }
+
+    void Device::CollectDeferredDestroys()
+    {
+        const uint64_t retiredFrame = GetRetiredFrame();
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(deferredDestroysMutex);
+            while (!deferredDestroys.empty() && deferredDestroys.front().frame <= retiredFrame)
+            {
+                ready.push_back(std::move(deferredDestroys.front().destroy));
+                deferredDestroys.pop_front();
+            }
+        }
+
+        // Run outside the lock, a destroy may release an object that defers more work
+        for (auto& destroy : ready)
+        {
+            destroy();
+        }
+    }
+
     void Device::CreateSurface()
     {
         window.CreateWindowSurface(instance, &surface); 
@@ -240,8 +499,24 @@ namespace Application {
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
+        // Frame synchronization is built on timeline semaphores
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        VkPhysicalDeviceVulkan12Features supported12{};
+        supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        if (deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+        {
+            VkPhysicalDeviceFeatures2 features2{};
+            features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features2.pNext = &supported12;
+            vkGetPhysicalDeviceFeatures2(device, &features2);
+        }
+
+        // The 1.1 and 1.2 entry points (memory properties 2, semaphore waits) need the device
+        // to support the version too, not only the instance
         return indices.IsComplete() && extensionsSupported && swapChainAdequate &&
-            supportedFeatures.samplerAnisotropy;
+            supportedFeatures.samplerAnisotropy && deviceProperties.apiVersion >= VK_API_VERSION_1_2 &&
+            supported12.timelineSemaphore;
     }
 
     void Device::PopulateDebugMessengerCreateInfo(
@@ -397,6 +672,37 @@ namespace Application {
             i++;
         }
 
+        // Compute without graphics runs next to the graphics queue on hardware that has such queues
+        for (uint32_t family = 0; family < queueFamilyCount; family++)
+        {
+            VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                indices.computeFamily = family;
+                indices.computeFamilyHasValue = true;
+                break;
+            }
+        }
+
+        // Copy engines have no graphics or compute, families without graphics are the next best
+        int bestScore = 0;
+        for (uint32_t family = 0; family < queueFamilyCount; family++)
+        {
+            VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if (queueFamilies[family].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT) ||
+                !(flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)))
+            {
+                continue;
+            }
+            int score = (flags & VK_QUEUE_COMPUTE_BIT) ? 1 : 2;
+            if (score > bestScore)
+            {
+                bestScore = score;
+                indices.transferFamily = family;
+                indices.transferFamilyHasValue = true;
+            }
+        }
+
         return indices;
     }
 
@@ -434,19 +740,80 @@ namespace Application {
     {
         for (VkFormat format : candidates)
         {
-            VkFormatProperties props;
-            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
-
-            if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features)
+            if (IsFormatSupported(format, tiling, features))
             {
                 return format;
             }
-            else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) 
+        }
+        throw std::runtime_error("failed to find supported format!");
+    }
+
+    bool Device::IsFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features)
+    {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+        if (tiling == VK_IMAGE_TILING_LINEAR)
+        {
+            return (props.linearTilingFeatures & features) == features;
+        }
+        return tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features;
+    }
+
+    bool Device::IsExtensionEnabled(const char* extension) const
+    {
+        for (const char* enabled : enabledDeviceExtensions)
+        {
+            if (strcmp(enabled, extension) == 0)
             {
-                return format;
+                return true;
             }
         }
-        throw std::runtime_error("failed to find supported format!");
+        return false;
+    }
+
+    bool Device::SupportsBindless() const
+    {
+        return enabledVulkan12Features.descriptorIndexing &&
+            enabledVulkan12Features.runtimeDescriptorArray &&
+            enabledVulkan12Features.descriptorBindingPartiallyBound &&
+            enabledVulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+            enabledVulkan12Features.descriptorBindingStorageBufferUpdateAfterBind &&
+            // The bindless shaders index the texture array with nonuniformEXT
+            enabledVulkan12Features.shaderSampledImageArrayNonUniformIndexing;
+    }
+
+    MemoryBudget Device::GetDeviceLocalMemoryBudget()
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 memProperties{};
+        memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        const bool hasBudget = IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        memProperties.pNext = hasBudget ? &budgetProperties : nullptr;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties);
+
+        MemoryBudget result{ 0, 0 };
+        for (uint32_t i = 0; i < memProperties.memoryProperties.memoryHeapCount; i++)
+        {
+            if (!(memProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+            {
+                continue;
+            }
+
+            if (hasBudget)
+            {
+                result.budget += budgetProperties.heapBudget[i];
+                result.usage += budgetProperties.heapUsage[i];
+            }
+            else
+            {
+                // Without the extension other processes usage is unknown, keep some headroom
+                result.budget += memProperties.memoryProperties.memoryHeaps[i].size / 10 * 8;
+            }
+        }
+        return result;
     }
 
     uint32_t Device::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) 
@@ -465,17 +832,39 @@ namespace Application {
         throw std::runtime_error("failed to find suitable memory type!");
     }
 
+    bool Device::HasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+        {
+            if ((typeFilter & (1 << i)) &&
+                (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     void Device::CreateBuffer(
         VkDeviceSize size,
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer& buffer,
-        VkDeviceMemory& bufferMemory) {
+        VkDeviceMemory& bufferMemory,
+        const std::vector<uint32_t>& queueFamilies) {
         VkBufferCreateInfo bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferInfo.size = size;
         bufferInfo.usage = usage;
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (queueFamilies.size() > 1)
+        {
+            bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+            bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+        }
 
         if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
         {
@@ -498,87 +887,40 @@ namespace Application {
         vkBindBufferMemory(device, buffer, bufferMemory, 0);
     }
 
-    VkCommandBuffer Device::BeginSingleTimeCommands() 
+    void Device::AddFrameWait(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages)
     {
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = commandPool;
-        allocInfo.commandBufferCount = 1;
-
-        VkCommandBuffer commandBuffer;
-        vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-        vkBeginCommandBuffer(commandBuffer, &beginInfo);
-        return commandBuffer;
+        for (auto& wait : frameWaits)
+        {
+            // A wait at other stages stays separate, merging would make the earlier stages wait
+            // for the later value
+            if (wait.semaphore == semaphore && wait.stages == stages)
+            {
+                wait.value = std::max(wait.value, value);
+                return;
+            }
+        }
+        frameWaits.push_back({ semaphore, value, stages });
     }
 
-    void Device::EndSingleTimeCommands(VkCommandBuffer commandBuffer) 
+    void Device::AddFrameDependency(VkSemaphore semaphore, uint64_t value)
     {
-        vkEndCommandBuffer(commandBuffer);
-
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue);
-
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        // The frame being recorded is the next one to be submitted
+        frameDependencies.push_back({ submittedFrame + 1, semaphore, value });
     }
 
-    void Device::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) 
+    void Device::ReleaseFrameDependencies(VkSemaphore semaphore)
     {
-        VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-        VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0;  // Optional
-        copyRegion.dstOffset = 0;  // Optional
-        copyRegion.size = size;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-        EndSingleTimeCommands(commandBuffer);
-    }
-
-    void Device::CopyBufferToImage(
-        VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount) 
-    {
-        VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = layerCount;
-
-        region.imageOffset = { 0, 0, 0 };
-        region.imageExtent = { width, height, 1 };
-
-        vkCmdCopyBufferToImage(
-            commandBuffer,
-            buffer,
-            image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &region);
-
-        EndSingleTimeCommands(commandBuffer);
+        frameDependencies.erase(std::remove_if(frameDependencies.begin(), frameDependencies.end(),
+            [semaphore](const FrameDependency& dependency) { return dependency.semaphore == semaphore; }),
+            frameDependencies.end());
     }
 
     void Device::CreateImageWithInfo(
         const VkImageCreateInfo& imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage& image,
-        VkDeviceMemory& imageMemory) 
+        VkDeviceMemory& imageMemory,
+        VkMemoryPropertyFlags preferredProperties) 
     {
         if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) 
         {
@@ -591,6 +933,10 @@ namespace Application {
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
+        if (preferredProperties != 0 && HasMemoryType(memRequirements.memoryTypeBits, properties | preferredProperties))
+        {
+            properties |= preferredProperties;
+        }
         allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
 
         if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
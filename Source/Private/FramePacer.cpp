@@ -0,0 +1,174 @@
+#include "../Public/FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace Application
+{
+	namespace
+	{
+		// Presents allowed to wait for the display before the next frame starts
+		constexpr uint32_t MAX_QUEUED_PRESENTS = 1;
+		constexpr uint64_t PRESENT_WAIT_TIMEOUT_NS = 100'000'000;
+
+		double ToMs(FramePacer::Clock::duration duration)
+		{
+			return std::chrono::duration<double, std::milli>(duration).count();
+		}
+	}
+
+	FramePacer::FramePacer(double targetFrameRate) : targetFrameRate{targetFrameRate}
+	{
+#ifdef _WIN32
+		// Default timers have the 15.6 ms scheduler granularity, the high resolution one doesn't
+		waitableTimer = CreateWaitableTimerExW(
+			nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (waitableTimer != nullptr)
+		{
+			spinMarginMs = 0.25;
+		}
+#endif
+	}
+
+	FramePacer::~FramePacer()
+	{
+#ifdef _WIN32
+		if (waitableTimer != nullptr)
+		{
+			CloseHandle(waitableTimer);
+		}
+#endif
+	}
+
+	void FramePacer::Wait(Renderer& renderer)
+	{
+		// Starting once the previous frame is on screen keeps the input of this one fresh
+		renderer.WaitForPresent(MAX_QUEUED_PRESENTS, PRESENT_WAIT_TIMEOUT_NS);
+
+		if (targetFrameRate > 0.0)
+		{
+			double intervalMs = 1000.0 / targetFrameRate;
+			uint64_t refreshNs = renderer.GetRefreshDurationNs();
+			if (refreshNs > 0)
+			{
+				// A whole number of refreshes per frame, otherwise frames alternate between two durations
+				double refreshMs = refreshNs / 1'000'000.0;
+				intervalMs = std::max(1.0, std::round(intervalMs / refreshMs)) * refreshMs;
+			}
+			auto interval = std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double, std::milli>(intervalMs));
+
+			auto now = Clock::now();
+			// Don't try to catch up after a long frame, that would make the next ones shorter
+			if (!hasLastFrameStart || now > nextFrameStart + interval)
+			{
+				nextFrameStart = now;
+			}
+			SleepUntil(nextFrameStart);
+			nextFrameStart += interval;
+		}
+
+		auto frameStart = Clock::now();
+		if (hasLastFrameStart)
+		{
+			RecordFrameTime(ToMs(frameStart - lastFrameStart));
+		}
+		lastFrameStart = frameStart;
+		hasLastFrameStart = true;
+	}
+
+	void FramePacer::SleepUntil(Clock::time_point deadline)
+	{
+		auto sleepEnd = deadline - std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double, std::milli>(spinMarginMs));
+		auto now = Clock::now();
+		if (sleepEnd > now)
+		{
+#ifdef _WIN32
+			if (waitableTimer != nullptr)
+			{
+				// Relative due time in 100 ns units
+				LARGE_INTEGER dueTime;
+				dueTime.QuadPart = -static_cast<LONGLONG>(ToMs(sleepEnd - now) * 10'000.0);
+				SetWaitableTimer(waitableTimer, &dueTime, 0, nullptr, nullptr, FALSE);
+				WaitForSingleObject(waitableTimer, INFINITE);
+			}
+			else
+			{
+				std::this_thread::sleep_until(sleepEnd);
+			}
+#else
+			std::this_thread::sleep_until(sleepEnd);
+#endif
+			// Keep the margin a bit above the overshoot actually seen
+			double overshootMs = ToMs(Clock::now() - sleepEnd);
+			spinMarginMs = std::clamp(spinMarginMs * 0.9 + overshootMs * 1.5 * 0.1, 0.05, 4.0);
+		}
+
+		while (Clock::now() < deadline)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	void FramePacer::RecordFrameTime(double frameMs)
+	{
+		size_t bucket = std::min(static_cast<size_t>(frameMs / HISTOGRAM_BUCKET_MS), HISTOGRAM_BUCKETS - 1);
+		histogram[bucket]++;
+		frameCount++;
+		maxFrameMs = std::max(maxFrameMs, frameMs);
+	}
+
+	double FramePacer::GetPercentile(double percentile) const
+	{
+		uint32_t rank = static_cast<uint32_t>(std::ceil(percentile * frameCount));
+		uint32_t count = 0;
+		for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+		{
+			count += histogram[i];
+			if (count >= rank)
+			{
+				// Upper edge of the bucket
+				return (i + 1) * HISTOGRAM_BUCKET_MS;
+			}
+		}
+		return maxFrameMs;
+	}
+
+	void FramePacer::ReportHistogram(const char* label)
+	{
+		if (frameCount > 0)
+		{
+			std::cout << "Frame times (" << label << "), " << frameCount << " frames: p50 " << GetPercentile(0.5)
+				<< " ms, p95 " << GetPercentile(0.95) << " ms, p99 " << GetPercentile(0.99)
+				<< " ms, max " << maxFrameMs << " ms" << std::endl;
+
+			uint32_t largest = *std::max_element(histogram.begin(), histogram.end());
+			for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+			{
+				if (histogram[i] == 0)
+				{
+					continue;
+				}
+				size_t barLength = std::max<size_t>(1, histogram[i] * 40 / largest);
+				std::cout << std::setw(6) << i * HISTOGRAM_BUCKET_MS << (i == HISTOGRAM_BUCKETS - 1 ? "+ ms " : " ms  ")
+					<< std::string(barLength, '#') << ' ' << histogram[i] << std::endl;
+			}
+		}
+
+		histogram.fill(0);
+		frameCount = 0;
+		maxFrameMs = 0.0;
+		hasLastFrameStart = false;
+	}
+}
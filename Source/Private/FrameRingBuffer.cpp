@@ -0,0 +1,67 @@
+#include "../Public/FrameRingBuffer.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+namespace Application
+{
+	FrameRingBuffer::FrameRingBuffer(Device& device, VkDeviceSize frameSize, VkBufferUsageFlags usage) :
+		device{device}
+	{
+		const auto& limits = device.properties.limits;
+		alignment = 16;
+		if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		{
+			alignment = std::max(alignment, limits.minUniformBufferOffsetAlignment);
+		}
+		if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+		{
+			alignment = std::max(alignment, limits.minStorageBufferOffsetAlignment);
+		}
+
+		// Every region starts on an aligned offset
+		this->frameSize = (frameSize + alignment - 1) & ~(alignment - 1);
+
+		device.CreateBuffer
+		(
+			this->frameSize * SwapChain::MAX_FRAMES_IN_FLIGHT,
+			usage,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer,
+			memory
+		);
+
+		// Mapped once for the lifetime of the buffer, coherent memory needs no flush
+		vkMapMemory(device.GetDevice(), memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&mapped));
+	}
+
+	FrameRingBuffer::~FrameRingBuffer()
+	{
+		// Frames in flight may still read the current regions
+		device.DeferDestroy([vkDevice = device.GetDevice(), buffer = buffer, memory = memory]()
+			{
+				vkUnmapMemory(vkDevice, memory);
+				vkDestroyBuffer(vkDevice, buffer, nullptr);
+				vkFreeMemory(vkDevice, memory, nullptr);
+			});
+	}
+
+	void FrameRingBuffer::BeginFrame(int frameIndex)
+	{
+		frameBase = frameSize * frameIndex;
+		head = frameBase;
+	}
+
+	FrameRingBuffer::Allocation FrameRingBuffer::Allocate(VkDeviceSize size)
+	{
+		VkDeviceSize offset = head;
+		VkDeviceSize alignedSize = (size + alignment - 1) & ~(alignment - 1);
+		if (offset + alignedSize > frameBase + frameSize)
+		{
+			throw std::runtime_error("Frame ring buffer is full, increase its frame size");
+		}
+
+		head += alignedSize;
+		return { mapped + offset, static_cast<uint32_t>(offset) };
+	}
+}
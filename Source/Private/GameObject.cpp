@@ -1,6 +1,182 @@
 #include "../Public/GameObject.h"
+#include "../Public/SceneHierarchy.h"
+
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <iostream>
 
 namespace Application
 {
+	namespace
+	{
+		constexpr uint32_t BENCHMARK_LIVE_OBJECTS = 100'000;
+		constexpr uint32_t BENCHMARK_CHURN_PER_FRAME = 10'000;
+		constexpr uint32_t BENCHMARK_FRAMES = 100;
+
+		double MsSince(std::chrono::high_resolution_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		// Stands in for a Model, about as large
+		struct BenchmarkModel
+		{
+			uint64_t vertexBuffer;
+			uint64_t vertexBufferMemory;
+			uint32_t vertexCount;
+			uint64_t uploadTicket;
+		};
+
+		// The object before pools, a shared model and a slot in a vector
+		struct VectorObject
+		{
+			std::shared_ptr<BenchmarkModel> model;
+			glm::vec3 color{};
+			Transform2dComponent transform2d;
+			uint32_t textureIndex = ~0u;
+			uint32_t id;
+		};
+	}
+
+	GameObject::~GameObject()
+	{
+		if (hierarchy)
+		{
+			hierarchy->Detach(*this);
+		}
+	}
+
+	void Transform2dComponent::Track(TransformChangeList* list, uint32_t index)
+	{
+		changeList = list;
+		changeIndex = index;
+		queuedStamp = 0;
+		if (changeList)
+		{
+			queuedStamp = changeList->stamp;
+			changeList->changed.push_back(changeIndex);
+		}
+	}
+
+	void Transform2dComponent::UpdateMatrix() const
+	{
+		const float s = glm::sin(rotation);
+		const float c = glm::cos(rotation);
+		glm::mat2 rotMat
+		{
+			{c, s},
+			{-s, c}
+		};
+
+		glm::mat2 scaleMat
+		{
+			{scale.x, 0.0f},
+			{0.0f, scale.y}
+		};
+		matrix = rotMat * scaleMat;
+		matrixDirty = false;
+	}
+
+	void GameObject::RunPoolBenchmark()
+	{
+		std::mt19937 random{ 5 };
+		std::cout << "Object pools, " << BENCHMARK_LIVE_OBJECTS << " live objects, " << BENCHMARK_CHURN_PER_FRAME
+			<< " despawned and spawned per frame, each with its own model" << std::endl;
+
+		// Objects live in a vector and are found through their id, removal swaps with the last
+		// one. Every move invalidates pointers to the objects.
+		{
+			std::vector<VectorObject> objects;
+			std::vector<uint32_t> positions;
+			uint32_t nextId = 0;
+			auto spawn = [&]()
+				{
+					VectorObject obj;
+					obj.model = std::make_shared<BenchmarkModel>();
+					obj.id = nextId++;
+					positions.push_back(static_cast<uint32_t>(objects.size()));
+					objects.push_back(std::move(obj));
+				};
+			for (uint32_t i = 0; i < BENCHMARK_LIVE_OBJECTS; i++)
+			{
+				spawn();
+			}
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++)
+			{
+				for (uint32_t i = 0; i < BENCHMARK_CHURN_PER_FRAME; i++)
+				{
+					const uint32_t position = static_cast<uint32_t>(random() % objects.size());
+					positions[objects.back().id] = position;
+					std::swap(objects[position], objects.back());
+					objects.pop_back();
+				}
+				for (uint32_t i = 0; i < BENCHMARK_CHURN_PER_FRAME; i++)
+				{
+					spawn();
+				}
+			}
+			double churnMs = MsSince(start) / BENCHMARK_FRAMES;
+
+			start = std::chrono::high_resolution_clock::now();
+			float sum = 0.0f;
+			for (const auto& obj : objects)
+			{
+				sum += obj.transform2d.GetTranslation().x + static_cast<float>(obj.model->vertexCount);
+			}
+			double iterateMs = MsSince(start);
+
+			std::cout << "  vector + shared models: churn " << churnMs << " ms per frame, iteration " << iterateMs
+				<< " ms (" << sum << ")" << std::endl;
+		}
+
+		{
+			GameObjectPool objects;
+			Pool<BenchmarkModel> models;
+			// Spawning never allocates once the pools hold the peak count
+			objects.Reserve(BENCHMARK_LIVE_OBJECTS);
+			models.Reserve(BENCHMARK_LIVE_OBJECTS);
+			// What gameplay code holds on to
+			std::vector<Handle<GameObject>> handles(BENCHMARK_LIVE_OBJECTS);
+			std::vector<Handle<BenchmarkModel>> modelHandles(BENCHMARK_LIVE_OBJECTS);
+			for (uint32_t i = 0; i < BENCHMARK_LIVE_OBJECTS; i++)
+			{
+				handles[i] = objects.CreateIndexed();
+				modelHandles[i] = models.Create();
+			}
+
+			uint32_t staleDetected = 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++)
+			{
+				for (uint32_t i = 0; i < BENCHMARK_CHURN_PER_FRAME; i++)
+				{
+					const size_t victim = random() % handles.size();
+					const Handle<GameObject> stale = handles[victim];
+					objects.Destroy(stale);
+					models.Destroy(modelHandles[victim]);
+					handles[victim] = objects.CreateIndexed();
+					modelHandles[victim] = models.Create();
+					// The slot is reused right away, the old handle must not reach the new object
+					staleDetected += objects.Get(stale) == nullptr ? 1 : 0;
+				}
+			}
+			double churnMs = MsSince(start) / BENCHMARK_FRAMES;
+
+			start = std::chrono::high_resolution_clock::now();
+			float sum = 0.0f;
+			objects.ForEach([&](const GameObject& obj)
+				{
+					sum += obj.transform2d.GetTranslation().x + static_cast<float>(obj.GetId() & 1);
+				});
+			double iterateMs = MsSince(start);
 
+			std::cout << "  pools: churn " << churnMs << " ms per frame, iteration " << iterateMs << " ms (" << sum
+				<< "), " << staleDetected << " of " << BENCHMARK_FRAMES * BENCHMARK_CHURN_PER_FRAME
+				<< " stale handles detected, capacity " << objects.GetCapacity() << std::endl;
+		}
+	}
 }
\ No newline at end of file
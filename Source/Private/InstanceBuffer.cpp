@@ -0,0 +1,179 @@
+#include "../Public/InstanceBuffer.h"
+#include "../Public/BindlessDescriptors.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+namespace Application
+{
+	namespace
+	{
+		// Unchanged instances between two changed ones are copied along when the gap is this
+		// small, a few more bytes are cheaper than another copy region
+		constexpr uint32_t MERGE_GAP = 4;
+
+		bool AllAlive(const GameObjectPool& gameObjects, uint32_t begin, uint32_t end)
+		{
+			for (uint32_t index = begin; index < end; index++)
+			{
+				if (!gameObjects.IsAlive(index))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Every instance plus the alignment padding of as many ranges as there can be, ranges
+		// are at least one slot apart
+		VkDeviceSize StagingFrameSize(uint32_t capacity, VkDeviceSize instanceSize)
+		{
+			const VkDeviceSize maxRanges = capacity / 2 + 1;
+			return capacity * instanceSize + maxRanges * 16;
+		}
+	}
+
+	VkVertexInputBindingDescription InstanceBuffer::Instance::GetBindingDescription(uint32_t binding)
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = binding;
+		bindingDescription.stride = sizeof(Instance);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		return bindingDescription;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> InstanceBuffer::Instance::GetAttributeDescriptions(
+		uint32_t binding, uint32_t firstLocation)
+	{
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(5);
+		attributeDescriptions[0] = { firstLocation, binding, VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, transform0) };
+		attributeDescriptions[1] = { firstLocation + 1, binding, VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, transform1) };
+		attributeDescriptions[2] = { firstLocation + 2, binding, VK_FORMAT_R32G32_SFLOAT, offsetof(Instance, offset) };
+		attributeDescriptions[3] = { firstLocation + 3, binding, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Instance, color) };
+		attributeDescriptions[4] = { firstLocation + 4, binding, VK_FORMAT_R32_SINT, offsetof(Instance, textureIndex) };
+		return attributeDescriptions;
+	}
+
+	InstanceBuffer::InstanceBuffer(Device& device, uint32_t capacity) :
+		device{device},
+		capacity{capacity},
+		staging{ device, StagingFrameSize(capacity, sizeof(Instance)), VK_BUFFER_USAGE_TRANSFER_SRC_BIT }
+	{
+		device.CreateBuffer
+		(
+			static_cast<VkDeviceSize>(capacity) * sizeof(Instance),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			buffer,
+			memory
+		);
+	}
+
+	InstanceBuffer::~InstanceBuffer()
+	{
+		device.DeferDestroy([vkDevice = device.GetDevice(), buffer = buffer, memory = memory]()
+			{
+				vkDestroyBuffer(vkDevice, buffer, nullptr);
+				vkFreeMemory(vkDevice, memory, nullptr);
+			});
+	}
+
+	void InstanceBuffer::Assign(GameObjectPool& gameObjects)
+	{
+		changeList.Clear();
+		markedIndices.clear();
+		gameObjects.ForEach([this](GameObject& obj) { Track(obj); });
+	}
+
+	void InstanceBuffer::Track(GameObject& gameObject)
+	{
+		if (gameObject.GetId() >= capacity)
+		{
+			throw std::runtime_error("Too many game objects for the instance buffer");
+		}
+		gameObject.transform2d.Track(&changeList, gameObject.GetId());
+	}
+
+	void InstanceBuffer::MarkChanged(uint32_t index)
+	{
+		markedIndices.push_back(index);
+	}
+
+	InstanceBuffer::Instance InstanceBuffer::MakeInstance(const GameObject& obj, const SceneHierarchy* hierarchy)
+	{
+		const WorldTransform2d world = hierarchy ? hierarchy->GetWorld(obj) : WorldTransform2d::FromLocal(obj.transform2d);
+		Instance instance{};
+		instance.transform0 = world.matrix[0];
+		instance.transform1 = world.matrix[1];
+		instance.offset = world.translation;
+		instance.color = obj.color;
+		instance.textureIndex = obj.textureIndex == BindlessDescriptors::INVALID_INDEX ?
+			-1 : static_cast<int32_t>(obj.textureIndex);
+		return instance;
+	}
+
+	void InstanceBuffer::Flush(int frameIndex, VkCommandBuffer commandBuffer, const GameObjectPool& gameObjects,
+		const SceneHierarchy* hierarchy)
+	{
+		staging.BeginFrame(frameIndex);
+		stats = {};
+
+		changed.assign(changeList.GetChanged().begin(), changeList.GetChanged().end());
+		changed.insert(changed.end(), markedIndices.begin(), markedIndices.end());
+		if (hierarchy)
+		{
+			changed.insert(changed.end(), hierarchy->GetChangedObjects().begin(), hierarchy->GetChangedObjects().end());
+		}
+		changeList.Clear();
+		markedIndices.clear();
+		std::sort(changed.begin(), changed.end());
+		changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+		// Objects destroyed since they changed
+		changed.erase(std::remove_if(changed.begin(), changed.end(),
+			[&](uint32_t index) { return !gameObjects.IsAlive(index); }), changed.end());
+		if (changed.empty())
+		{
+			return;
+		}
+		stats.changedCount = static_cast<uint32_t>(changed.size());
+
+		copies.clear();
+		size_t i = 0;
+		while (i < changed.size())
+		{
+			const uint32_t first = changed[i];
+			uint32_t last = first;
+			// Only live slots in between, a destroyed object's slot may never have been constructed
+			while (i + 1 < changed.size() && changed[i + 1] - last <= MERGE_GAP + 1 &&
+				AllAlive(gameObjects, last + 1, changed[i + 1]))
+			{
+				last = changed[++i];
+			}
+			i++;
+
+			const uint32_t count = last - first + 1;
+			FrameRingBuffer::Allocation allocation = staging.Allocate(count * sizeof(Instance));
+			Instance* instances = static_cast<Instance*>(allocation.data);
+			for (uint32_t j = 0; j < count; j++)
+			{
+				instances[j] = MakeInstance(gameObjects[first + j], hierarchy);
+			}
+
+			VkBufferCopy copy{};
+			copy.srcOffset = allocation.offset;
+			copy.dstOffset = static_cast<VkDeviceSize>(first) * sizeof(Instance);
+			copy.size = count * sizeof(Instance);
+			copies.push_back(copy);
+			stats.copiedBytes += copy.size;
+		}
+		stats.rangeCount = static_cast<uint32_t>(copies.size());
+
+		vkCmdCopyBuffer(commandBuffer, staging.GetBuffer(), buffer, static_cast<uint32_t>(copies.size()), copies.data());
+	}
+
+	void InstanceBuffer::Bind(VkCommandBuffer commandBuffer, uint32_t binding) const
+	{
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, binding, 1, &buffer, &offset);
+	}
+}
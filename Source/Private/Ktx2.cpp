@@ -0,0 +1,426 @@
+#include "../Public/Ktx2.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr uint8_t KTX2_IDENTIFIER[12] =
+		{
+			0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+		};
+
+		// Khronos data format descriptor color models used by universal textures
+		constexpr uint8_t KHR_DF_MODEL_ETC1S = 163;
+		constexpr uint8_t KHR_DF_MODEL_UASTC = 166;
+
+		// Transfer functions of the data format descriptor, anything else is read as linear
+		constexpr uint8_t KHR_DF_TRANSFER_SRGB = 2;
+
+		struct Ktx2Header
+		{
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+		static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be tightly packed");
+
+		struct Rgba
+		{
+			uint8_t r, g, b, a;
+		};
+
+		Rgba Unpack565(uint16_t color)
+		{
+			uint8_t r = static_cast<uint8_t>((color >> 11) & 0x1F);
+			uint8_t g = static_cast<uint8_t>((color >> 5) & 0x3F);
+			uint8_t b = static_cast<uint8_t>(color & 0x1F);
+			return { static_cast<uint8_t>((r << 3) | (r >> 2)),
+				static_cast<uint8_t>((g << 2) | (g >> 4)),
+				static_cast<uint8_t>((b << 3) | (b >> 2)), 255 };
+		}
+
+		// Decode the 8 byte color part shared by BC1, BC2 and BC3
+		void DecodeColorBlock(const uint8_t* block, bool allowPunchThrough, Rgba out[16])
+		{
+			uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+			uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+
+			Rgba palette[4];
+			palette[0] = Unpack565(c0);
+			palette[1] = Unpack565(c1);
+			if (c0 > c1 || !allowPunchThrough)
+			{
+				palette[2] = { static_cast<uint8_t>((2 * palette[0].r + palette[1].r) / 3),
+					static_cast<uint8_t>((2 * palette[0].g + palette[1].g) / 3),
+					static_cast<uint8_t>((2 * palette[0].b + palette[1].b) / 3), 255 };
+				palette[3] = { static_cast<uint8_t>((palette[0].r + 2 * palette[1].r) / 3),
+					static_cast<uint8_t>((palette[0].g + 2 * palette[1].g) / 3),
+					static_cast<uint8_t>((palette[0].b + 2 * palette[1].b) / 3), 255 };
+			}
+			else
+			{
+				palette[2] = { static_cast<uint8_t>((palette[0].r + palette[1].r) / 2),
+					static_cast<uint8_t>((palette[0].g + palette[1].g) / 2),
+					static_cast<uint8_t>((palette[0].b + palette[1].b) / 2), 255 };
+				palette[3] = { 0, 0, 0, 0 };
+			}
+
+			uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+			for (int i = 0; i < 16; i++)
+			{
+				out[i] = palette[(indices >> (2 * i)) & 0x3];
+			}
+		}
+
+		// Decode an 8 byte BC4 style block (two endpoints + 3 bit indices) into 16 values
+		void DecodeChannelBlock(const uint8_t* block, uint8_t out[16])
+		{
+			uint8_t palette[8];
+			palette[0] = block[0];
+			palette[1] = block[1];
+			if (palette[0] > palette[1])
+			{
+				for (int i = 1; i < 7; i++)
+				{
+					palette[i + 1] = static_cast<uint8_t>(((7 - i) * palette[0] + i * palette[1]) / 7);
+				}
+			}
+			else
+			{
+				for (int i = 1; i < 5; i++)
+				{
+					palette[i + 1] = static_cast<uint8_t>(((5 - i) * palette[0] + i * palette[1]) / 5);
+				}
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+
+			uint64_t indices = 0;
+			for (int i = 0; i < 6; i++)
+			{
+				indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+			}
+			for (int i = 0; i < 16; i++)
+			{
+				out[i] = palette[(indices >> (3 * i)) & 0x7];
+			}
+		}
+	}
+
+	Ktx2File::Ktx2File(const std::string& filepath) : filepath{filepath}
+	{
+		std::ifstream file{ filepath, std::ios::binary };
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open file: " + filepath);
+		}
+
+		Ktx2Header header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (!file || memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		{
+			throw std::runtime_error("Not a KTX2 file: " + filepath);
+		}
+		if (header.pixelDepth > 1 || header.faceCount > 1)
+		{
+			throw std::runtime_error("Only 2D KTX2 textures are supported: " + filepath);
+		}
+
+		format = static_cast<VkFormat>(header.vkFormat);
+		width = header.pixelWidth;
+		height = std::max(header.pixelHeight, 1u);
+		layerCount = std::max(header.layerCount, 1u);
+		supercompression = static_cast<Supercompression>(header.supercompressionScheme);
+		globalDataOffset = header.sgdByteOffset;
+		globalDataLength = header.sgdByteLength;
+
+		// Level index directly follows the header, level 0 is the largest
+		levels.resize(std::max(header.levelCount, 1u));
+		file.read(reinterpret_cast<char*>(levels.data()), levels.size() * sizeof(Level));
+		if (!file)
+		{
+			throw std::runtime_error("Truncated KTX2 level index: " + filepath);
+		}
+
+		if (header.dfdByteLength > 0)
+		{
+			std::vector<uint8_t> dfd(header.dfdByteLength);
+			file.seekg(header.dfdByteOffset);
+			file.read(reinterpret_cast<char*>(dfd.data()), dfd.size());
+			ReadDataFormatDescriptor(dfd);
+		}
+
+		if (format == VK_FORMAT_UNDEFINED && universalFormat == UniversalFormat::None)
+		{
+			throw std::runtime_error("KTX2 file has no usable format: " + filepath);
+		}
+		if (supercompression == Supercompression::Zlib ||
+			(supercompression == Supercompression::Zstandard && universalFormat != UniversalFormat::UASTC))
+		{
+			// Supercompressed data other than universal formats would need to be inflated first
+			throw std::runtime_error("Unsupported KTX2 supercompression scheme: " + filepath);
+		}
+	}
+
+	void Ktx2File::ReadDataFormatDescriptor(const std::vector<uint8_t>& dfd)
+	{
+		// dfdTotalSize (4 bytes) followed by the basic descriptor block, the color model and the
+		// transfer function are bytes 8 and 10 of the block
+		if (dfd.size() < 16)
+		{
+			return;
+		}
+		uint8_t colorModel = dfd[12];
+		srgb = dfd[14] == KHR_DF_TRANSFER_SRGB;
+		if (colorModel == KHR_DF_MODEL_ETC1S)
+		{
+			universalFormat = UniversalFormat::ETC1S;
+		}
+		else if (colorModel == KHR_DF_MODEL_UASTC)
+		{
+			universalFormat = UniversalFormat::UASTC;
+		}
+	}
+
+	std::vector<uint8_t> Ktx2File::ReadLevel(uint32_t level) const
+	{
+		std::ifstream file{ filepath, std::ios::binary };
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Failed to open file: " + filepath);
+		}
+
+		std::vector<uint8_t> data(static_cast<size_t>(levels[level].byteLength));
+		file.seekg(levels[level].byteOffset);
+		file.read(reinterpret_cast<char*>(data.data()), data.size());
+		if (!file)
+		{
+			throw std::runtime_error("Truncated KTX2 level data: " + filepath);
+		}
+		return data;
+	}
+
+	std::vector<uint8_t> Ktx2File::ReadGlobalData() const
+	{
+		std::vector<uint8_t> data(static_cast<size_t>(globalDataLength));
+		if (data.empty())
+		{
+			return data;
+		}
+
+		std::ifstream file{ filepath, std::ios::binary };
+		file.seekg(globalDataOffset);
+		file.read(reinterpret_cast<char*>(data.data()), data.size());
+		if (!file)
+		{
+			throw std::runtime_error("Truncated KTX2 global data: " + filepath);
+		}
+		return data;
+	}
+
+	bool Ktx2File::IsBlockCompressed(VkFormat format)
+	{
+		return (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK) ||
+			(format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK);
+	}
+
+	void Ktx2File::GetBlockExtent(VkFormat format, uint32_t& blockWidth, uint32_t& blockHeight)
+	{
+		if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK)
+		{
+			blockWidth = 4;
+			blockHeight = 4;
+			return;
+		}
+		if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+		{
+			// ASTC formats come in UNORM/SRGB pairs ordered by block size
+			static constexpr uint32_t astcExtents[14][2] =
+			{
+				{4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+				{8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}
+			};
+			uint32_t index = (format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2;
+			blockWidth = astcExtents[index][0];
+			blockHeight = astcExtents[index][1];
+			return;
+		}
+		blockWidth = 1;
+		blockHeight = 1;
+	}
+
+	uint32_t Ktx2File::GetBlockSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			return 8;
+		case VK_FORMAT_R8_UNORM:
+		case VK_FORMAT_R8_SRGB:
+			return 1;
+		case VK_FORMAT_R8G8_UNORM:
+		case VK_FORMAT_R8G8_SRGB:
+			return 2;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return 4;
+		default:
+			// Every other BC and ASTC block is 128 bits
+			if (IsBlockCompressed(format))
+			{
+				return 16;
+			}
+			throw std::runtime_error("Unsupported texture format");
+		}
+	}
+
+	VkDeviceSize Ktx2File::GetLevelSize(VkFormat format, uint32_t width, uint32_t height)
+	{
+		uint32_t blockWidth, blockHeight;
+		GetBlockExtent(format, blockWidth, blockHeight);
+		VkDeviceSize blocksX = (width + blockWidth - 1) / blockWidth;
+		VkDeviceSize blocksY = (height + blockHeight - 1) / blockHeight;
+		return blocksX * blocksY * GetBlockSize(format);
+	}
+
+	bool Ktx2File::CanDecodeOnCpu(VkFormat format)
+	{
+		return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC5_SNORM_BLOCK &&
+			format != VK_FORMAT_BC4_SNORM_BLOCK && format != VK_FORMAT_BC5_SNORM_BLOCK;
+	}
+
+	VkFormat Ktx2File::GetDecodedFormat(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			return VK_FORMAT_R8G8B8A8_SRGB;
+		default:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+
+	std::vector<uint8_t> Ktx2File::DecodeToRgba8(
+		VkFormat format, uint32_t width, uint32_t height, const std::vector<uint8_t>& data)
+	{
+		if (!CanDecodeOnCpu(format))
+		{
+			throw std::runtime_error("Texture format can't be decoded on the CPU");
+		}
+		assert(data.size() >= GetLevelSize(format, width, height) && "Level data is smaller than expected");
+
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+		const uint32_t blockSize = GetBlockSize(format);
+		const uint32_t blocksX = (width + 3) / 4;
+		const uint32_t blocksY = (height + 3) / 4;
+
+		for (uint32_t by = 0; by < blocksY; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; bx++)
+			{
+				const uint8_t* block = data.data() + (static_cast<size_t>(by) * blocksX + bx) * blockSize;
+				Rgba texels[16];
+
+				switch (format)
+				{
+				case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+				case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+				case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+				case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+					DecodeColorBlock(block, true, texels);
+					if (format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK)
+					{
+						for (auto& texel : texels)
+						{
+							texel.a = 255;
+						}
+					}
+					break;
+				case VK_FORMAT_BC2_UNORM_BLOCK:
+				case VK_FORMAT_BC2_SRGB_BLOCK:
+					DecodeColorBlock(block + 8, false, texels);
+					for (int i = 0; i < 16; i++)
+					{
+						uint8_t alpha = (block[i / 2] >> (4 * (i % 2))) & 0xF;
+						texels[i].a = static_cast<uint8_t>(alpha * 17);
+					}
+					break;
+				case VK_FORMAT_BC3_UNORM_BLOCK:
+				case VK_FORMAT_BC3_SRGB_BLOCK:
+				{
+					uint8_t alpha[16];
+					DecodeChannelBlock(block, alpha);
+					DecodeColorBlock(block + 8, false, texels);
+					for (int i = 0; i < 16; i++)
+					{
+						texels[i].a = alpha[i];
+					}
+					break;
+				}
+				case VK_FORMAT_BC4_UNORM_BLOCK:
+				{
+					uint8_t red[16];
+					DecodeChannelBlock(block, red);
+					for (int i = 0; i < 16; i++)
+					{
+						texels[i] = { red[i], 0, 0, 255 };
+					}
+					break;
+				}
+				default: // VK_FORMAT_BC5_UNORM_BLOCK
+				{
+					uint8_t red[16];
+					uint8_t green[16];
+					DecodeChannelBlock(block, red);
+					DecodeChannelBlock(block + 8, green);
+					for (int i = 0; i < 16; i++)
+					{
+						texels[i] = { red[i], green[i], 0, 255 };
+					}
+					break;
+				}
+				}
+
+				// Write the 4x4 block, clipping texels that fall outside of small mip levels
+				for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+				{
+					for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+					{
+						size_t dst = ((static_cast<size_t>(by) * 4 + y) * width + bx * 4 + x) * 4;
+						memcpy(&pixels[dst], &texels[y * 4 + x], 4);
+					}
+				}
+			}
+		}
+		return pixels;
+	}
+}
@@ -0,0 +1,104 @@
+#include "../Public/MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Application
+{
+#ifdef _WIN32
+	MappedFile::MappedFile(const std::string& filepath) : filepath{filepath}
+	{
+		file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			file = nullptr;
+			throw std::runtime_error("Failed to open file: " + filepath);
+		}
+
+		LARGE_INTEGER fileSize{};
+		GetFileSizeEx(file, &fileSize);
+		size = static_cast<size_t>(fileSize.QuadPart);
+		// Empty files can't be mapped, they have no data either
+		if (size == 0)
+		{
+			return;
+		}
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr)
+		{
+			data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+		if (data == nullptr)
+		{
+			if (mapping != nullptr)
+			{
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			throw std::runtime_error("Failed to map file: " + filepath);
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data != nullptr)
+		{
+			UnmapViewOfFile(data);
+			CloseHandle(mapping);
+		}
+		if (file != nullptr)
+		{
+			CloseHandle(file);
+		}
+	}
+#else
+	MappedFile::MappedFile(const std::string& filepath) : filepath{filepath}
+	{
+		file = open(filepath.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			throw std::runtime_error("Failed to open file: " + filepath);
+		}
+
+		struct stat status{};
+		fstat(file, &status);
+		size = static_cast<size_t>(status.st_size);
+		if (size == 0)
+		{
+			return;
+		}
+
+		void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (view == MAP_FAILED)
+		{
+			close(file);
+			throw std::runtime_error("Failed to map file: " + filepath);
+		}
+		data = static_cast<const uint8_t*>(view);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data != nullptr)
+		{
+			munmap(const_cast<uint8_t*>(data), size);
+		}
+		if (file >= 0)
+		{
+			close(file);
+		}
+	}
+#endif
+}
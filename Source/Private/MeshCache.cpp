@@ -0,0 +1,226 @@
+#include "../Public/MeshCache.h"
+#include "../Public/MappedFile.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr char CACHE_MAGIC[4] = { 'V', 'K', 'M', 'C' };
+		constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+		constexpr float SNORM16_MAX = 32767.0f;
+
+		uint64_t AlignUp(uint64_t value)
+		{
+			return (value + 15) & ~15ull;
+		}
+
+		uint32_t PackColor(const glm::vec3& color)
+		{
+			auto channel = [](float value)
+				{
+					return static_cast<uint32_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+				};
+			return channel(color.x) | channel(color.y) << 8 | channel(color.z) << 16 | 255u << 24;
+		}
+	}
+
+	MeshCache::MeshCache(const std::string& directory) : directory{directory}
+	{
+	}
+
+	std::string MeshCache::GetCookedPath(const std::string& sourcePath) const
+	{
+		// Same source, same name, whatever directory the app runs from
+		std::error_code error;
+		std::filesystem::path absolute = std::filesystem::absolute(sourcePath, error);
+		const std::string key = error ? sourcePath : absolute.lexically_normal().generic_string();
+
+		std::ostringstream name;
+		name << std::filesystem::path{ sourcePath }.stem().string() << '_' << std::hex << std::setw(16) << std::setfill('0')
+			<< std::hash<std::string>{}(key) << ".mesh";
+		return (std::filesystem::path{ directory } / name.str()).string();
+	}
+
+	bool MeshCache::GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+	{
+		std::error_code error;
+		size = std::filesystem::file_size(sourcePath, error);
+		if (error)
+		{
+			return false;
+		}
+		time = static_cast<int64_t>(std::filesystem::last_write_time(sourcePath, error).time_since_epoch().count());
+		return !error;
+	}
+
+	bool MeshCache::TryLoad(const std::string& sourcePath, MeshData& mesh) const
+	{
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		const std::string cookedPath = GetCookedPath(sourcePath);
+		if (!GetSourceStamp(sourcePath, sourceSize, sourceTime) || !std::filesystem::exists(cookedPath))
+		{
+			return false;
+		}
+
+		MappedFile file{ cookedPath };
+		if (file.GetSize() < sizeof(Header))
+		{
+			return false;
+		}
+		const Header& header = *reinterpret_cast<const Header*>(file.GetData());
+		// Anything unexpected is cooked again rather than trusted
+		if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != VERSION ||
+			header.byteOrder != BYTE_ORDER_MARK || header.fileSize != file.GetSize() ||
+			header.sourceSize != sourceSize || header.sourceTime != sourceTime ||
+			(header.indexSize != 2 && header.indexSize != 4))
+		{
+			return false;
+		}
+		const uint64_t positionsSize = static_cast<uint64_t>(header.vertexCount) * 2 * sizeof(int16_t);
+		const uint64_t colorsSize = static_cast<uint64_t>(header.vertexCount) * sizeof(uint32_t);
+		const uint64_t indicesSize = static_cast<uint64_t>(header.indexCount) * header.indexSize;
+		if (header.positionsOffset + positionsSize > header.fileSize || header.colorsOffset + colorsSize > header.fileSize ||
+			header.indicesOffset + indicesSize > header.fileSize)
+		{
+			return false;
+		}
+
+		const glm::vec2 boundsMin{ header.boundsMin[0], header.boundsMin[1] };
+		const glm::vec2 boundsMax{ header.boundsMax[0], header.boundsMax[1] };
+		const glm::vec2 center = (boundsMin + boundsMax) * 0.5f;
+		const glm::vec2 halfExtent = (boundsMax - boundsMin) * 0.5f / SNORM16_MAX;
+
+		const int16_t* positions = reinterpret_cast<const int16_t*>(file.GetData() + header.positionsOffset);
+		const uint8_t* colors = file.GetData() + header.colorsOffset;
+		mesh.vertices.resize(header.vertexCount);
+		for (uint32_t i = 0; i < header.vertexCount; i++)
+		{
+			Model::Vertex& vertex = mesh.vertices[i];
+			vertex.position = center + glm::vec2(positions[i * 2], positions[i * 2 + 1]) * halfExtent;
+			vertex.color = glm::vec3(colors[i * 4], colors[i * 4 + 1], colors[i * 4 + 2]) / 255.0f;
+		}
+
+		mesh.indices.resize(header.indexCount);
+		if (header.indexSize == 2)
+		{
+			const uint16_t* indices = reinterpret_cast<const uint16_t*>(file.GetData() + header.indicesOffset);
+			std::copy(indices, indices + header.indexCount, mesh.indices.begin());
+		}
+		else
+		{
+			memcpy(mesh.indices.data(), file.GetData() + header.indicesOffset, indicesSize);
+		}
+		// A stale or corrupt index would fetch past the vertex buffer on the GPU
+		const uint32_t vertexCount = header.vertexCount;
+		if (std::any_of(mesh.indices.begin(), mesh.indices.end(), [vertexCount](uint32_t index) { return index >= vertexCount; }))
+		{
+			return false;
+		}
+		return true;
+	}
+
+	void MeshCache::Store(const std::string& sourcePath, const MeshData& mesh) const
+	{
+		Header header{};
+		memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.version = VERSION;
+		header.byteOrder = BYTE_ORDER_MARK;
+		header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		header.indexSize = mesh.vertices.size() <= 0x10000 ? 2 : 4;
+		if (!GetSourceStamp(sourcePath, header.sourceSize, header.sourceTime))
+		{
+			throw std::runtime_error("Failed to read the time and size of " + sourcePath);
+		}
+
+		glm::vec2 boundsMin{ 0.0f };
+		glm::vec2 boundsMax{ 0.0f };
+		if (!mesh.vertices.empty())
+		{
+			boundsMin = boundsMax = mesh.vertices[0].position;
+			for (const auto& vertex : mesh.vertices)
+			{
+				boundsMin = glm::min(boundsMin, vertex.position);
+				boundsMax = glm::max(boundsMax, vertex.position);
+			}
+		}
+		header.boundsMin[0] = boundsMin.x;
+		header.boundsMin[1] = boundsMin.y;
+		header.boundsMax[0] = boundsMax.x;
+		header.boundsMax[1] = boundsMax.y;
+
+		// Flat axes quantize to 0 instead of dividing by zero
+		const glm::vec2 center = (boundsMin + boundsMax) * 0.5f;
+		const glm::vec2 extent = boundsMax - boundsMin;
+		const glm::vec2 scale{ extent.x > 0.0f ? 2.0f * SNORM16_MAX / extent.x : 0.0f,
+			extent.y > 0.0f ? 2.0f * SNORM16_MAX / extent.y : 0.0f };
+		std::vector<int16_t> positions(mesh.vertices.size() * 2);
+		std::vector<uint32_t> colors(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			const glm::vec2 quantized = glm::clamp(glm::round((mesh.vertices[i].position - center) * scale),
+				glm::vec2{ -SNORM16_MAX }, glm::vec2{ SNORM16_MAX });
+			positions[i * 2] = static_cast<int16_t>(quantized.x);
+			positions[i * 2 + 1] = static_cast<int16_t>(quantized.y);
+			colors[i] = PackColor(mesh.vertices[i].color);
+		}
+
+		std::vector<uint8_t> indices(mesh.indices.size() * header.indexSize);
+		if (header.indexSize == 2)
+		{
+			uint16_t* narrow = reinterpret_cast<uint16_t*>(indices.data());
+			for (size_t i = 0; i < mesh.indices.size(); i++)
+			{
+				narrow[i] = static_cast<uint16_t>(mesh.indices[i]);
+			}
+		}
+		else
+		{
+			memcpy(indices.data(), mesh.indices.data(), indices.size());
+		}
+
+		header.positionsOffset = AlignUp(sizeof(Header));
+		header.colorsOffset = AlignUp(header.positionsOffset + positions.size() * sizeof(int16_t));
+		header.indicesOffset = AlignUp(header.colorsOffset + colors.size() * sizeof(uint32_t));
+		header.fileSize = header.indicesOffset + indices.size();
+
+		std::filesystem::create_directories(directory);
+		const std::string cookedPath = GetCookedPath(sourcePath);
+		// Written under a temporary name then renamed, a reader never maps a half written file
+		std::ostringstream temporaryPath;
+		temporaryPath << cookedPath << '.' << std::this_thread::get_id() << ".tmp";
+		{
+			std::ofstream out{ temporaryPath.str(), std::ios::binary | std::ios::trunc };
+			if (!out.is_open())
+			{
+				throw std::runtime_error("Failed to open file for writing: " + temporaryPath.str());
+			}
+			auto writeAt = [&](uint64_t offset, const void* data, size_t size)
+				{
+					out.seekp(static_cast<std::streamoff>(offset));
+					out.write(static_cast<const char*>(data), size);
+				};
+			writeAt(0, &header, sizeof(header));
+			writeAt(header.positionsOffset, positions.data(), positions.size() * sizeof(int16_t));
+			writeAt(header.colorsOffset, colors.data(), colors.size() * sizeof(uint32_t));
+			writeAt(header.indicesOffset, indices.data(), indices.size());
+			if (!out)
+			{
+				throw std::runtime_error("Failed to write cooked mesh: " + temporaryPath.str());
+			}
+		}
+		std::filesystem::rename(temporaryPath.str(), cookedPath);
+	}
+}
@@ -0,0 +1,1252 @@
+#include "../Public/MeshImporter.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <cctype>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr uint32_t MAX_WORKERS = 4;
+		constexpr uint32_t GLB_MAGIC = 0x46546C67;
+		constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+		constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+		constexpr uint32_t BENCHMARK_GRID_SIZE = 512;
+
+		double MsSince(std::chrono::high_resolution_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		std::vector<uint8_t> ReadFile(const std::string& filepath)
+		{
+			std::ifstream file{ filepath, std::ios::binary | std::ios::ate };
+			if (!file.is_open())
+			{
+				throw std::runtime_error("Failed to open file: " + filepath);
+			}
+			std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+			return bytes;
+		}
+
+		std::string LowerExtension(const std::string& filepath)
+		{
+			std::string extension = std::filesystem::path{ filepath }.extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(),
+				[](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+			return extension;
+		}
+
+		// Imported mesh before flattening, colors are already resolved per vertex
+		struct SourceMesh
+		{
+			std::vector<glm::vec3> positions;
+			std::vector<glm::vec3> colors;
+			std::vector<uint32_t> indices;
+		};
+
+		// Meshes without colors show their normals, meshes without either are white
+		glm::vec3 NormalColor(const glm::vec3& normal)
+		{
+			const float length = glm::length(normal);
+			return length > 0.0f ? normal / length * 0.5f + 0.5f : glm::vec3{ 1.0f };
+		}
+
+		MeshData Flatten(const SourceMesh& source, const std::string& filepath)
+		{
+			if (source.indices.empty())
+			{
+				throw std::runtime_error("Mesh has no triangles: " + filepath);
+			}
+			for (uint32_t index : source.indices)
+			{
+				if (index >= source.positions.size())
+				{
+					throw std::runtime_error("Mesh index out of range: " + filepath);
+				}
+			}
+
+			glm::vec2 boundsMin{ source.positions[0].x, source.positions[0].y };
+			glm::vec2 boundsMax = boundsMin;
+			for (const auto& position : source.positions)
+			{
+				boundsMin = glm::min(boundsMin, glm::vec2{ position.x, position.y });
+				boundsMax = glm::max(boundsMax, glm::vec2{ position.x, position.y });
+			}
+			// Longest side to 1, y flipped since it points down on screen
+			const glm::vec2 center = (boundsMin + boundsMax) * 0.5f;
+			const float size = std::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y);
+			const glm::vec2 scale = glm::vec2{ 1.0f, -1.0f } / (size > 0.0f ? size : 1.0f);
+
+			float minDepth = source.positions[0].z;
+			float maxDepth = minDepth;
+			for (const auto& position : source.positions)
+			{
+				minDepth = std::min(minDepth, position.z);
+				maxDepth = std::max(maxDepth, position.z);
+			}
+			const float centerDepth = (minDepth + maxDepth) * 0.5f;
+
+			MeshData mesh;
+			mesh.vertices.resize(source.positions.size());
+			mesh.depths.resize(source.positions.size());
+			for (size_t i = 0; i < source.positions.size(); i++)
+			{
+				mesh.vertices[i].position = (glm::vec2{ source.positions[i].x, source.positions[i].y } - center) * scale;
+				mesh.vertices[i].color = source.colors[i];
+				mesh.depths[i] = (source.positions[i].z - centerDepth) * std::abs(scale.x);
+			}
+			mesh.indices = source.indices;
+			return mesh;
+		}
+
+		// Only what glTF needs: no duplicate key checks, numbers as doubles
+		struct JsonValue
+		{
+			enum class Type { Null, Bool, Number, String, Array, Object };
+
+			Type type = Type::Null;
+			bool boolean = false;
+			double number = 0.0;
+			std::string string;
+			std::vector<JsonValue> elements;
+			std::vector<std::pair<std::string, JsonValue>> members;
+
+			const JsonValue* Find(const std::string& key) const
+			{
+				for (const auto& member : members)
+				{
+					if (member.first == key)
+					{
+						return &member.second;
+					}
+				}
+				return nullptr;
+			}
+
+			double NumberOr(const std::string& key, double fallback) const
+			{
+				const JsonValue* value = Find(key);
+				return value != nullptr && value->type == Type::Number ? value->number : fallback;
+			}
+
+			std::string StringOr(const std::string& key, const std::string& fallback) const
+			{
+				const JsonValue* value = Find(key);
+				return value != nullptr && value->type == Type::String ? value->string : fallback;
+			}
+
+			const std::vector<JsonValue>& ArrayAt(const std::string& key) const
+			{
+				static const std::vector<JsonValue> empty;
+				const JsonValue* value = Find(key);
+				return value != nullptr && value->type == Type::Array ? value->elements : empty;
+			}
+		};
+
+		class JsonParser
+		{
+		public:
+			JsonParser(const std::string& text, const std::string& filepath) :
+				current{text.c_str()}, end{text.c_str() + text.size()}, filepath{filepath}
+			{
+			}
+
+			JsonValue Parse()
+			{
+				JsonValue value = ParseValue(0);
+				SkipWhitespace();
+				if (current != end)
+				{
+					Fail();
+				}
+				return value;
+			}
+
+		private:
+			static constexpr uint32_t MAX_DEPTH = 128;
+
+			[[noreturn]] void Fail() const
+			{
+				throw std::runtime_error("Malformed glTF JSON: " + filepath);
+			}
+
+			void SkipWhitespace()
+			{
+				while (current != end && (*current == ' ' || *current == '\t' || *current == '\n' || *current == '\r'))
+				{
+					current++;
+				}
+			}
+
+			void Expect(char c)
+			{
+				SkipWhitespace();
+				if (current == end || *current != c)
+				{
+					Fail();
+				}
+				current++;
+			}
+
+			bool Consume(const char* literal)
+			{
+				const size_t length = strlen(literal);
+				if (static_cast<size_t>(end - current) < length || strncmp(current, literal, length) != 0)
+				{
+					return false;
+				}
+				current += length;
+				return true;
+			}
+
+			JsonValue ParseValue(uint32_t depth)
+			{
+				if (depth > MAX_DEPTH)
+				{
+					Fail();
+				}
+				SkipWhitespace();
+				if (current == end)
+				{
+					Fail();
+				}
+
+				JsonValue value;
+				if (*current == '{')
+				{
+					value.type = JsonValue::Type::Object;
+					current++;
+					SkipWhitespace();
+					if (current != end && *current == '}')
+					{
+						current++;
+						return value;
+					}
+					while (true)
+					{
+						SkipWhitespace();
+						std::string key = ParseString();
+						Expect(':');
+						value.members.emplace_back(std::move(key), ParseValue(depth + 1));
+						SkipWhitespace();
+						if (current == end || *current != ',')
+						{
+							break;
+						}
+						current++;
+					}
+					Expect('}');
+				}
+				else if (*current == '[')
+				{
+					value.type = JsonValue::Type::Array;
+					current++;
+					SkipWhitespace();
+					if (current != end && *current == ']')
+					{
+						current++;
+						return value;
+					}
+					while (true)
+					{
+						value.elements.push_back(ParseValue(depth + 1));
+						SkipWhitespace();
+						if (current == end || *current != ',')
+						{
+							break;
+						}
+						current++;
+					}
+					Expect(']');
+				}
+				else if (*current == '"')
+				{
+					value.type = JsonValue::Type::String;
+					value.string = ParseString();
+				}
+				else if (Consume("true"))
+				{
+					value.type = JsonValue::Type::Bool;
+					value.boolean = true;
+				}
+				else if (Consume("false"))
+				{
+					value.type = JsonValue::Type::Bool;
+				}
+				else if (Consume("null"))
+				{
+					value.type = JsonValue::Type::Null;
+				}
+				else
+				{
+					// The text is null terminated so strtod stops inside it
+					char* numberEnd;
+					value.type = JsonValue::Type::Number;
+					value.number = std::strtod(current, &numberEnd);
+					if (numberEnd == current || numberEnd > end)
+					{
+						Fail();
+					}
+					current = numberEnd;
+				}
+				return value;
+			}
+
+			std::string ParseString()
+			{
+				if (current == end || *current != '"')
+				{
+					Fail();
+				}
+				current++;
+
+				std::string result;
+				while (current != end && *current != '"')
+				{
+					char c = *current++;
+					if (c != '\\')
+					{
+						result += c;
+						continue;
+					}
+					if (current == end)
+					{
+						Fail();
+					}
+					switch (c = *current++)
+					{
+					case 'b': result += '\b'; break;
+					case 'f': result += '\f'; break;
+					case 'n': result += '\n'; break;
+					case 'r': result += '\r'; break;
+					case 't': result += '\t'; break;
+					case 'u':
+					{
+						// Basic plane only, enough for names and URIs
+						if (end - current < 4)
+						{
+							Fail();
+						}
+						const uint32_t code = static_cast<uint32_t>(std::strtoul(std::string(current, 4).c_str(), nullptr, 16));
+						current += 4;
+						if (code < 0x80)
+						{
+							result += static_cast<char>(code);
+						}
+						else if (code < 0x800)
+						{
+							result += static_cast<char>(0xC0 | code >> 6);
+							result += static_cast<char>(0x80 | (code & 0x3F));
+						}
+						else
+						{
+							result += static_cast<char>(0xE0 | code >> 12);
+							result += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+							result += static_cast<char>(0x80 | (code & 0x3F));
+						}
+						break;
+					}
+					default: result += c; break;
+					}
+				}
+				if (current == end)
+				{
+					Fail();
+				}
+				current++;
+				return result;
+			}
+
+			const char* current;
+			const char* end;
+			const std::string& filepath;
+		};
+
+		std::vector<uint8_t> DecodeBase64(const std::string& text, size_t begin)
+		{
+			std::vector<uint8_t> bytes;
+			bytes.reserve((text.size() - begin) / 4 * 3);
+			uint32_t bits = 0;
+			uint32_t bitCount = 0;
+			for (size_t i = begin; i < text.size(); i++)
+			{
+				const char c = text[i];
+				uint32_t value;
+				if (c >= 'A' && c <= 'Z') value = c - 'A';
+				else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+				else if (c >= '0' && c <= '9') value = c - '0' + 52;
+				else if (c == '+') value = 62;
+				else if (c == '/') value = 63;
+				else continue;
+
+				bits = bits << 6 | value;
+				bitCount += 6;
+				if (bitCount >= 8)
+				{
+					bitCount -= 8;
+					bytes.push_back(static_cast<uint8_t>(bits >> bitCount));
+				}
+			}
+			return bytes;
+		}
+
+		std::string DecodeUri(const std::string& uri)
+		{
+			std::string result;
+			for (size_t i = 0; i < uri.size(); i++)
+			{
+				if (uri[i] == '%' && i + 2 < uri.size())
+				{
+					result += static_cast<char>(std::strtoul(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+					i += 2;
+				}
+				else
+				{
+					result += uri[i];
+				}
+			}
+			return result;
+		}
+
+		struct GltfFile
+		{
+			JsonValue root;
+			std::vector<std::vector<uint8_t>> buffers;
+			std::string filepath;
+		};
+
+		uint32_t ComponentCount(const std::string& type)
+		{
+			if (type == "SCALAR") return 1;
+			if (type == "VEC2") return 2;
+			if (type == "VEC3") return 3;
+			if (type == "VEC4") return 4;
+			return 0;
+		}
+
+		uint32_t ComponentSize(uint32_t componentType)
+		{
+			switch (componentType)
+			{
+			case 5120: case 5121: return 1;
+			case 5122: case 5123: return 2;
+			case 5125: case 5126: return 4;
+			default: return 0;
+			}
+		}
+
+		double ReadComponent(const uint8_t* data, uint32_t componentType, bool normalized)
+		{
+			switch (componentType)
+			{
+			case 5120: { int8_t v; memcpy(&v, data, 1); return normalized ? std::max(v / 127.0, -1.0) : v; }
+			case 5121: { uint8_t v; memcpy(&v, data, 1); return normalized ? v / 255.0 : v; }
+			case 5122: { int16_t v; memcpy(&v, data, 2); return normalized ? std::max(v / 32767.0, -1.0) : v; }
+			case 5123: { uint16_t v; memcpy(&v, data, 2); return normalized ? v / 65535.0 : v; }
+			case 5125: { uint32_t v; memcpy(&v, data, 4); return v; }
+			default: { float v; memcpy(&v, data, 4); return v; }
+			}
+		}
+
+		// Calls visit(element, component, value) for every component of the accessor
+		template<typename Visit>
+		uint32_t VisitAccessor(const GltfFile& gltf, uint32_t accessorIndex, uint32_t& componentCount, Visit visit)
+		{
+			const auto& accessors = gltf.root.ArrayAt("accessors");
+			if (accessorIndex >= accessors.size())
+			{
+				throw std::runtime_error("glTF accessor out of range: " + gltf.filepath);
+			}
+			const JsonValue& accessor = accessors[accessorIndex];
+			if (accessor.Find("sparse") != nullptr)
+			{
+				throw std::runtime_error("Sparse glTF accessors are not supported: " + gltf.filepath);
+			}
+
+			const uint32_t count = static_cast<uint32_t>(accessor.NumberOr("count", 0));
+			const uint32_t componentType = static_cast<uint32_t>(accessor.NumberOr("componentType", 0));
+			const JsonValue* normalizedValue = accessor.Find("normalized");
+			const bool normalized = normalizedValue != nullptr && normalizedValue->boolean;
+			componentCount = ComponentCount(accessor.StringOr("type", ""));
+			const uint32_t componentSize = ComponentSize(componentType);
+			if (componentCount == 0 || componentSize == 0)
+			{
+				throw std::runtime_error("Unsupported glTF accessor type: " + gltf.filepath);
+			}
+
+			// Accessors without a buffer view are all zeros
+			const JsonValue* viewIndex = accessor.Find("bufferView");
+			if (viewIndex == nullptr)
+			{
+				for (uint32_t element = 0; element < count; element++)
+				{
+					for (uint32_t component = 0; component < componentCount; component++)
+					{
+						visit(element, component, 0.0);
+					}
+				}
+				return count;
+			}
+
+			const auto& views = gltf.root.ArrayAt("bufferViews");
+			if (viewIndex->number < 0 || viewIndex->number >= views.size())
+			{
+				throw std::runtime_error("glTF buffer view out of range: " + gltf.filepath);
+			}
+			const JsonValue& view = views[static_cast<size_t>(viewIndex->number)];
+			const size_t bufferIndex = static_cast<size_t>(view.NumberOr("buffer", -1));
+			if (bufferIndex >= gltf.buffers.size())
+			{
+				throw std::runtime_error("glTF buffer out of range: " + gltf.filepath);
+			}
+			const std::vector<uint8_t>& buffer = gltf.buffers[bufferIndex];
+
+			const uint64_t elementSize = static_cast<uint64_t>(componentSize) * componentCount;
+			const uint64_t stride = static_cast<uint64_t>(view.NumberOr("byteStride", static_cast<double>(elementSize)));
+			const uint64_t viewOffset = static_cast<uint64_t>(view.NumberOr("byteOffset", 0));
+			const uint64_t viewLength = static_cast<uint64_t>(view.NumberOr("byteLength", 0));
+			const uint64_t offset = viewOffset + static_cast<uint64_t>(accessor.NumberOr("byteOffset", 0));
+			if (count > 0 && (viewOffset + viewLength > buffer.size() ||
+				offset + stride * (count - 1) + elementSize > viewOffset + viewLength))
+			{
+				throw std::runtime_error("glTF accessor reads past its buffer: " + gltf.filepath);
+			}
+
+			for (uint32_t element = 0; element < count; element++)
+			{
+				const uint8_t* data = buffer.data() + offset + stride * element;
+				for (uint32_t component = 0; component < componentCount; component++)
+				{
+					visit(element, component, ReadComponent(data + component * componentSize, componentType, normalized));
+				}
+			}
+			return count;
+		}
+
+		GltfFile OpenGltf(const std::string& filepath)
+		{
+			GltfFile gltf;
+			gltf.filepath = filepath;
+			std::vector<uint8_t> bytes = ReadFile(filepath);
+
+			std::string json;
+			std::vector<uint8_t> binaryChunk;
+			uint32_t magic = 0;
+			if (bytes.size() >= 12)
+			{
+				memcpy(&magic, bytes.data(), 4);
+			}
+			if (magic == GLB_MAGIC)
+			{
+				uint32_t version;
+				memcpy(&version, bytes.data() + 4, 4);
+				if (version != 2)
+				{
+					throw std::runtime_error("Unsupported glb version " + std::to_string(version) + ": " + filepath);
+				}
+				size_t offset = 12;
+				while (offset + 8 <= bytes.size())
+				{
+					uint32_t chunkLength;
+					uint32_t chunkType;
+					memcpy(&chunkLength, bytes.data() + offset, 4);
+					memcpy(&chunkType, bytes.data() + offset + 4, 4);
+					if (chunkLength > bytes.size() - offset - 8)
+					{
+						throw std::runtime_error("Truncated glb chunk: " + filepath);
+					}
+					const uint8_t* chunk = bytes.data() + offset + 8;
+					if (chunkType == GLB_CHUNK_JSON && json.empty())
+					{
+						json.assign(reinterpret_cast<const char*>(chunk), chunkLength);
+					}
+					else if (chunkType == GLB_CHUNK_BIN && binaryChunk.empty())
+					{
+						binaryChunk.assign(chunk, chunk + chunkLength);
+					}
+					offset += 8 + ((static_cast<size_t>(chunkLength) + 3) & ~size_t{ 3 });
+				}
+			}
+			else
+			{
+				json.assign(bytes.begin(), bytes.end());
+			}
+			gltf.root = JsonParser{ json, filepath }.Parse();
+
+			const std::filesystem::path directory = std::filesystem::path{ filepath }.parent_path();
+			for (const auto& buffer : gltf.root.ArrayAt("buffers"))
+			{
+				const std::string uri = buffer.StringOr("uri", "");
+				if (uri.empty())
+				{
+					// Only the first buffer of a glb can live in its binary chunk
+					gltf.buffers.push_back(gltf.buffers.empty() ? binaryChunk : std::vector<uint8_t>{});
+				}
+				else if (uri.compare(0, 5, "data:") == 0)
+				{
+					const size_t comma = uri.find(',');
+					if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos)
+					{
+						throw std::runtime_error("Only base64 data URIs are supported: " + filepath);
+					}
+					gltf.buffers.push_back(DecodeBase64(uri, comma + 1));
+				}
+				else
+				{
+					gltf.buffers.push_back(ReadFile((directory / DecodeUri(uri)).string()));
+				}
+
+				if (gltf.buffers.back().size() < static_cast<size_t>(buffer.NumberOr("byteLength", 0)))
+				{
+					throw std::runtime_error("glTF buffer is shorter than its byteLength: " + filepath);
+				}
+			}
+			return gltf;
+		}
+
+		// Byte-wise equality, Vertex has no padding
+		struct VertexHash
+		{
+			size_t operator()(const Model::Vertex& vertex) const
+			{
+				uint64_t hash = 14695981039346656037ull;
+				const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&vertex);
+				for (size_t i = 0; i < sizeof(Model::Vertex); i++)
+				{
+					hash = (hash ^ bytes[i]) * 1099511628211ull;
+				}
+				return static_cast<size_t>(hash);
+			}
+		};
+
+		struct VertexEqual
+		{
+			bool operator()(const Model::Vertex& a, const Model::Vertex& b) const
+			{
+				return memcmp(&a, &b, sizeof(Model::Vertex)) == 0;
+			}
+		};
+
+		static_assert(sizeof(Model::Vertex) == 5 * sizeof(float), "Vertex welding compares padding bytes");
+
+		// Same grid as .obj and .glb, positions on a bumpy surface with normals
+		struct BenchmarkGrid
+		{
+			std::vector<glm::vec3> positions;
+			std::vector<glm::vec3> normals;
+			std::vector<uint32_t> indices;
+		};
+
+		BenchmarkGrid CreateBenchmarkGrid(uint32_t size)
+		{
+			BenchmarkGrid grid;
+			for (uint32_t y = 0; y <= size; y++)
+			{
+				for (uint32_t x = 0; x <= size; x++)
+				{
+					const float u = static_cast<float>(x) / size;
+					const float v = static_cast<float>(y) / size;
+					const float height = 0.05f * std::sin(u * 20.0f) * std::cos(v * 20.0f);
+					grid.positions.push_back({ u, v, height });
+					grid.normals.push_back(glm::normalize(glm::vec3{
+						-std::cos(u * 20.0f) * std::cos(v * 20.0f), std::sin(u * 20.0f) * std::sin(v * 20.0f), 1.0f }));
+				}
+			}
+			for (uint32_t y = 0; y < size; y++)
+			{
+				for (uint32_t x = 0; x < size; x++)
+				{
+					const uint32_t corner = y * (size + 1) + x;
+					grid.indices.insert(grid.indices.end(),
+						{ corner, corner + 1, corner + size + 2, corner, corner + size + 2, corner + size + 1 });
+				}
+			}
+			return grid;
+		}
+
+		void WriteBenchmarkObj(const std::string& filepath, const BenchmarkGrid& grid)
+		{
+			std::ofstream out{ filepath };
+			out << "# Benchmark grid\n";
+			for (const auto& position : grid.positions)
+			{
+				out << "v " << position.x << ' ' << position.y << ' ' << position.z << '\n';
+			}
+			for (const auto& normal : grid.normals)
+			{
+				out << "vn " << normal.x << ' ' << normal.y << ' ' << normal.z << '\n';
+			}
+			for (size_t i = 0; i < grid.indices.size(); i += 3)
+			{
+				out << 'f';
+				for (size_t corner = 0; corner < 3; corner++)
+				{
+					const uint32_t index = grid.indices[i + corner] + 1;
+					out << ' ' << index << "//" << index;
+				}
+				out << '\n';
+			}
+		}
+
+		void WriteBenchmarkGlb(const std::string& filepath, const BenchmarkGrid& grid)
+		{
+			const size_t attributeSize = grid.positions.size() * sizeof(glm::vec3);
+			const size_t indicesSize = grid.indices.size() * sizeof(uint32_t);
+			std::vector<uint8_t> binary(attributeSize * 2 + indicesSize);
+			memcpy(binary.data(), grid.positions.data(), attributeSize);
+			memcpy(binary.data() + attributeSize, grid.normals.data(), attributeSize);
+			memcpy(binary.data() + attributeSize * 2, grid.indices.data(), indicesSize);
+
+			std::ostringstream json;
+			json << R"({"asset":{"version":"2.0"},"buffers":[{"byteLength":)" << binary.size() << "}],"
+				<< R"("bufferViews":[{"buffer":0,"byteLength":)" << attributeSize << "},"
+				<< R"({"buffer":0,"byteOffset":)" << attributeSize << R"(,"byteLength":)" << attributeSize << "},"
+				<< R"({"buffer":0,"byteOffset":)" << attributeSize * 2 << R"(,"byteLength":)" << indicesSize << "}],"
+				<< R"("accessors":[{"bufferView":0,"componentType":5126,"type":"VEC3","count":)" << grid.positions.size() << "},"
+				<< R"({"bufferView":1,"componentType":5126,"type":"VEC3","count":)" << grid.normals.size() << "},"
+				<< R"({"bufferView":2,"componentType":5125,"type":"SCALAR","count":)" << grid.indices.size() << "}],"
+				<< R"("meshes":[{"primitives":[{"attributes":{"POSITION":0,"NORMAL":1},"indices":2}]}]})";
+			std::string jsonChunk = json.str();
+			jsonChunk.resize((jsonChunk.size() + 3) & ~size_t{ 3 }, ' ');
+			binary.resize((binary.size() + 3) & ~size_t{ 3 }, 0);
+
+			auto writeU32 = [](std::ofstream& out, uint32_t value) { out.write(reinterpret_cast<const char*>(&value), 4); };
+			std::ofstream out{ filepath, std::ios::binary };
+			writeU32(out, GLB_MAGIC);
+			writeU32(out, 2);
+			writeU32(out, static_cast<uint32_t>(12 + 8 + jsonChunk.size() + 8 + binary.size()));
+			writeU32(out, static_cast<uint32_t>(jsonChunk.size()));
+			writeU32(out, GLB_CHUNK_JSON);
+			out.write(jsonChunk.data(), jsonChunk.size());
+			writeU32(out, static_cast<uint32_t>(binary.size()));
+			writeU32(out, GLB_CHUNK_BIN);
+			out.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+		}
+	}
+
+	MeshImporter::MeshImporter(Device& device, ModelPool& models, const Model::VertexLayout& vertexLayout,
+		const std::string& cacheDirectory, uint32_t workerCount) :
+		device{device}, models{models}, vertexLayout{vertexLayout}, cache{cacheDirectory}
+	{
+		if (workerCount == 0)
+		{
+			workerCount = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_WORKERS);
+		}
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back(&MeshImporter::WorkerLoop, this);
+		}
+	}
+
+	MeshImporter::~MeshImporter()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ queueMutex };
+			stopWorkers = true;
+		}
+		queueCondition.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	void MeshImporter::Load(const std::string& filepath, LoadedCallback onLoaded)
+	{
+		auto [entry, inserted] = meshes.try_emplace(filepath);
+		LoadedMesh& mesh = entry->second;
+		if (!mesh.pending && models.IsValid(mesh.model))
+		{
+			onLoaded(mesh.model);
+			return;
+		}
+
+		mesh.callbacks.push_back(std::move(onLoaded));
+		// Imported before but the model was destroyed since, import it again
+		if (inserted || !mesh.pending)
+		{
+			mesh.pending = true;
+			pendingCount++;
+			{
+				std::lock_guard<std::mutex> lock{ queueMutex };
+				requests.push_back({ filepath });
+			}
+			queueCondition.notify_one();
+		}
+	}
+
+	void MeshImporter::Update()
+	{
+		std::vector<ImportResult> completed;
+		{
+			std::lock_guard<std::mutex> lock{ queueMutex };
+			completed.swap(results);
+		}
+
+		for (auto& result : completed)
+		{
+			pendingCount--;
+			auto entry = meshes.find(result.filepath);
+			if (!result.error.empty())
+			{
+				std::cout << "Failed to import " << result.filepath << ": " << result.error << std::endl;
+				meshes.erase(entry);
+				continue;
+			}
+
+			LoadedMesh& mesh = entry->second;
+			mesh.model = models.Create(device, result.mesh.vertices, result.mesh.indices, vertexLayout);
+			mesh.pending = false;
+			std::cout << "Imported " << result.filepath << (result.info.fromCache ? " from cache" : "") << ": "
+				<< result.mesh.vertices.size() << " vertices, " << result.mesh.indices.size() / 3 << " triangles in "
+				<< result.info.milliseconds << " ms";
+			if (!result.info.fromCache)
+			{
+				std::cout << ", ACMR " << result.info.importedCache.acmr << " -> " << result.info.cookedCache.acmr
+					<< ", ATVR " << result.info.importedCache.atvr << " -> " << result.info.cookedCache.atvr;
+			}
+			std::cout << std::endl;
+
+			// A callback may load more meshes, don't iterate the list it could grow
+			std::vector<LoadedCallback> callbacks = std::move(mesh.callbacks);
+			const Handle<Model> model = mesh.model;
+			for (auto& callback : callbacks)
+			{
+				callback(model);
+			}
+		}
+	}
+
+	bool MeshImporter::IsIdle() const
+	{
+		return pendingCount == 0;
+	}
+
+	void MeshImporter::WorkerLoop()
+	{
+		while (true)
+		{
+			ImportRequest request;
+			{
+				std::unique_lock<std::mutex> lock{ queueMutex };
+				queueCondition.wait(lock, [this] { return stopWorkers || !requests.empty(); });
+				if (stopWorkers)
+				{
+					return;
+				}
+				request = std::move(requests.front());
+				requests.pop_front();
+			}
+
+			ImportResult result;
+			result.filepath = request.filepath;
+			try
+			{
+				result.mesh = LoadMesh(request.filepath, cache, &result.info);
+			}
+			catch (const std::exception& e)
+			{
+				result.error = e.what();
+			}
+
+			std::lock_guard<std::mutex> lock{ queueMutex };
+			results.push_back(std::move(result));
+		}
+	}
+
+	MeshData MeshImporter::LoadMesh(const std::string& filepath, const MeshCache& cache, LoadInfo* info)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		MeshData mesh;
+		const bool fromCache = cache.TryLoad(filepath, mesh);
+		if (!fromCache)
+		{
+			const std::string extension = LowerExtension(filepath);
+			if (extension == ".obj")
+			{
+				mesh = ImportObj(filepath);
+			}
+			else if (extension == ".gltf" || extension == ".glb")
+			{
+				mesh = ImportGltf(filepath);
+			}
+			else
+			{
+				throw std::runtime_error("Unsupported mesh format: " + filepath);
+			}
+			const uint32_t importedVertexCount = static_cast<uint32_t>(mesh.vertices.size());
+			const MeshOptimizer::VertexCacheStats importedCache =
+				MeshOptimizer::AnalyzeVertexCache(mesh.indices, importedVertexCount);
+			Cook(mesh);
+			if (info != nullptr)
+			{
+				info->importedCache = importedCache;
+				info->cookedCache = MeshOptimizer::AnalyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+			}
+
+			// The mesh is fine without its cooked copy, it will be imported again next time
+			try
+			{
+				cache.Store(filepath, mesh);
+			}
+			catch (const std::exception& e)
+			{
+				std::cout << "Failed to cook " << filepath << ": " << e.what() << std::endl;
+			}
+		}
+
+		if (info != nullptr)
+		{
+			info->fromCache = fromCache;
+			info->milliseconds = MsSince(start);
+		}
+		return mesh;
+	}
+
+	MeshData MeshImporter::ImportObj(const std::string& filepath)
+	{
+		std::vector<uint8_t> bytes = ReadFile(filepath);
+		// strtof needs a terminator at the end of the last line
+		bytes.push_back('\0');
+		const char* current = reinterpret_cast<const char*>(bytes.data());
+		const char* end = current + bytes.size() - 1;
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> positionColors;
+		std::vector<glm::vec3> normals;
+		bool hasColors = false;
+
+		SourceMesh source;
+		// One vertex per distinct position and normal pair
+		std::unordered_map<uint64_t, uint32_t> corners;
+		std::vector<uint32_t> polygon;
+
+		auto resolve = [&](long index, size_t count)
+			{
+				// 1 based, negative counts back from the last element read so far
+				const long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+				if (index == 0 || resolved < 0 || static_cast<size_t>(resolved) >= count)
+				{
+					throw std::runtime_error("OBJ face index out of range: " + filepath);
+				}
+				return static_cast<uint32_t>(resolved);
+			};
+
+		while (current < end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(current, '\n', end - current));
+			if (lineEnd == nullptr)
+			{
+				lineEnd = end;
+			}
+			while (current < lineEnd && (*current == ' ' || *current == '\t'))
+			{
+				current++;
+			}
+
+			auto readFloats = [&](float* values, int count)
+				{
+					int read = 0;
+					for (; read < count; read++)
+					{
+						char* next;
+						values[read] = std::strtof(current, &next);
+						if (next == current || next > lineEnd)
+						{
+							break;
+						}
+						current = next;
+					}
+					return read;
+				};
+
+			if (lineEnd - current > 2 && current[0] == 'v' && (current[1] == ' ' || current[1] == '\t'))
+			{
+				current += 2;
+				float values[6];
+				const int read = readFloats(values, 6);
+				if (read < 3)
+				{
+					throw std::runtime_error("OBJ vertex needs 3 coordinates: " + filepath);
+				}
+				positions.push_back({ values[0], values[1], values[2] });
+				// Vertex colors are a common extension: v x y z r g b
+				positionColors.push_back(read == 6 ? glm::vec3{ values[3], values[4], values[5] } : glm::vec3{ 1.0f });
+				hasColors = hasColors || read == 6;
+			}
+			else if (lineEnd - current > 3 && current[0] == 'v' && current[1] == 'n' && (current[2] == ' ' || current[2] == '\t'))
+			{
+				current += 3;
+				float values[3];
+				if (readFloats(values, 3) < 3)
+				{
+					throw std::runtime_error("OBJ normal needs 3 coordinates: " + filepath);
+				}
+				normals.push_back({ values[0], values[1], values[2] });
+			}
+			else if (lineEnd - current > 2 && current[0] == 'f' && (current[1] == ' ' || current[1] == '\t'))
+			{
+				current += 2;
+				polygon.clear();
+				while (true)
+				{
+					// v, v/t, v//n or v/t/n, texture coordinates are not used
+					char* next;
+					const long positionIndex = std::strtol(current, &next, 10);
+					if (next == current || next > lineEnd)
+					{
+						break;
+					}
+					current = next;
+					long normalIndex = 0;
+					if (*current == '/')
+					{
+						current++;
+						if (*current != '/')
+						{
+							std::strtol(current, &next, 10);
+							current = next;
+						}
+						if (*current == '/')
+						{
+							current++;
+							normalIndex = std::strtol(current, &next, 10);
+							current = next;
+						}
+					}
+
+					const uint32_t position = resolve(positionIndex, positions.size());
+					const uint32_t normal = normalIndex != 0 ? resolve(normalIndex, normals.size()) : ~0u;
+					const uint64_t key = static_cast<uint64_t>(position) << 32 | normal;
+					auto [corner, inserted] = corners.try_emplace(key, static_cast<uint32_t>(source.positions.size()));
+					if (inserted)
+					{
+						source.positions.push_back(positions[position]);
+						source.colors.push_back(hasColors || normal == ~0u ? positionColors[position] : NormalColor(normals[normal]));
+					}
+					polygon.push_back(corner->second);
+				}
+
+				if (polygon.size() < 3)
+				{
+					throw std::runtime_error("OBJ face needs 3 vertices: " + filepath);
+				}
+				// Faces are convex polygons, fan them out from the first vertex
+				for (size_t i = 1; i + 1 < polygon.size(); i++)
+				{
+					source.indices.insert(source.indices.end(), { polygon[0], polygon[i], polygon[i + 1] });
+				}
+			}
+			current = lineEnd + 1;
+		}
+		return Flatten(source, filepath);
+	}
+
+	MeshData MeshImporter::ImportGltf(const std::string& filepath)
+	{
+		const GltfFile gltf = OpenGltf(filepath);
+
+		SourceMesh source;
+		for (const auto& mesh : gltf.root.ArrayAt("meshes"))
+		{
+			for (const auto& primitive : mesh.ArrayAt("primitives"))
+			{
+				// Triangle lists only, points, lines, strips and fans are skipped
+				if (primitive.NumberOr("mode", 4) != 4)
+				{
+					continue;
+				}
+				const JsonValue* attributes = primitive.Find("attributes");
+				if (attributes == nullptr || attributes->Find("POSITION") == nullptr)
+				{
+					continue;
+				}
+
+				const uint32_t baseVertex = static_cast<uint32_t>(source.positions.size());
+				uint32_t componentCount;
+				const uint32_t vertexCount = VisitAccessor(gltf, static_cast<uint32_t>(attributes->NumberOr("POSITION", 0)),
+					componentCount, [&](uint32_t, uint32_t component, double value)
+					{
+						if (component == 0)
+						{
+							source.positions.emplace_back(0.0f);
+						}
+						if (component < 3)
+						{
+							source.positions.back()[component] = static_cast<float>(value);
+						}
+					});
+				source.colors.resize(source.positions.size(), glm::vec3{ 1.0f });
+
+				auto readColors = [&](const char* attribute, bool isNormal)
+					{
+						std::vector<glm::vec3> values(vertexCount, glm::vec3{ 0.0f });
+						const uint32_t count = VisitAccessor(gltf, static_cast<uint32_t>(attributes->NumberOr(attribute, 0)),
+							componentCount, [&](uint32_t element, uint32_t component, double value)
+							{
+								if (element < vertexCount && component < 3)
+								{
+									values[element][component] = static_cast<float>(value);
+								}
+							});
+						if (count != vertexCount)
+						{
+							throw std::runtime_error(std::string{ "glTF " } + attribute + " count doesn't match POSITION: " + filepath);
+						}
+						for (uint32_t i = 0; i < vertexCount; i++)
+						{
+							source.colors[baseVertex + i] = isNormal ? NormalColor(values[i]) : values[i];
+						}
+					};
+				if (attributes->Find("COLOR_0") != nullptr)
+				{
+					readColors("COLOR_0", false);
+				}
+				else if (attributes->Find("NORMAL") != nullptr)
+				{
+					readColors("NORMAL", true);
+				}
+
+				if (primitive.Find("indices") != nullptr)
+				{
+					const size_t firstIndex = source.indices.size();
+					VisitAccessor(gltf, static_cast<uint32_t>(primitive.NumberOr("indices", 0)), componentCount,
+						[&](uint32_t, uint32_t, double value)
+						{
+							source.indices.push_back(baseVertex + static_cast<uint32_t>(value));
+						});
+					for (size_t i = firstIndex; i < source.indices.size(); i++)
+					{
+						if (source.indices[i] >= source.positions.size())
+						{
+							throw std::runtime_error("glTF index out of range: " + filepath);
+						}
+					}
+					source.indices.resize(firstIndex + (source.indices.size() - firstIndex) / 3 * 3);
+				}
+				else
+				{
+					for (uint32_t i = 0; i + 2 < vertexCount; i += 3)
+					{
+						source.indices.insert(source.indices.end(), { baseVertex + i, baseVertex + i + 1, baseVertex + i + 2 });
+					}
+				}
+			}
+		}
+		return Flatten(source, filepath);
+	}
+
+	void MeshImporter::Cook(MeshData& mesh)
+	{
+		// Weld vertices that came out identical, then drop triangles that collapsed
+		std::unordered_map<Model::Vertex, uint32_t, VertexHash, VertexEqual> unique;
+		unique.reserve(mesh.vertices.size());
+		std::vector<uint32_t> welded(mesh.vertices.size());
+		std::vector<Model::Vertex> vertices;
+		std::vector<glm::vec3> positions;
+		for (uint32_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			auto [entry, inserted] = unique.try_emplace(mesh.vertices[i], static_cast<uint32_t>(vertices.size()));
+			if (inserted)
+			{
+				vertices.push_back(mesh.vertices[i]);
+				positions.push_back({ mesh.vertices[i].position, mesh.depths.empty() ? 0.0f : mesh.depths[i] });
+			}
+			welded[i] = entry->second;
+		}
+
+		std::vector<uint32_t> indices;
+		indices.reserve(mesh.indices.size());
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const uint32_t a = welded[mesh.indices[i]];
+			const uint32_t b = welded[mesh.indices[i + 1]];
+			const uint32_t c = welded[mesh.indices[i + 2]];
+			if (a != b && b != c && c != a)
+			{
+				indices.insert(indices.end(), { a, b, c });
+			}
+		}
+
+		// The depth the flattening dropped still tells which parts hide the others
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		indices = MeshOptimizer::OptimizeVertexCache(indices, vertexCount);
+		indices = MeshOptimizer::OptimizeOverdraw(indices, positions);
+		MeshOptimizer::RemapVertices(vertices, MeshOptimizer::OptimizeVertexFetch(indices, vertexCount));
+
+		mesh.vertices = std::move(vertices);
+		mesh.indices = std::move(indices);
+		mesh.depths.clear();
+	}
+
+	void MeshImporter::RunBenchmark()
+	{
+		const std::filesystem::path directory = std::filesystem::temp_directory_path() / "VulkanMeshBenchmark";
+		std::filesystem::remove_all(directory);
+		std::filesystem::create_directories(directory);
+		const MeshCache cache{ (directory / "Cache").string() };
+
+		const BenchmarkGrid grid = CreateBenchmarkGrid(BENCHMARK_GRID_SIZE);
+		const std::string objPath = (directory / "Grid.obj").string();
+		const std::string glbPath = (directory / "Grid.glb").string();
+		WriteBenchmarkObj(objPath, grid);
+		WriteBenchmarkGlb(glbPath, grid);
+		std::cout << "Mesh import benchmark: " << grid.positions.size() << " vertices, " << grid.indices.size() / 3
+			<< " triangles" << std::endl;
+
+		for (const std::string& path : { objPath, glbPath })
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			MeshData mesh = LowerExtension(path) == ".obj" ? ImportObj(path) : ImportGltf(path);
+			const double parseMs = MsSince(start);
+
+			const MeshOptimizer::VertexCacheStats importedCache =
+				MeshOptimizer::AnalyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+			start = std::chrono::high_resolution_clock::now();
+			Cook(mesh);
+			const double cookMs = MsSince(start);
+			const MeshOptimizer::VertexCacheStats cookedCache =
+				MeshOptimizer::AnalyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+
+			start = std::chrono::high_resolution_clock::now();
+			cache.Store(path, mesh);
+			const double storeMs = MsSince(start);
+
+			start = std::chrono::high_resolution_clock::now();
+			MeshData cached;
+			if (!cache.TryLoad(path, cached))
+			{
+				throw std::runtime_error("Cooked mesh was not found again: " + path);
+			}
+			const double cachedMs = MsSince(start);
+
+			float maxError = 0.0f;
+			for (size_t i = 0; i < mesh.vertices.size(); i++)
+			{
+				const glm::vec2 error = glm::abs(mesh.vertices[i].position - cached.vertices[i].position);
+				maxError = std::max({ maxError, error.x, error.y });
+			}
+
+			std::cout << "  " << std::filesystem::path{ path }.filename().string() << " ("
+				<< std::filesystem::file_size(path) / 1024 << " KiB): cold " << parseMs + cookMs + storeMs
+				<< " ms (parse " << parseMs << ", cook " << cookMs << ", store " << storeMs << "), cached " << cachedMs
+				<< " ms (" << std::filesystem::file_size(cache.GetCookedPath(path)) / 1024 << " KiB), "
+				<< mesh.vertices.size() << " vertices after welding, ACMR " << importedCache.acmr << " -> " << cookedCache.acmr
+				<< ", ATVR " << importedCache.atvr << " -> " << cookedCache.atvr << ", max position error " << maxError << std::endl;
+		}
+
+		std::filesystem::remove_all(directory);
+	}
+}
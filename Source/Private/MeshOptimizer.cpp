@@ -0,0 +1,540 @@
+#include "../Public/MeshOptimizer.h"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr uint32_t INVALID_VERTEX = ~0u;
+		constexpr uint32_t OVERDRAW_RESOLUTION = 256;
+		constexpr uint32_t FETCH_LINE_SIZE = 64;
+		constexpr uint32_t FETCH_CACHE_LINES = 16 * 1024 / FETCH_LINE_SIZE;
+
+		double MsSince(std::chrono::high_resolution_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		// Cache of the optimizers: a vertex is cached while fewer than cacheSize vertices were
+		// added after it. Adding cacheSize + 1 to the time empties it.
+		class TimestampCache
+		{
+		public:
+			TimestampCache(uint32_t vertexCount, uint32_t cacheSize) :
+				cacheTimes(vertexCount, 0), time{cacheSize + 1}, cacheSize{cacheSize}
+			{
+			}
+
+			bool Contains(uint32_t vertex) const { return time - cacheTimes[vertex] <= cacheSize; }
+			uint32_t Age(uint32_t vertex) const { return time - cacheTimes[vertex]; }
+			uint32_t GetTime() const { return time; }
+
+			// Returns whether the vertex had to be transformed
+			bool Use(uint32_t vertex)
+			{
+				if (Contains(vertex))
+				{
+					return false;
+				}
+				cacheTimes[vertex] = time++;
+				return true;
+			}
+
+			uint32_t UseTriangle(const uint32_t* triangle)
+			{
+				return Use(triangle[0]) + Use(triangle[1]) + Use(triangle[2]);
+			}
+
+			void Flush()
+			{
+				time += cacheSize + 1;
+			}
+
+		private:
+			std::vector<uint32_t> cacheTimes;
+			uint32_t time;
+			uint32_t cacheSize;
+		};
+
+		struct BenchmarkMesh
+		{
+			std::string name;
+			std::vector<glm::vec3> positions;
+			std::vector<uint32_t> indices;
+		};
+
+		// Rows and columns of quads over a parametric surface, counter-clockwise seen from outside
+		template<typename Surface>
+		BenchmarkMesh CreateSurface(const std::string& name, uint32_t rows, uint32_t columns, Surface surface)
+		{
+			BenchmarkMesh mesh;
+			mesh.name = name;
+			for (uint32_t row = 0; row <= rows; row++)
+			{
+				for (uint32_t column = 0; column <= columns; column++)
+				{
+					mesh.positions.push_back(surface(static_cast<float>(row) / rows, static_cast<float>(column) / columns));
+				}
+			}
+			for (uint32_t row = 0; row < rows; row++)
+			{
+				for (uint32_t column = 0; column < columns; column++)
+				{
+					const uint32_t corner = row * (columns + 1) + column;
+					const uint32_t below = corner + columns + 1;
+					mesh.indices.insert(mesh.indices.end(), { corner, below, corner + 1, corner + 1, below, below + 1 });
+				}
+			}
+			return mesh;
+		}
+	}
+
+	MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices,
+		uint32_t vertexCount, uint32_t cacheSize)
+	{
+		// FIFO: a vertex leaves after cacheSize misses, hits don't refresh it
+		std::vector<int64_t> insertedAt(vertexCount, std::numeric_limits<int64_t>::min() / 2);
+		std::vector<bool> referenced(vertexCount, false);
+		int64_t misses = 0;
+		uint32_t referencedCount = 0;
+		for (uint32_t index : indices)
+		{
+			if (misses - insertedAt[index] > cacheSize)
+			{
+				insertedAt[index] = misses++;
+			}
+			if (!referenced[index])
+			{
+				referenced[index] = true;
+				referencedCount++;
+			}
+		}
+
+		VertexCacheStats stats;
+		const size_t triangleCount = indices.size() / 3;
+		stats.acmr = triangleCount > 0 ? static_cast<float>(misses) / triangleCount : 0.0f;
+		stats.atvr = referencedCount > 0 ? static_cast<float>(misses) / referencedCount : 0.0f;
+		return stats;
+	}
+
+	float MeshOptimizer::AnalyzeVertexFetch(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t vertexSize)
+	{
+		std::vector<uint64_t> tags(FETCH_CACHE_LINES, ~0ull);
+		std::vector<bool> referenced(vertexCount, false);
+		uint64_t fetchedBytes = 0;
+		uint64_t referencedBytes = 0;
+		for (uint32_t index : indices)
+		{
+			if (!referenced[index])
+			{
+				referenced[index] = true;
+				referencedBytes += vertexSize;
+			}
+			// A vertex may straddle two lines
+			const uint64_t first = static_cast<uint64_t>(index) * vertexSize / FETCH_LINE_SIZE;
+			const uint64_t last = (static_cast<uint64_t>(index) * vertexSize + vertexSize - 1) / FETCH_LINE_SIZE;
+			for (uint64_t line = first; line <= last; line++)
+			{
+				uint64_t& tag = tags[line % FETCH_CACHE_LINES];
+				if (tag != line)
+				{
+					tag = line;
+					fetchedBytes += FETCH_LINE_SIZE;
+				}
+			}
+		}
+		return referencedBytes > 0 ? static_cast<float>(fetchedBytes) / referencedBytes : 0.0f;
+	}
+
+	float MeshOptimizer::AnalyzeOverdraw(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions)
+	{
+		if (indices.empty())
+		{
+			return 1.0f;
+		}
+		glm::vec3 boundsMin = positions[indices[0]];
+		glm::vec3 boundsMax = boundsMin;
+		for (uint32_t index : indices)
+		{
+			boundsMin = glm::min(boundsMin, positions[index]);
+			boundsMax = glm::max(boundsMax, positions[index]);
+		}
+		const glm::vec3 extent = boundsMax - boundsMin;
+		const float scale = (OVERDRAW_RESOLUTION - 1) / std::max({ extent.x, extent.y, extent.z, 1e-20f });
+
+		uint64_t shaded = 0;
+		uint64_t covered = 0;
+		std::vector<float> depth(OVERDRAW_RESOLUTION * OVERDRAW_RESOLUTION);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const int uAxis = (axis + 1) % 3;
+			const int vAxis = (axis + 2) % 3;
+			for (float direction : { 1.0f, -1.0f })
+			{
+				std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+				for (size_t i = 0; i + 2 < indices.size(); i += 3)
+				{
+					glm::vec3 corners[3];
+					for (int c = 0; c < 3; c++)
+					{
+						const glm::vec3 position = (positions[indices[i + c]] - boundsMin) * scale;
+						corners[c] = { position[uAxis], position[vAxis], position[axis] * direction };
+					}
+					// Smaller depth is closer, so the viewer is on the -direction side. Faces towards
+					// it wind clockwise in (u, v) when that is the negative side, counter-clockwise otherwise.
+					const float area = (corners[1].x - corners[0].x) * (corners[2].y - corners[0].y) -
+						(corners[1].y - corners[0].y) * (corners[2].x - corners[0].x);
+					if (area * direction >= 0.0f)
+					{
+						continue;
+					}
+
+					const int minX = std::max(0, static_cast<int>(std::ceil(std::min({ corners[0].x, corners[1].x, corners[2].x }))));
+					const int minY = std::max(0, static_cast<int>(std::ceil(std::min({ corners[0].y, corners[1].y, corners[2].y }))));
+					const int maxX = std::min<int>(OVERDRAW_RESOLUTION - 1, static_cast<int>(std::max({ corners[0].x, corners[1].x, corners[2].x })));
+					const int maxY = std::min<int>(OVERDRAW_RESOLUTION - 1, static_cast<int>(std::max({ corners[0].y, corners[1].y, corners[2].y })));
+					for (int y = minY; y <= maxY; y++)
+					{
+						for (int x = minX; x <= maxX; x++)
+						{
+							// Barycentric weights from the edge functions, all of one sign inside
+							float weights[3];
+							for (int c = 0; c < 3; c++)
+							{
+								const glm::vec3& a = corners[(c + 1) % 3];
+								const glm::vec3& b = corners[(c + 2) % 3];
+								weights[c] = ((b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x)) / area;
+							}
+							if (weights[0] < 0.0f || weights[1] < 0.0f || weights[2] < 0.0f)
+							{
+								continue;
+							}
+							const float z = weights[0] * corners[0].z + weights[1] * corners[1].z + weights[2] * corners[2].z;
+							float& pixelDepth = depth[y * OVERDRAW_RESOLUTION + x];
+							if (z < pixelDepth)
+							{
+								pixelDepth = z;
+								shaded++;
+							}
+						}
+					}
+				}
+				covered += std::count_if(depth.begin(), depth.end(), [](float d) { return d != std::numeric_limits<float>::max(); });
+			}
+		}
+		return covered > 0 ? static_cast<float>(shaded) / covered : 1.0f;
+	}
+
+	std::vector<uint32_t> MeshOptimizer::OptimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount,
+		uint32_t cacheSize)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		// Triangles of every vertex, liveCounts is how many of them are still to be emitted
+		std::vector<uint32_t> liveCounts(vertexCount, 0);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+		{
+			liveCounts[indices[i]]++;
+		}
+		std::vector<uint32_t> offsets(vertexCount + 1, 0);
+		for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+		{
+			offsets[vertex + 1] = offsets[vertex] + liveCounts[vertex];
+		}
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[cursors[indices[i]]++] = i / 3;
+		}
+
+		TimestampCache cache{ vertexCount, cacheSize };
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnds;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> result;
+		result.reserve(triangleCount * 3);
+		uint32_t scanVertex = 0;
+
+		auto nextUnfinished = [&]()
+			{
+				// Recently used vertices first, they may still be in the cache
+				while (!deadEnds.empty())
+				{
+					const uint32_t vertex = deadEnds.back();
+					deadEnds.pop_back();
+					if (liveCounts[vertex] > 0)
+					{
+						return vertex;
+					}
+				}
+				for (; scanVertex < vertexCount; scanVertex++)
+				{
+					if (liveCounts[scanVertex] > 0)
+					{
+						return scanVertex;
+					}
+				}
+				return INVALID_VERTEX;
+			};
+
+		// Emit every triangle around the fanning vertex, then move to the neighbour that will
+		// still be in the cache once its own triangles are emitted and has been there the longest
+		uint32_t fanning = nextUnfinished();
+		while (fanning != INVALID_VERTEX)
+		{
+			candidates.clear();
+			for (uint32_t i = offsets[fanning]; i < offsets[fanning + 1]; i++)
+			{
+				const uint32_t triangle = adjacency[i];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+				emitted[triangle] = true;
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const uint32_t vertex = indices[triangle * 3 + corner];
+					result.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					liveCounts[vertex]--;
+					cache.Use(vertex);
+				}
+			}
+
+			uint32_t best = INVALID_VERTEX;
+			int64_t bestPriority = -1;
+			for (uint32_t vertex : candidates)
+			{
+				if (liveCounts[vertex] == 0)
+				{
+					continue;
+				}
+				// Each remaining triangle may add two vertices before the fan is done
+				int64_t priority = 0;
+				if (cache.Age(vertex) + 2 * liveCounts[vertex] <= cacheSize)
+				{
+					priority = cache.Age(vertex);
+				}
+				if (priority > bestPriority)
+				{
+					best = vertex;
+					bestPriority = priority;
+				}
+			}
+			fanning = best != INVALID_VERTEX ? best : nextUnfinished();
+		}
+		return result;
+	}
+
+	std::vector<uint32_t> MeshOptimizer::OptimizeOverdraw(const std::vector<uint32_t>& indices,
+		const std::vector<glm::vec3>& positions, uint32_t cacheSize, float threshold)
+	{
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (triangleCount == 0)
+		{
+			return indices;
+		}
+		TimestampCache cache{ static_cast<uint32_t>(positions.size()), cacheSize };
+
+		// Hard boundaries: the cache has nothing of the triangle, reordering there is free
+		std::vector<uint32_t> hardBoundaries;
+		for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			if (cache.UseTriangle(&indices[triangle * 3]) == 3 || triangle == 0)
+			{
+				hardBoundaries.push_back(triangle);
+			}
+		}
+		hardBoundaries.push_back(triangleCount);
+
+		// Soft boundaries: restarting the cache there keeps the ACMR close to the cluster's
+		std::vector<uint32_t> clusters;
+		for (size_t hard = 0; hard + 1 < hardBoundaries.size(); hard++)
+		{
+			const uint32_t start = hardBoundaries[hard];
+			const uint32_t end = hardBoundaries[hard + 1];
+
+			cache.Flush();
+			uint32_t misses = 0;
+			for (uint32_t triangle = start; triangle < end; triangle++)
+			{
+				misses += cache.UseTriangle(&indices[triangle * 3]);
+			}
+			const float clusterThreshold = threshold * misses / (end - start);
+
+			cache.Flush();
+			clusters.push_back(start);
+			uint32_t clusterStart = start;
+			misses = 0;
+			for (uint32_t triangle = start; triangle < end; triangle++)
+			{
+				misses += cache.UseTriangle(&indices[triangle * 3]);
+				if (triangle + 1 < end && misses <= clusterThreshold * (triangle + 1 - clusterStart))
+				{
+					clusters.push_back(triangle + 1);
+					clusterStart = triangle + 1;
+					misses = 0;
+					cache.Flush();
+				}
+			}
+		}
+		clusters.push_back(triangleCount);
+
+		// Area weighted centroid and normal of every cluster
+		const size_t clusterCount = clusters.size() - 1;
+		std::vector<glm::vec3> centroids(clusterCount, glm::vec3{ 0.0f });
+		std::vector<glm::vec3> normals(clusterCount, glm::vec3{ 0.0f });
+		std::vector<float> areas(clusterCount, 0.0f);
+		glm::vec3 meshCentroid{ 0.0f };
+		float meshArea = 0.0f;
+		for (size_t cluster = 0; cluster < clusterCount; cluster++)
+		{
+			for (uint32_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; triangle++)
+			{
+				const glm::vec3& a = positions[indices[triangle * 3]];
+				const glm::vec3& b = positions[indices[triangle * 3 + 1]];
+				const glm::vec3& c = positions[indices[triangle * 3 + 2]];
+				const glm::vec3 normal = glm::cross(b - a, c - a);
+				const float area = glm::length(normal);
+				centroids[cluster] += (a + b + c) * (area / 3.0f);
+				normals[cluster] += normal;
+				areas[cluster] += area;
+			}
+			meshCentroid += centroids[cluster];
+			meshArea += areas[cluster];
+			centroids[cluster] /= std::max(areas[cluster], std::numeric_limits<float>::min());
+		}
+		meshCentroid /= std::max(meshArea, std::numeric_limits<float>::min());
+
+		// Clusters far out and facing away from the center hide the others, they go first
+		std::vector<float> sortKeys(clusterCount);
+		for (size_t cluster = 0; cluster < clusterCount; cluster++)
+		{
+			const float normalLength = glm::length(normals[cluster]);
+			sortKeys[cluster] = normalLength > 0.0f ?
+				glm::dot(centroids[cluster] - meshCentroid, normals[cluster] / normalLength) : 0.0f;
+		}
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<uint32_t> result;
+		result.reserve(indices.size());
+		for (uint32_t cluster : order)
+		{
+			result.insert(result.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+		}
+		return result;
+	}
+
+	std::vector<uint32_t> MeshOptimizer::OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount)
+	{
+		std::vector<uint32_t> remap(vertexCount, INVALID_VERTEX);
+		uint32_t nextVertex = 0;
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == INVALID_VERTEX)
+			{
+				remap[index] = nextVertex++;
+			}
+			index = remap[index];
+		}
+		return remap;
+	}
+
+	void MeshOptimizer::RunBenchmark()
+	{
+		const float pi = glm::pi<float>();
+		std::vector<BenchmarkMesh> meshes;
+		meshes.push_back(CreateSurface("Grid 512x512", 512, 512, [](float u, float v)
+			{
+				return glm::vec3{ u, v, 0.0f };
+			}));
+		meshes.push_back(CreateSurface("Sphere 256x512", 256, 512, [pi](float u, float v)
+			{
+				const float theta = u * pi;
+				const float phi = v * 2.0f * pi;
+				return glm::vec3{ std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta) };
+			}));
+		meshes.push_back(CreateSurface("Torus 256x512", 256, 512, [pi](float u, float v)
+			{
+				const float tube = u * 2.0f * pi;
+				const float ring = v * 2.0f * pi;
+				const float radius = 1.0f + 0.4f * std::cos(tube);
+				return glm::vec3{ radius * std::cos(ring), radius * std::sin(ring), -0.4f * std::sin(tube) };
+			}));
+
+		std::cout << "Mesh optimizer benchmark, " << CACHE_SIZE << " entry FIFO cache" << std::endl;
+		std::cout << std::fixed << std::setprecision(3);
+		for (BenchmarkMesh& mesh : meshes)
+		{
+			const uint32_t vertexCount = static_cast<uint32_t>(mesh.positions.size());
+			// Vertices numbered in no particular order, as after welding a triangle soup
+			std::vector<uint32_t> numbering(vertexCount);
+			std::iota(numbering.begin(), numbering.end(), 0);
+			std::shuffle(numbering.begin(), numbering.end(), std::mt19937{ 5 });
+			RemapVertices(mesh.positions, numbering);
+			for (uint32_t& index : mesh.indices)
+			{
+				index = numbering[index];
+			}
+			std::cout << mesh.name << ": " << vertexCount << " vertices, " << mesh.indices.size() / 3 << " triangles" << std::endl;
+			auto report = [&](const char* order, const std::vector<uint32_t>& indices, double milliseconds)
+				{
+					const VertexCacheStats stats = AnalyzeVertexCache(indices, vertexCount);
+					std::cout << "  " << std::left << std::setw(20) << order << std::right << " ACMR " << stats.acmr
+						<< "  ATVR " << stats.atvr << "  overdraw " << AnalyzeOverdraw(indices, mesh.positions);
+					if (milliseconds > 0.0)
+					{
+						std::cout << "  in " << milliseconds << " ms";
+					}
+					std::cout << std::endl;
+				};
+			report("authored", mesh.indices, 0.0);
+
+			// Triangle soup order, what an exporter that doesn't care may produce
+			std::vector<uint32_t> shuffled = mesh.indices;
+			std::vector<uint32_t> triangles(shuffled.size() / 3);
+			std::iota(triangles.begin(), triangles.end(), 0);
+			std::shuffle(triangles.begin(), triangles.end(), std::mt19937{ 3 });
+			for (size_t i = 0; i < triangles.size(); i++)
+			{
+				std::copy_n(mesh.indices.begin() + triangles[i] * 3, 3, shuffled.begin() + i * 3);
+			}
+			report("shuffled", shuffled, 0.0);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			const std::vector<uint32_t> cacheOptimized = OptimizeVertexCache(shuffled, vertexCount);
+			report("vertex cache", cacheOptimized, MsSince(start));
+
+			start = std::chrono::high_resolution_clock::now();
+			std::vector<uint32_t> overdrawOptimized = OptimizeOverdraw(cacheOptimized, mesh.positions);
+			report("+ overdraw", overdrawOptimized, MsSince(start));
+
+			// Renumbering changes neither statistic above, only how the vertices are read
+			constexpr uint32_t vertexSize = sizeof(glm::vec3);
+			const float overfetchBefore = AnalyzeVertexFetch(overdrawOptimized, vertexCount, vertexSize);
+			start = std::chrono::high_resolution_clock::now();
+			const std::vector<uint32_t> remap = OptimizeVertexFetch(overdrawOptimized, vertexCount);
+			std::vector<glm::vec3> positions = mesh.positions;
+			RemapVertices(positions, remap);
+			const double fetchMs = MsSince(start);
+			std::cout << "  + vertex fetch       overfetch " << overfetchBefore << " -> "
+				<< AnalyzeVertexFetch(overdrawOptimized, vertexCount, vertexSize) << "  in " << fetchMs << " ms" << std::endl;
+		}
+		std::cout << std::defaultfloat;
+	}
+}
@@ -1,79 +1,368 @@
 #include "../Public/Model.h"
+#include "../Public/Uploader.h"
 
 #include <cassert>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <iostream>
+#include <stdexcept>
+#include <string>
 namespace Application
 {
-	Model::Model(Device& device, const std::vector<Vertex>& verticies) :
-		device{device}
+	namespace
+	{
+		constexpr float SNORM16_MAX = 32767.0f;
+
+		uint32_t PositionSize(Model::VertexLayout::PositionFormat format)
+		{
+			return format == Model::VertexLayout::PositionFormat::Float32 ? 2 * sizeof(float) : 2 * sizeof(uint16_t);
+		}
+
+		uint32_t ColorSize(Model::VertexLayout::ColorFormat format)
+		{
+			return format == Model::VertexLayout::ColorFormat::Float32 ? 3 * sizeof(float) : 4 * sizeof(uint8_t);
+		}
+
+		uint8_t ToUnorm8(float value)
+		{
+			return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+		}
+
+		// Rounds to nearest even, overflows to infinity and keeps NaNs
+		uint16_t FloatToHalf(float value)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			const uint16_t sign = static_cast<uint16_t>(bits >> 16 & 0x8000);
+			const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+			if (magnitude >= 0x7F800000)
+			{
+				return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+			}
+			// 65520 and up round to infinity
+			if (magnitude >= 0x477FF000)
+			{
+				return sign | 0x7C00;
+			}
+			// Below the smallest normal half the value is a multiple of 2^-24
+			if (magnitude < 0x38800000)
+			{
+				float absolute;
+				memcpy(&absolute, &magnitude, sizeof(absolute));
+				return sign | static_cast<uint16_t>(std::nearbyint(absolute * 16777216.0f));
+			}
+			// Rebias the exponent, drop 13 mantissa bits rounding to even
+			const uint32_t rebiased = magnitude - 0x38000000;
+			const uint32_t rounded = rebiased + 0xFFF + (rebiased >> 13 & 1);
+			return sign | static_cast<uint16_t>(rounded >> 13);
+		}
+
+		float HalfToFloat(uint16_t half)
+		{
+			const float sign = half & 0x8000 ? -1.0f : 1.0f;
+			const uint32_t exponent = half >> 10 & 0x1F;
+			const uint32_t mantissa = half & 0x3FF;
+			if (exponent == 0)
+			{
+				return sign * std::ldexp(static_cast<float>(mantissa), -24);
+			}
+			if (exponent == 31)
+			{
+				return mantissa == 0 ? sign * std::numeric_limits<float>::infinity() : std::numeric_limits<float>::quiet_NaN();
+			}
+			return sign * std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+		}
+	}
+
+	Model::Model(Device& device, const std::vector<Vertex>& verticies, const std::vector<uint32_t>& indices,
+		const VertexLayout& layout) :
+		device{device}, layout{layout}
 	{
 		CreateVertexBuffers(verticies);
+		if (!indices.empty())
+		{
+			CreateIndexBuffer(indices);
+		}
 	}
 
 	Model::~Model()
 	{
-		vkDestroyBuffer(device.GetDevice(), vertexBuffer, nullptr);
-		vkFreeMemory(device.GetDevice(), vertexBufferMemory, nullptr);
+		// In-flight frames may still read the vertex and index buffers, the transfer queue may
+		// still write them. Tickets are submitted in order, the later one is done after both.
+		device.GetUploader().DeferDestroy(std::max(vertexUploadTicket, indexUploadTicket), [vkDevice = device.GetDevice(), buffer = vertexBuffer, memory = vertexBufferMemory,
+			indices = indexBuffer, indexMemory = indexBufferMemory]()
+			{
+				vkDestroyBuffer(vkDevice, buffer, nullptr);
+				vkFreeMemory(vkDevice, memory, nullptr);
+				if (indices != VK_NULL_HANDLE)
+				{
+					vkDestroyBuffer(vkDevice, indices, nullptr);
+					vkFreeMemory(vkDevice, indexMemory, nullptr);
+				}
+			});
+	}
+
+	uint32_t Model::VertexLayout::GetStride() const
+	{
+		return PositionSize(position) + ColorSize(color);
 	}
 
-	std::vector<VkVertexInputBindingDescription> Model::Vertex::GetBindingDescriptions()
+	std::vector<VkVertexInputBindingDescription> Model::VertexLayout::GetBindingDescriptions() const
 	{
 		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
 		bindingDescriptions[0].binding = 0;
-		bindingDescriptions[0].stride = sizeof(Vertex);
+		bindingDescriptions[0].stride = GetStride();
 		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 		return bindingDescriptions;
 	}
 
-	std::vector<VkVertexInputAttributeDescription> Model::Vertex::GetAttributeDescriptions()
+	std::vector<VkVertexInputAttributeDescription> Model::VertexLayout::GetAttributeDescriptions() const
 	{
+		// Every format here is one Vulkan requires for vertex buffers
 		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
 		// Vertex attribute
 		attributeDescriptions[0].location = 0;
 		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, position);
+		attributeDescriptions[0].format =
+			position == PositionFormat::Half ? VK_FORMAT_R16G16_SFLOAT :
+			position == PositionFormat::Snorm16 ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[0].offset = 0;
 		// Color attribute
 		attributeDescriptions[1].location = 1;
 		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
+		attributeDescriptions[1].format = color == ColorFormat::Unorm8 ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[1].offset = PositionSize(position);
 		return attributeDescriptions;
 	}
 
+	std::vector<uint8_t> Model::VertexLayout::Pack(const std::vector<Vertex>& vertices) const
+	{
+		const uint32_t stride = GetStride();
+		const uint32_t colorOffset = PositionSize(position);
+		std::vector<uint8_t> data(vertices.size() * stride);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			uint8_t* vertex = data.data() + i * stride;
+			const glm::vec2& p = vertices[i].position;
+			if (position == PositionFormat::Half)
+			{
+				const uint16_t packed[2]{ FloatToHalf(p.x), FloatToHalf(p.y) };
+				memcpy(vertex, packed, sizeof(packed));
+			}
+			else if (position == PositionFormat::Snorm16)
+			{
+				if (std::abs(p.x) > 1.0f || std::abs(p.y) > 1.0f)
+				{
+					throw std::runtime_error("Vertex position out of the [-1, 1] range of snorm16 positions");
+				}
+				const int16_t packed[2]
+				{
+					static_cast<int16_t>(std::lround(p.x * SNORM16_MAX)),
+					static_cast<int16_t>(std::lround(p.y * SNORM16_MAX))
+				};
+				memcpy(vertex, packed, sizeof(packed));
+			}
+			else
+			{
+				memcpy(vertex, &p, sizeof(p));
+			}
+
+			const glm::vec3& c = vertices[i].color;
+			if (color == ColorFormat::Unorm8)
+			{
+				const uint8_t packed[4]{ ToUnorm8(c.x), ToUnorm8(c.y), ToUnorm8(c.z), 255 };
+				memcpy(vertex + colorOffset, packed, sizeof(packed));
+			}
+			else
+			{
+				memcpy(vertex + colorOffset, &c, sizeof(c));
+			}
+		}
+		return data;
+	}
+
+	std::vector<Model::Vertex> Model::VertexLayout::Unpack(const std::vector<uint8_t>& data) const
+	{
+		const uint32_t stride = GetStride();
+		const uint32_t colorOffset = PositionSize(position);
+		std::vector<Vertex> vertices(data.size() / stride);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const uint8_t* vertex = data.data() + i * stride;
+			glm::vec2& p = vertices[i].position;
+			if (position == PositionFormat::Half)
+			{
+				uint16_t packed[2];
+				memcpy(packed, vertex, sizeof(packed));
+				p = { HalfToFloat(packed[0]), HalfToFloat(packed[1]) };
+			}
+			else if (position == PositionFormat::Snorm16)
+			{
+				int16_t packed[2];
+				memcpy(packed, vertex, sizeof(packed));
+				// As the GPU reads snorm, -32768 is -1 too
+				p = { std::max(packed[0] / SNORM16_MAX, -1.0f), std::max(packed[1] / SNORM16_MAX, -1.0f) };
+			}
+			else
+			{
+				memcpy(&p, vertex, sizeof(p));
+			}
+
+			glm::vec3& c = vertices[i].color;
+			if (color == ColorFormat::Unorm8)
+			{
+				const uint8_t* packed = vertex + colorOffset;
+				c = { packed[0] / 255.0f, packed[1] / 255.0f, packed[2] / 255.0f };
+			}
+			else
+			{
+				memcpy(&c, vertex + colorOffset, sizeof(c));
+			}
+		}
+		return vertices;
+	}
+
+	void Model::VertexLayout::RunPrecisionTest()
+	{
+		constexpr uint32_t VERTEX_COUNT = 1'000'000;
+		std::mt19937 random{ 17 };
+		std::uniform_real_distribution<float> coordinate{ -1.0f, 1.0f };
+		std::uniform_real_distribution<float> channel{ 0.0f, 1.0f };
+		std::vector<Vertex> vertices(VERTEX_COUNT);
+		for (auto& vertex : vertices)
+		{
+			vertex.position = { coordinate(random), coordinate(random) };
+			vertex.color = { channel(random), channel(random), channel(random) };
+		}
+		// The extremes of the ranges
+		vertices[0] = { { -1.0f, 1.0f }, { 0.0f, 1.0f, 0.5f } };
+		vertices[1] = { { 0.0f, -0.0f }, { 1.0f, 0.0f, 0.0f } };
+
+		const std::pair<const char*, VertexLayout> layouts[]
+		{
+			{ "float32 / float32", Full() },
+			{ "half / unorm8", { PositionFormat::Half, ColorFormat::Unorm8 } },
+			{ "snorm16 / unorm8", Compact() }
+		};
+		std::cout << "Vertex layout precision, " << VERTEX_COUNT << " vertices in [-1, 1]" << std::endl;
+		for (const auto& [name, layout] : layouts)
+		{
+			const std::vector<uint8_t> packed = layout.Pack(vertices);
+			const std::vector<Vertex> unpacked = layout.Unpack(packed);
+
+			float positionError = 0.0f;
+			float colorError = 0.0f;
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				const glm::vec2 p = glm::abs(unpacked[i].position - vertices[i].position);
+				const glm::vec3 c = glm::abs(unpacked[i].color - vertices[i].color);
+				positionError = std::max({ positionError, p.x, p.y });
+				colorError = std::max({ colorError, c.x, c.y, c.z });
+			}
+
+			// Half the step of the format, with a percent of room for the float math
+			const float positionBound =
+				layout.position == PositionFormat::Half ? std::ldexp(1.0f, -12) :
+				layout.position == PositionFormat::Snorm16 ? 0.5f / SNORM16_MAX : 0.0f;
+			const float colorBound = layout.color == ColorFormat::Unorm8 ? 0.5f / 255.0f : 0.0f;
+			// At the 800 pixel window width the whole [-1, 1] range is 400 pixels per unit
+			std::cout << "  " << name << ": " << layout.GetStride() << " bytes per vertex, "
+				<< packed.size() / 1024 << " KiB, max position error " << positionError << " (" << positionError * 400.0f
+				<< " px), max color error " << colorError << std::endl;
+			if (positionError > positionBound * 1.01f || colorError > colorBound * 1.01f)
+			{
+				throw std::runtime_error(std::string{ "Vertex layout " } + name + " loses more precision than its formats allow");
+			}
+		}
+	}
+
 	void Model::CreateVertexBuffers(const std::vector<Vertex>& verticies)
 	{
 		vertexCount = static_cast<uint32_t>(verticies.size());
 		assert(vertexCount >= 3 && "We need at least 3 verticies to render something !");
 
-		VkDeviceSize bufferSize = sizeof(verticies[0]) * vertexCount;
+		// Packed first, the buffer is as large as the layout needs
+		std::vector<uint8_t> data = layout.Pack(verticies);
+		VkDeviceSize bufferSize = data.size();
 		device.CreateBuffer
 		(
 			bufferSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			vertexBuffer,
 			vertexBufferMemory
 		);
 
-		// Copying data to vertex buffer
-		void* data;
-		vkMapMemory(device.GetDevice(), vertexBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, verticies.data(), static_cast<size_t>(bufferSize));
-		vkUnmapMemory(device.GetDevice(), vertexBufferMemory);
+		// Copied on the transfer queue, the model is drawn once it reaches the graphics queue
+		vertexUploadTicket = device.GetUploader().UploadBuffer(vertexBuffer, 0, std::move(data),
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+
+	void Model::CreateIndexBuffer(const std::vector<uint32_t>& indices)
+	{
+		indexCount = static_cast<uint32_t>(indices.size());
+		indexType = vertexCount <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+		std::vector<uint8_t> data;
+		if (indexType == VK_INDEX_TYPE_UINT16)
+		{
+			data.resize(indices.size() * sizeof(uint16_t));
+			uint16_t* narrow = reinterpret_cast<uint16_t*>(data.data());
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				narrow[i] = static_cast<uint16_t>(indices[i]);
+			}
+		}
+		else
+		{
+			data.resize(indices.size() * sizeof(uint32_t));
+			memcpy(data.data(), indices.data(), data.size());
+		}
+
+		device.CreateBuffer
+		(
+			data.size(),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			indexBuffer,
+			indexBufferMemory
+		);
+
+		indexUploadTicket = device.GetUploader().UploadBuffer(indexBuffer, 0, std::move(data),
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 	}
 
-	void Model::Bind(VkCommandBuffer commandBuffer)
+	bool Model::IsReady() const
+	{
+		const Uploader& uploader = device.GetUploader();
+		return uploader.IsAvailable(vertexUploadTicket) && uploader.IsAvailable(indexUploadTicket);
+	}
+
+	void Model::Bind(VkCommandBuffer commandBuffer) const
 	{
 		VkBuffer buffers[]{ vertexBuffer };
 		VkDeviceSize offsets[] = {0};
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-
+		if (indexCount > 0)
+		{
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+		}
 	}
 
-	void Model::Draw(VkCommandBuffer commandBuffer)
+	void Model::Draw(VkCommandBuffer commandBuffer, uint32_t firstInstance) const
 	{
-		vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
-
+		if (indexCount > 0)
+		{
+			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, firstInstance);
+		}
+		else
+		{
+			vkCmdDraw(commandBuffer, vertexCount, 1, 0, firstInstance);
+		}
 	}
 
 }
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "../Public/ParticleSystem.h"
+#include "../Public/SwapChain.h"
+
+#include <stdexcept>
+#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr float BENCHMARK_DELTA_TIME = 1.0f / 60.0f;
+		constexpr uint32_t BENCHMARK_WARMUP_STEPS = 10;
+		constexpr uint32_t BENCHMARK_STEPS = 100;
+	}
+
+	ParticleSystem::ParticleSystem(
+		Device& device,
+		AsyncCompute& asyncCompute,
+		DescriptorAllocator& descriptorAllocator,
+		const RenderTargetInfo& target,
+		uint32_t capacity) : device{device}, asyncCompute{asyncCompute}, capacity{capacity}
+	{
+		CreateBuffers();
+		CreateDescriptorSets(descriptorAllocator);
+		CreatePipelines(target);
+	}
+
+	ParticleSystem::~ParticleSystem()
+	{
+		device.DeferDestroy([vkDevice = device.GetDevice(), layout = pipelineLayout,
+			particleBuffers = particleBuffers, particleMemories = particleMemories,
+			scratchBuffer = scratchBuffer, scratchMemory = scratchMemory,
+			argsBuffer = argsBuffer, argsMemory = argsMemory]()
+			{
+				vkDestroyPipelineLayout(vkDevice, layout, nullptr);
+				for (size_t i = 0; i < particleBuffers.size(); i++)
+				{
+					vkDestroyBuffer(vkDevice, particleBuffers[i], nullptr);
+					vkFreeMemory(vkDevice, particleMemories[i], nullptr);
+				}
+				vkDestroyBuffer(vkDevice, scratchBuffer, nullptr);
+				vkFreeMemory(vkDevice, scratchMemory, nullptr);
+				vkDestroyBuffer(vkDevice, argsBuffer, nullptr);
+				vkFreeMemory(vkDevice, argsMemory, nullptr);
+			});
+	}
+
+	void ParticleSystem::CreateBuffers()
+	{
+		// Written on the compute queue and read by the graphics queue
+		std::vector<uint32_t> sharedFamilies = device.GetGraphicsComputeFamilies();
+		VkDeviceSize particleBytes = static_cast<VkDeviceSize>(capacity) * sizeof(Particle);
+		for (size_t i = 0; i < particleBuffers.size(); i++)
+		{
+			device.CreateBuffer(
+				particleBytes,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				particleBuffers[i],
+				particleMemories[i],
+				sharedFamilies);
+		}
+		// Only used within a compute submission
+		device.CreateBuffer(
+			particleBytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			scratchBuffer,
+			scratchMemory);
+		device.CreateBuffer(
+			sizeof(DrawArgs) * 2,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			argsBuffer,
+			argsMemory,
+			sharedFamilies);
+	}
+
+	void ParticleSystem::CreateDescriptorSets(DescriptorAllocator& descriptorAllocator)
+	{
+		// 0: particles read, 1: particles written, 2: scratch, 3: draw arguments of both buffers
+		std::vector<VkDescriptorSetLayoutBinding> bindings(4);
+		for (uint32_t i = 0; i < bindings.size(); i++)
+		{
+			bindings[i].binding = i;
+			bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+		}
+		setLayout = descriptorAllocator.GetLayout(bindings);
+
+		for (uint32_t i = 0; i < descriptorSets.size(); i++)
+		{
+			descriptorSets[i] = descriptorAllocator.Allocate(setLayout);
+			DescriptorWriter{}
+				.WriteBuffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { particleBuffers[i], 0, VK_WHOLE_SIZE })
+				.WriteBuffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { particleBuffers[1 - i], 0, VK_WHOLE_SIZE })
+				.WriteBuffer(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { scratchBuffer, 0, VK_WHOLE_SIZE })
+				.WriteBuffer(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, { argsBuffer, 0, VK_WHOLE_SIZE })
+				.Update(device, descriptorSets[i]);
+		}
+	}
+
+	void ParticleSystem::CreatePipelines(const RenderTargetInfo& target)
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(device.GetDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create particle pipeline layout");
+		}
+
+		simulatePipeline = std::make_unique<ComputePipeline>(device, "Resources/Shaders/ParticleSimulate.comp.spv", pipelineLayout);
+		compactPipeline = std::make_unique<ComputePipeline>(device, "Resources/Shaders/ParticleCompact.comp.spv", pipelineLayout);
+		emitPipeline = std::make_unique<ComputePipeline>(device, "Resources/Shaders/ParticleEmit.comp.spv", pipelineLayout);
+
+		PipelineConfigInfo pipelineConfig{};
+		Pipeline::DefaultPipelineConfigInfo(pipelineConfig);
+		Pipeline::SetRenderTarget(pipelineConfig, target);
+		// Quads are built from the vertex index and the particle buffer
+		pipelineConfig.bindingDescriptions.clear();
+		pipelineConfig.attributeDescriptions.clear();
+		// Additive, particles don't need sorting
+		pipelineConfig.colorBlendAttachment.blendEnable = VK_TRUE;
+		pipelineConfig.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		pipelineConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipelineConfig.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		pipelineConfig.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		pipelineConfig.pipelineLayout = pipelineLayout;
+		renderPipeline = std::make_unique<Pipeline>(
+			device,
+			"Resources/Shaders/Particle.vert.spv",
+			"Resources/Shaders/Particle.frag.spv",
+			pipelineConfig);
+	}
+
+	void ParticleSystem::RecordStep(VkCommandBuffer commandBuffer, float deltaTime, uint32_t emitCount)
+	{
+		PushConstants push{};
+		push.emitterPosition = emitter.position;
+		push.deltaTime = deltaTime;
+		push.minLife = emitter.minLife;
+		push.maxLife = emitter.maxLife;
+		push.capacity = capacity;
+		push.emitCount = emitCount;
+		push.inIndex = current;
+		push.seed = step++;
+
+		// No particles yet, the first step reads a zero count. Cleared in its own submission
+		// rather than a blocking one at creation.
+		if (push.seed == 0)
+		{
+			vkCmdFillBuffer(commandBuffer, argsBuffer, 0, VK_WHOLE_SIZE, 0);
+			VkMemoryBarrier clearBarrier{};
+			clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				1, &clearBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		// Orders this step after the previous one on the queue, which wrote the particles read
+		// here and read the scratch buffer written here
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
+			&descriptorSets[current], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &push);
+
+		// The living count is only known on the GPU, the passes cover the capacity and the
+		// invocations past the count return right away
+		const uint32_t particleGroups = ComputePipeline::GroupCount(capacity, GROUP_SIZE);
+
+		simulatePipeline->Bind(commandBuffer);
+		vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+
+		compactPipeline->Bind(commandBuffer);
+		vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+
+		// At least one group, the first invocation writes the draw arguments
+		emitPipeline->Bind(commandBuffer);
+		vkCmdDispatch(commandBuffer, std::max(1u, ComputePipeline::GroupCount(emitCount, GROUP_SIZE)), 1, 1);
+
+		current = 1 - current;
+	}
+
+	void ParticleSystem::Simulate(int frameIndex, float deltaTime)
+	{
+		float emitted = emitter.rate * deltaTime + emitRemainder;
+		uint32_t emitCount = static_cast<uint32_t>(std::min(emitted, static_cast<float>(capacity)));
+		emitRemainder = emitted - emitCount;
+
+		VkCommandBuffer commandBuffer = asyncCompute.Begin(frameIndex);
+		RecordStep(commandBuffer, deltaTime, emitCount);
+
+		// The buffer written here was drawn two frames ago, the previous frame only reads the
+		// other one so both queues run at the same time
+		uint64_t submittedFrame = device.GetSubmittedFrame();
+		uint64_t value = asyncCompute.Submit(commandBuffer, submittedFrame > 0 ? submittedFrame - 1 : 0);
+		asyncCompute.WaitInFrame(value, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+	}
+
+	void ParticleSystem::Render(VkCommandBuffer commandBuffer)
+	{
+		renderPipeline->Bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+			&descriptorSets[current], 0, nullptr);
+		vkCmdDrawIndirect(commandBuffer, argsBuffer, current * sizeof(DrawArgs), 1, sizeof(DrawArgs));
+	}
+
+	void ParticleSystem::RunBenchmark(
+		Device& device,
+		AsyncCompute& asyncCompute,
+		DescriptorAllocator& descriptorAllocator,
+		const RenderTargetInfo& target)
+	{
+		std::cout << "Particle simulation, " << (asyncCompute.IsAsync() ? "async compute queue" : "graphics family queue")
+			<< ", " << BENCHMARK_STEPS << " steps" << std::endl;
+
+		for (uint32_t count : { 100'000u, 1'000'000u, 4'000'000u })
+		{
+			ParticleSystem particles{ device, asyncCompute, descriptorAllocator, target, count };
+			// Long lives and a full refill every step, the buffers stay at capacity
+			particles.emitter.minLife = 1000.0f;
+			particles.emitter.maxLife = 1000.0f;
+
+			uint64_t value = 0;
+			auto runSteps = [&](uint32_t steps)
+				{
+					for (uint32_t i = 0; i < steps; i++)
+					{
+						VkCommandBuffer commandBuffer = asyncCompute.Begin(i % SwapChain::MAX_FRAMES_IN_FLIGHT);
+						particles.RecordStep(commandBuffer, BENCHMARK_DELTA_TIME, count);
+						value = asyncCompute.Submit(commandBuffer);
+					}
+					asyncCompute.Wait(value);
+				};
+
+			runSteps(BENCHMARK_WARMUP_STEPS);
+			auto start = std::chrono::high_resolution_clock::now();
+			runSteps(BENCHMARK_STEPS);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			double stepMs = ms / BENCHMARK_STEPS;
+			std::cout << "  " << count << " particles: " << stepMs << " ms per step, "
+				<< static_cast<uint64_t>(count / stepMs) << " particles/ms" << std::endl;
+		}
+	}
+}
@@ -20,7 +20,10 @@ namespace Application
 	{
 		vkDestroyShaderModule(device.GetDevice(), vertShaderModule, nullptr);
 		vkDestroyShaderModule(device.GetDevice(), fragShaderModule, nullptr);
-		vkDestroyPipeline(device.GetDevice(), graphicsPipeline, nullptr);
+		device.DeferDestroy([vkDevice = device.GetDevice(), pipeline = graphicsPipeline]()
+			{
+				vkDestroyPipeline(vkDevice, pipeline, nullptr);
+			});
 	}
 
 	void Pipeline::CreatePipeline(
@@ -30,8 +33,9 @@ namespace Application
 	{
 		assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
 			"Cannot create pipeline! no pipeline layout found in configInfo");
-		assert(configInfo.renderPass != VK_NULL_HANDLE &&
-			"Cannot create pipeline! no render pass found in configInfo");
+		assert((configInfo.renderPass != VK_NULL_HANDLE || !configInfo.colorAttachmentFormats.empty() ||
+			configInfo.depthAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+			"Cannot create pipeline! no render pass or attachment formats found in configInfo");
 
 		auto vertCode = ReadFile(vertFilepath);
 		auto fragCode = ReadFile(fragFilepath);
@@ -59,8 +63,8 @@ namespace Application
 		shaderStages[1].pSpecializationInfo = nullptr;
 
 
-		auto bindingDesc = Model::Vertex::GetBindingDescriptions();
-		auto attributeDesc = Model::Vertex::GetAttributeDescriptions();
+		const auto& bindingDesc = configInfo.bindingDescriptions;
+		const auto& attributeDesc = configInfo.attributeDescriptions;
 
 		// Setting binding / attributes infos
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
@@ -87,6 +91,18 @@ namespace Application
 		pipelineInfo.renderPass = configInfo.renderPass;
 		pipelineInfo.subpass = configInfo.subpass;
 
+		VkPipelineRenderingCreateInfoKHR renderingInfo{};
+		if (configInfo.renderPass == VK_NULL_HANDLE)
+		{
+			renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+			renderingInfo.colorAttachmentCount = static_cast<uint32_t>(configInfo.colorAttachmentFormats.size());
+			renderingInfo.pColorAttachmentFormats = configInfo.colorAttachmentFormats.data();
+			renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+			renderingInfo.stencilAttachmentFormat = HasStencil(configInfo.depthAttachmentFormat) ?
+				configInfo.depthAttachmentFormat : VK_FORMAT_UNDEFINED;
+			pipelineInfo.pNext = &renderingInfo;
+		}
+
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
@@ -112,6 +128,20 @@ namespace Application
 		}
 	}
 
+	void Pipeline::SetRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& target)
+	{
+		configInfo.renderPass = target.renderPass;
+		configInfo.subpass = 0;
+		configInfo.colorAttachmentFormats = target.colorFormats;
+		configInfo.depthAttachmentFormat = target.depthFormat;
+	}
+
+	bool Pipeline::HasStencil(VkFormat format)
+	{
+		return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+			format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+	}
+
 	void Pipeline::DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
 	{
 		configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -181,6 +211,9 @@ namespace Application
 		configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
 		configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 		configInfo.dynamicStateInfo.flags = 0;
+
+		configInfo.bindingDescriptions = Model::VertexLayout::Full().GetBindingDescriptions();
+		configInfo.attributeDescriptions = Model::VertexLayout::Full().GetAttributeDescriptions();
 	}
 
 	void Pipeline::Bind(VkCommandBuffer commandBuffer)
@@ -216,4 +249,58 @@ namespace Application
 		return buffer;
 	}
 
+
+	ComputePipeline::ComputePipeline(
+		Device& device,
+		const std::string& compFilepath,
+		VkPipelineLayout pipelineLayout,
+		const VkSpecializationInfo* specializationInfo) : device{device}
+	{
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline! no pipeline layout");
+
+		auto compCode = Pipeline::ReadFile(compFilepath);
+
+		VkShaderModuleCreateInfo moduleInfo{};
+		moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		moduleInfo.codeSize = compCode.size();
+		moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+
+		VkShaderModule compShaderModule;
+		if (vkCreateShaderModule(device.GetDevice(), &moduleInfo, nullptr, &compShaderModule) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create shader module");
+		}
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = compShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.stage.pSpecializationInfo = specializationInfo;
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		VkResult result = vkCreateComputePipelines(device.GetDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline);
+		// The module is only needed while creating the pipeline
+		vkDestroyShaderModule(device.GetDevice(), compShaderModule, nullptr);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create compute pipeline");
+		}
+	}
+
+	ComputePipeline::~ComputePipeline()
+	{
+		device.DeferDestroy([vkDevice = device.GetDevice(), pipeline = computePipeline]()
+			{
+				vkDestroyPipeline(vkDevice, pipeline, nullptr);
+			});
+	}
+
+	void ComputePipeline::Bind(VkCommandBuffer commandBuffer)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
 }
@@ -0,0 +1,1084 @@
+#include "../Public/RenderGraph.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr VkAccessFlags WRITE_ACCESS =
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_SHADER_WRITE_BIT |
+			VK_ACCESS_TRANSFER_WRITE_BIT |
+			VK_ACCESS_HOST_WRITE_BIT |
+			VK_ACCESS_MEMORY_WRITE_BIT;
+
+		constexpr VkImageUsageFlags ATTACHMENT_USAGE =
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+			VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+		constexpr VkPipelineStageFlags DEPTH_STAGES =
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+		VkAttachmentLoadOp ToVkLoadOp(RenderGraph::LoadOp loadOp)
+		{
+			switch (loadOp)
+			{
+			case RenderGraph::LoadOp::Load: return VK_ATTACHMENT_LOAD_OP_LOAD;
+			case RenderGraph::LoadOp::Clear: return VK_ATTACHMENT_LOAD_OP_CLEAR;
+			default: return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			}
+		}
+
+		double ToMegabytes(VkDeviceSize bytes)
+		{
+			return bytes / (1024.0 * 1024.0);
+		}
+	}
+
+	// ---- PassBuilder ----
+
+	void RenderGraph::PassBuilder::Use(
+		Resource resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout, bool read, bool write)
+	{
+		assert(resource < graph.resources.size() && "Unknown render graph resource");
+		graph.passes[passIndex].uses.push_back({ resource, stages, access, layout, read, write });
+	}
+
+	void RenderGraph::PassBuilder::WriteColor(Resource image, LoadOp loadOp, VkClearColorValue clearValue)
+	{
+		Attachment attachment{ image, loadOp };
+		attachment.clearValue.color = clearValue;
+		graph.passes[passIndex].colorAttachments.push_back(attachment);
+		graph.resources[image].usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+		const bool load = loadOp == LoadOp::Load;
+		Use(image,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (load ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0),
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			load,
+			true);
+	}
+
+	void RenderGraph::PassBuilder::WriteDepth(Resource image, LoadOp loadOp, VkClearDepthStencilValue clearValue)
+	{
+		assert(graph.passes[passIndex].depthAttachment.resource == INVALID_RESOURCE && "A pass has a single depth attachment");
+		Attachment attachment{ image, loadOp };
+		attachment.clearValue.depthStencil = clearValue;
+		graph.passes[passIndex].depthAttachment = attachment;
+		graph.resources[image].usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+		Use(image,
+			DEPTH_STAGES,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			loadOp == LoadOp::Load,
+			true);
+	}
+
+	void RenderGraph::PassBuilder::ReadTexture(Resource image, VkPipelineStageFlags stages)
+	{
+		graph.resources[image].usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+		Use(image, stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true, false);
+	}
+
+	void RenderGraph::PassBuilder::ReadStorageImage(Resource image, VkPipelineStageFlags stages)
+	{
+		graph.resources[image].usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		Use(image, stages, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false);
+	}
+
+	void RenderGraph::PassBuilder::WriteStorageImage(Resource image, VkPipelineStageFlags stages)
+	{
+		graph.resources[image].usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+		Use(image, stages, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, false, true);
+	}
+
+	void RenderGraph::PassBuilder::ReadBuffer(Resource buffer, VkPipelineStageFlags stages, VkAccessFlags access)
+	{
+		Use(buffer, stages, access, VK_IMAGE_LAYOUT_UNDEFINED, true, false);
+	}
+
+	void RenderGraph::PassBuilder::WriteBuffer(Resource buffer, VkPipelineStageFlags stages, VkAccessFlags access)
+	{
+		Use(buffer, stages, access, VK_IMAGE_LAYOUT_UNDEFINED, (access & ~WRITE_ACCESS) != 0, true);
+	}
+
+	void RenderGraph::PassBuilder::SetSideEffect()
+	{
+		graph.passes[passIndex].sideEffect = true;
+	}
+
+	// ---- RenderGraph ----
+
+	bool RenderGraph::TransientKey::operator==(const TransientKey& other) const
+	{
+		return format == other.format && extent.width == other.extent.width && extent.height == other.extent.height &&
+			usage == other.usage && firstUse == other.firstUse && lastUse == other.lastUse;
+	}
+
+	RenderGraph::RenderGraph(Device& device) : device{device}
+	{
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		DestroyTransients();
+		for (auto& [key, cached] : framebuffers)
+		{
+			device.DeferDestroy([vkDevice = device.GetDevice(), framebuffer = cached.framebuffer]()
+				{
+					vkDestroyFramebuffer(vkDevice, framebuffer, nullptr);
+				});
+		}
+		for (auto& [key, renderPass] : renderPasses)
+		{
+			device.DeferDestroy([vkDevice = device.GetDevice(), renderPass = renderPass]()
+				{
+					vkDestroyRenderPass(vkDevice, renderPass, nullptr);
+				});
+		}
+	}
+
+	RenderGraph::Resource RenderGraph::CreateImage(const std::string& name, const ImageDesc& desc)
+	{
+		ResourceEntry entry{};
+		entry.name = name;
+		entry.desc = desc;
+		entry.aspect = GetAspect(desc.format);
+		entry.usage = desc.extraUsage;
+		resources.push_back(entry);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	RenderGraph::Resource RenderGraph::ImportImage(
+		const std::string& name,
+		VkImage image,
+		VkImageView view,
+		VkFormat format,
+		VkExtent2D extent,
+		VkImageLayout initialLayout,
+		VkImageLayout finalLayout,
+		VkPipelineStageFlags initialStages)
+	{
+		ResourceEntry entry{};
+		entry.name = name;
+		entry.imported = true;
+		entry.desc = { format, extent };
+		entry.aspect = GetAspect(format);
+		entry.image = image;
+		entry.view = view;
+		entry.initialLayout = initialLayout;
+		entry.finalLayout = finalLayout;
+		entry.initialStages = initialStages;
+		resources.push_back(entry);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	RenderGraph::Resource RenderGraph::ImportBuffer(
+		const std::string& name, VkBuffer buffer, VkPipelineStageFlags initialStages, VkAccessFlags initialAccess)
+	{
+		ResourceEntry entry{};
+		entry.name = name;
+		entry.isImage = false;
+		entry.imported = true;
+		entry.buffer = buffer;
+		entry.initialStages = initialStages;
+		entry.initialAccess = initialAccess;
+		resources.push_back(entry);
+		return static_cast<Resource>(resources.size() - 1);
+	}
+
+	void RenderGraph::MarkOutput(Resource resource)
+	{
+		resources[resource].output = true;
+	}
+
+	void RenderGraph::AddPass(const std::string& name, const SetupCallback& setup, ExecuteCallback&& execute)
+	{
+		assert(!compiled && "Passes can't be added to a compiled graph, Reset it first");
+		Pass pass{};
+		pass.name = name;
+		pass.execute = std::move(execute);
+		passes.push_back(std::move(pass));
+
+		PassBuilder builder{ *this, static_cast<uint32_t>(passes.size() - 1) };
+		setup(builder);
+	}
+
+	void RenderGraph::Compile()
+	{
+		CullPasses();
+		OrderPasses();
+		ComputeLifetimes();
+		AllocateTransients();
+		BuildBarriers();
+		compiled = true;
+	}
+
+	void RenderGraph::Reset()
+	{
+		passes.clear();
+		resources.clear();
+		order.clear();
+		finalBarriers.clear();
+		finalSrcStages = 0;
+		compiled = false;
+	}
+
+	void RenderGraph::CullPasses()
+	{
+		// Walk back from the passes that must run to the last writer of everything they read
+		std::vector<uint32_t> stack;
+		for (uint32_t i = 0; i < passes.size(); i++)
+		{
+			Pass& pass = passes[i];
+			pass.culled = !pass.sideEffect && std::none_of(pass.uses.begin(), pass.uses.end(),
+				[&](const ResourceUse& use) { return use.write && resources[use.resource].output; });
+			if (!pass.culled)
+			{
+				stack.push_back(i);
+			}
+		}
+
+		while (!stack.empty())
+		{
+			uint32_t passIndex = stack.back();
+			stack.pop_back();
+			for (const ResourceUse& use : passes[passIndex].uses)
+			{
+				if (!use.read)
+				{
+					continue;
+				}
+				for (uint32_t i = passIndex; i-- > 0;)
+				{
+					auto& uses = passes[i].uses;
+					bool writes = std::any_of(uses.begin(), uses.end(),
+						[&](const ResourceUse& other) { return other.write && other.resource == use.resource; });
+					if (writes)
+					{
+						if (passes[i].culled)
+						{
+							passes[i].culled = false;
+							stack.push_back(i);
+						}
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	void RenderGraph::OrderPasses()
+	{
+		// Dependencies between the passes touching the same resource, in declaration order
+		std::vector<std::vector<uint32_t>> successors(passes.size());
+		std::vector<uint32_t> dependencyCount(passes.size(), 0);
+		auto addEdge = [&](uint32_t from, uint32_t to)
+			{
+				if (from != to && std::find(successors[from].begin(), successors[from].end(), to) == successors[from].end())
+				{
+					successors[from].push_back(to);
+					dependencyCount[to]++;
+				}
+			};
+
+		std::vector<uint32_t> lastWriter(resources.size(), ~0u);
+		std::vector<std::vector<uint32_t>> readers(resources.size());
+		uint32_t lastSideEffect = ~0u;
+		for (uint32_t i = 0; i < passes.size(); i++)
+		{
+			if (passes[i].culled)
+			{
+				continue;
+			}
+			// Effects the graph can't see keep their relative order
+			if (passes[i].sideEffect)
+			{
+				if (lastSideEffect != ~0u)
+				{
+					addEdge(lastSideEffect, i);
+				}
+				lastSideEffect = i;
+			}
+
+			for (const ResourceUse& use : passes[i].uses)
+			{
+				if (lastWriter[use.resource] != ~0u)
+				{
+					addEdge(lastWriter[use.resource], i);
+				}
+				if (use.write)
+				{
+					for (uint32_t reader : readers[use.resource])
+					{
+						addEdge(reader, i);
+					}
+					readers[use.resource].clear();
+					lastWriter[use.resource] = i;
+				}
+				else
+				{
+					readers[use.resource].push_back(i);
+				}
+			}
+		}
+
+		// Among the passes ready to run, pick the one whose inputs were produced the earliest: the
+		// more work between a producer and its consumer, the less the barrier between them stalls
+		std::vector<uint32_t> readySince(passes.size(), 0);
+		std::vector<uint32_t> ready;
+		for (uint32_t i = 0; i < passes.size(); i++)
+		{
+			if (!passes[i].culled && dependencyCount[i] == 0)
+			{
+				ready.push_back(i);
+			}
+		}
+
+		order.clear();
+		while (!ready.empty())
+		{
+			auto next = std::min_element(ready.begin(), ready.end(), [&](uint32_t a, uint32_t b)
+				{
+					return readySince[a] != readySince[b] ? readySince[a] < readySince[b] : a < b;
+				});
+			uint32_t passIndex = *next;
+			ready.erase(next);
+
+			order.push_back(passIndex);
+			for (uint32_t successor : successors[passIndex])
+			{
+				readySince[successor] = std::max(readySince[successor], static_cast<uint32_t>(order.size()));
+				if (--dependencyCount[successor] == 0)
+				{
+					ready.push_back(successor);
+				}
+			}
+		}
+	}
+
+	void RenderGraph::ComputeLifetimes()
+	{
+		for (uint32_t position = 0; position < order.size(); position++)
+		{
+			for (const ResourceUse& use : passes[order[position]].uses)
+			{
+				ResourceEntry& resource = resources[use.resource];
+				resource.firstUse = std::min(resource.firstUse, position);
+				resource.lastUse = std::max(resource.lastUse, position);
+				resource.usedStages |= use.stages;
+				if (use.write)
+				{
+					resource.writeAccess |= use.access & WRITE_ACCESS;
+				}
+			}
+		}
+	}
+
+	void RenderGraph::AllocateTransients()
+	{
+		std::vector<uint32_t> transients;
+		std::vector<TransientKey> keys;
+		for (uint32_t i = 0; i < resources.size(); i++)
+		{
+			const ResourceEntry& resource = resources[i];
+			if (resource.isImage && !resource.imported && resource.firstUse != ~0u)
+			{
+				// An attachment that lives in a single pass is never stored, tile memory can back it
+				VkImageUsageFlags usage = resource.usage;
+				if (resource.firstUse == resource.lastUse && !(usage & ~ATTACHMENT_USAGE))
+				{
+					usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+				}
+				transients.push_back(i);
+				keys.push_back({ resource.desc.format, resource.desc.extent, usage, resource.firstUse, resource.lastUse });
+			}
+		}
+
+		// Same transients as last frame, the images and their placement are still valid
+		if (keys != transientKeys)
+		{
+			DestroyTransients();
+			transientKeys = keys;
+
+			std::vector<VkMemoryRequirements> requirements(transients.size());
+			physicalImages.resize(transients.size());
+			for (size_t i = 0; i < transients.size(); i++)
+			{
+				const ResourceEntry& resource = resources[transients[i]];
+
+				VkImageCreateInfo imageInfo{};
+				imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+				imageInfo.imageType = VK_IMAGE_TYPE_2D;
+				imageInfo.extent = { resource.desc.extent.width, resource.desc.extent.height, 1 };
+				imageInfo.mipLevels = 1;
+				imageInfo.arrayLayers = 1;
+				imageInfo.format = resource.desc.format;
+				imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+				imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				imageInfo.usage = keys[i].usage;
+				imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+				imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+				if (vkCreateImage(device.GetDevice(), &imageInfo, nullptr, &physicalImages[i].image) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to create render graph image");
+				}
+				vkGetImageMemoryRequirements(device.GetDevice(), physicalImages[i].image, &requirements[i]);
+				physicalImages[i].size = requirements[i].size;
+			}
+
+			// Largest first, each image goes in the first block whose occupants are all dead by the
+			// time it is first used, or alive only after its last use
+			std::vector<size_t> bySize(transients.size());
+			for (size_t i = 0; i < bySize.size(); i++)
+			{
+				bySize[i] = i;
+			}
+			std::sort(bySize.begin(), bySize.end(), [&](size_t a, size_t b) { return requirements[a].size > requirements[b].size; });
+
+			struct Block
+			{
+				VkDeviceSize size;
+				VkDeviceSize alignment;
+				uint32_t memoryTypeBits;
+				bool lazy;
+				std::vector<size_t> occupants;
+			};
+			std::vector<Block> blocks;
+			for (size_t i : bySize)
+			{
+				const TransientKey& key = keys[i];
+				auto fits = [&](const Block& block)
+					{
+						if (!(block.memoryTypeBits & requirements[i].memoryTypeBits))
+						{
+							return false;
+						}
+						return std::none_of(block.occupants.begin(), block.occupants.end(), [&](size_t other)
+							{
+								return !(keys[other].lastUse < key.firstUse || key.lastUse < keys[other].firstUse);
+							});
+					};
+
+				auto block = std::find_if(blocks.begin(), blocks.end(), fits);
+				if (block == blocks.end())
+				{
+					blocks.push_back({ 0, 1, ~0u, true, {} });
+					block = blocks.end() - 1;
+				}
+				block->size = std::max(block->size, requirements[i].size);
+				block->alignment = std::max(block->alignment, requirements[i].alignment);
+				block->memoryTypeBits &= requirements[i].memoryTypeBits;
+				block->lazy = block->lazy && (key.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+				block->occupants.push_back(i);
+				physicalImages[i].block = static_cast<uint32_t>(block - blocks.begin());
+				physicalImages[i].offset = 0;
+			}
+
+			aliasedBytes = 0;
+			unaliasedBytes = 0;
+			memoryBlocks.resize(blocks.size());
+			for (size_t b = 0; b < blocks.size(); b++)
+			{
+				VkMemoryAllocateInfo allocInfo{};
+				allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				allocInfo.allocationSize = blocks[b].size;
+				VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+				if (blocks[b].lazy && device.HasMemoryType(blocks[b].memoryTypeBits, properties | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+				{
+					properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+				}
+				allocInfo.memoryTypeIndex = device.FindMemoryType(blocks[b].memoryTypeBits, properties);
+				if (vkAllocateMemory(device.GetDevice(), &allocInfo, nullptr, &memoryBlocks[b]) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to allocate render graph memory");
+				}
+				aliasedBytes += blocks[b].size;
+
+				// Whoever used the memory before is the one the first use has to wait for, the
+				// first occupant follows the last one of the previous frame
+				auto& occupants = blocks[b].occupants;
+				std::sort(occupants.begin(), occupants.end(), [&](size_t x, size_t y) { return keys[x].firstUse < keys[y].firstUse; });
+				for (size_t o = 0; o < occupants.size(); o++)
+				{
+					size_t predecessor = occupants[o == 0 ? occupants.size() - 1 : o - 1];
+					physicalImages[occupants[o]].aliasPredecessor = static_cast<uint32_t>(predecessor);
+				}
+			}
+
+			for (size_t i = 0; i < transients.size(); i++)
+			{
+				PhysicalImage& physical = physicalImages[i];
+				unaliasedBytes += physical.size;
+				vkBindImageMemory(device.GetDevice(), physical.image, memoryBlocks[physical.block], physical.offset);
+
+				const ResourceEntry& resource = resources[transients[i]];
+				VkImageViewCreateInfo viewInfo{};
+				viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+				viewInfo.image = physical.image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.desc.format;
+				viewInfo.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+				if (vkCreateImageView(device.GetDevice(), &viewInfo, nullptr, &physical.view) != VK_SUCCESS)
+				{
+					throw std::runtime_error("Failed to create render graph image view");
+				}
+			}
+		}
+
+		for (size_t i = 0; i < transients.size(); i++)
+		{
+			ResourceEntry& resource = resources[transients[i]];
+			resource.physicalIndex = static_cast<uint32_t>(i);
+			resource.image = physicalImages[i].image;
+			resource.view = physicalImages[i].view;
+		}
+	}
+
+	void RenderGraph::DestroyTransients()
+	{
+		std::vector<VkImageView> views;
+		for (const PhysicalImage& physical : physicalImages)
+		{
+			views.push_back(physical.view);
+		}
+		ReleaseImageViews(views);
+
+		// Frames still in flight may be using them
+		device.DeferDestroy([vkDevice = device.GetDevice(), images = physicalImages, blocks = memoryBlocks]()
+			{
+				for (const PhysicalImage& physical : images)
+				{
+					vkDestroyImageView(vkDevice, physical.view, nullptr);
+					vkDestroyImage(vkDevice, physical.image, nullptr);
+				}
+				for (VkDeviceMemory memory : blocks)
+				{
+					vkFreeMemory(vkDevice, memory, nullptr);
+				}
+			});
+		physicalImages.clear();
+		memoryBlocks.clear();
+		transientKeys.clear();
+		aliasedBytes = 0;
+		unaliasedBytes = 0;
+	}
+
+	void RenderGraph::BuildBarriers()
+	{
+		struct State
+		{
+			VkImageLayout layout;
+			VkPipelineStageFlags writeStages;
+			VkAccessFlags writeAccess;
+			VkPipelineStageFlags readStages;
+			// Stages and accesses that already see the last write
+			VkPipelineStageFlags visibleStages;
+			VkAccessFlags visibleAccess;
+		};
+
+		std::vector<uint32_t> physicalToResource(physicalImages.size());
+		for (uint32_t i = 0; i < resources.size(); i++)
+		{
+			if (resources[i].physicalIndex != ~0u)
+			{
+				physicalToResource[resources[i].physicalIndex] = i;
+			}
+		}
+
+		std::vector<State> states(resources.size());
+		for (uint32_t i = 0; i < resources.size(); i++)
+		{
+			const ResourceEntry& resource = resources[i];
+			State& state = states[i];
+			if (resource.physicalIndex != ~0u)
+			{
+				// The memory still holds whatever the previous occupant wrote
+				const ResourceEntry& predecessor =
+					resources[physicalToResource[physicalImages[resource.physicalIndex].aliasPredecessor]];
+				state = { VK_IMAGE_LAYOUT_UNDEFINED, predecessor.usedStages, predecessor.writeAccess, 0, 0, 0 };
+			}
+			else
+			{
+				bool hasWrite = resource.initialAccess != 0;
+				state = { resource.initialLayout, resource.initialStages, resource.initialAccess, 0,
+					hasWrite ? 0 : ~0u, hasWrite ? 0 : ~0u };
+			}
+		}
+
+		for (uint32_t passIndex : order)
+		{
+			Pass& pass = passes[passIndex];
+			pass.srcStages = 0;
+			pass.dstStages = 0;
+			pass.imageBarriers.clear();
+			pass.bufferBarriers.clear();
+
+			for (const ResourceUse& use : pass.uses)
+			{
+				const ResourceEntry& resource = resources[use.resource];
+				State& state = states[use.resource];
+				const bool layoutChange = resource.isImage && state.layout != use.layout;
+
+				VkPipelineStageFlags srcStages = 0;
+				VkAccessFlags srcAccess = 0;
+				bool needBarrier = false;
+				if (layoutChange || use.write)
+				{
+					// Transition, write after write or write after read
+					srcStages = state.writeStages | state.readStages;
+					srcAccess = state.writeAccess;
+					needBarrier = layoutChange || (srcStages & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) != 0;
+
+					state.writeStages = use.stages;
+					state.writeAccess = use.write ? use.access & WRITE_ACCESS : 0;
+					state.readStages = use.write ? 0 : use.stages;
+					state.visibleStages = use.stages;
+					state.visibleAccess = use.access;
+				}
+				else
+				{
+					// Read after write, only once per stage and access that doesn't see it yet
+					needBarrier = (state.writeStages & ~VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) != 0 &&
+						((use.stages & ~state.visibleStages) || (use.access & ~state.visibleAccess));
+					srcStages = state.writeStages;
+					srcAccess = state.writeAccess;
+					if (needBarrier)
+					{
+						state.visibleStages |= use.stages;
+						state.visibleAccess |= use.access;
+					}
+					state.readStages |= use.stages;
+				}
+
+				if (!needBarrier)
+				{
+					continue;
+				}
+
+				pass.srcStages |= srcStages;
+				pass.dstStages |= use.stages;
+				if (resource.isImage)
+				{
+					VkImageMemoryBarrier barrier{};
+					barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					barrier.srcAccessMask = srcAccess;
+					barrier.dstAccessMask = use.access;
+					// Cleared attachments don't keep the old content, a transition from undefined lets the driver drop it
+					const bool discard = !use.read &&
+						(use.access & (VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT));
+					barrier.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+					barrier.newLayout = use.layout;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.image = resource.image;
+					barrier.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+					pass.imageBarriers.push_back(barrier);
+					state.layout = use.layout;
+				}
+				else
+				{
+					VkBufferMemoryBarrier barrier{};
+					barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+					barrier.srcAccessMask = srcAccess;
+					barrier.dstAccessMask = use.access;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.buffer = resource.buffer;
+					barrier.offset = 0;
+					barrier.size = VK_WHOLE_SIZE;
+					pass.bufferBarriers.push_back(barrier);
+				}
+			}
+		}
+
+		// Imported images are handed back in the layout their owner expects
+		finalSrcStages = 0;
+		finalBarriers.clear();
+		for (uint32_t i = 0; i < resources.size(); i++)
+		{
+			const ResourceEntry& resource = resources[i];
+			const State& state = states[i];
+			if (!resource.isImage || !resource.imported || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+				resource.finalLayout == state.layout)
+			{
+				continue;
+			}
+
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcAccessMask = state.writeAccess;
+			barrier.dstAccessMask = 0;
+			barrier.oldLayout = state.layout;
+			barrier.newLayout = resource.finalLayout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = resource.image;
+			barrier.subresourceRange = { resource.aspect, 0, 1, 0, 1 };
+			finalBarriers.push_back(barrier);
+			finalSrcStages |= state.writeStages | state.readStages;
+		}
+	}
+
+	void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+	{
+		assert(compiled && "Compile the render graph before executing it");
+
+		for (uint32_t position = 0; position < order.size(); position++)
+		{
+			const Pass& pass = passes[order[position]];
+			if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty())
+			{
+				vkCmdPipelineBarrier(
+					commandBuffer,
+					pass.srcStages ? pass.srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+					pass.dstStages,
+					0,
+					0, nullptr,
+					static_cast<uint32_t>(pass.bufferBarriers.size()), pass.bufferBarriers.data(),
+					static_cast<uint32_t>(pass.imageBarriers.size()), pass.imageBarriers.data());
+			}
+
+			const bool raster = !pass.colorAttachments.empty() || pass.depthAttachment.resource != INVALID_RESOURCE;
+			const bool dynamicRendering = raster && device.SupportsDynamicRendering();
+			if (dynamicRendering)
+			{
+				BeginRendering(commandBuffer, pass, position);
+			}
+			else if (raster)
+			{
+				BeginRenderPass(commandBuffer, pass, position);
+			}
+			if (pass.execute)
+			{
+				pass.execute(commandBuffer);
+			}
+			if (dynamicRendering)
+			{
+				device.CmdEndRendering(commandBuffer);
+			}
+			else if (raster)
+			{
+				vkCmdEndRenderPass(commandBuffer);
+			}
+		}
+
+		if (!finalBarriers.empty())
+		{
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				finalSrcStages ? finalSrcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				0, nullptr,
+				static_cast<uint32_t>(finalBarriers.size()), finalBarriers.data());
+		}
+	}
+
+	VkExtent2D RenderGraph::GetRenderArea(const Pass& pass) const
+	{
+		// What every attachment covers
+		Resource first = pass.colorAttachments.empty() ? pass.depthAttachment.resource : pass.colorAttachments[0].resource;
+		VkExtent2D extent = resources[first].desc.extent;
+		for (const Attachment& attachment : pass.colorAttachments)
+		{
+			extent.width = std::min(extent.width, resources[attachment.resource].desc.extent.width);
+			extent.height = std::min(extent.height, resources[attachment.resource].desc.extent.height);
+		}
+		return extent;
+	}
+
+	VkAttachmentStoreOp RenderGraph::GetStoreOp(Resource resource, uint32_t position) const
+	{
+		// Only stored when a later pass or the owner of an imported image needs it
+		const ResourceEntry& entry = resources[resource];
+		const bool ownerReads = entry.imported && entry.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+		return (ownerReads || entry.lastUse > position) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+
+	void RenderGraph::BeginRendering(VkCommandBuffer commandBuffer, const Pass& pass, uint32_t position)
+	{
+		// No render pass or framebuffer objects, the attachments are the views themselves
+		std::vector<VkRenderingAttachmentInfoKHR> colorAttachments;
+		for (const Attachment& attachment : pass.colorAttachments)
+		{
+			VkRenderingAttachmentInfoKHR info{};
+			info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			info.imageView = resources[attachment.resource].view;
+			info.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			info.loadOp = ToVkLoadOp(attachment.loadOp);
+			info.storeOp = GetStoreOp(attachment.resource, position);
+			info.clearValue = attachment.clearValue;
+			colorAttachments.push_back(info);
+		}
+
+		VkRenderingAttachmentInfoKHR depthAttachment{};
+		const bool hasDepth = pass.depthAttachment.resource != INVALID_RESOURCE;
+		const bool hasStencil = hasDepth && (resources[pass.depthAttachment.resource].aspect & VK_IMAGE_ASPECT_STENCIL_BIT);
+		if (hasDepth)
+		{
+			depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+			depthAttachment.imageView = resources[pass.depthAttachment.resource].view;
+			depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			depthAttachment.loadOp = ToVkLoadOp(pass.depthAttachment.loadOp);
+			depthAttachment.storeOp = GetStoreOp(pass.depthAttachment.resource, position);
+			depthAttachment.clearValue = pass.depthAttachment.clearValue;
+		}
+
+		VkExtent2D extent = GetRenderArea(pass);
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.renderArea = { { 0, 0 }, extent };
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+		renderingInfo.pColorAttachments = colorAttachments.data();
+		renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+		renderingInfo.pStencilAttachment = hasStencil ? &depthAttachment : nullptr;
+		device.CmdBeginRendering(commandBuffer, renderingInfo);
+
+		VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+		VkRect2D scissor{ { 0, 0 }, extent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	void RenderGraph::BeginRenderPass(VkCommandBuffer commandBuffer, const Pass& pass, uint32_t position)
+	{
+		std::vector<VkImageView> views;
+		std::vector<VkClearValue> clearValues;
+		for (const Attachment& attachment : pass.colorAttachments)
+		{
+			views.push_back(resources[attachment.resource].view);
+			clearValues.push_back(attachment.clearValue);
+		}
+		if (pass.depthAttachment.resource != INVALID_RESOURCE)
+		{
+			views.push_back(resources[pass.depthAttachment.resource].view);
+			clearValues.push_back(pass.depthAttachment.clearValue);
+		}
+
+		VkExtent2D extent = GetRenderArea(pass);
+		VkRenderPass renderPass = GetRenderPass(pass, position);
+		VkFramebuffer framebuffer = GetFramebuffer(renderPass, views, extent);
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = framebuffer;
+		renderPassInfo.renderArea = { { 0, 0 }, extent };
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassInfo.pClearValues = clearValues.data();
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+		VkRect2D scissor{ { 0, 0 }, extent };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	VkFramebuffer RenderGraph::GetFramebuffer(VkRenderPass renderPass, const std::vector<VkImageView>& views, VkExtent2D extent)
+	{
+		// The swap chain image cycles through a few views, one framebuffer per combination is kept
+		std::vector<uint64_t> key;
+		key.push_back(reinterpret_cast<uint64_t>(renderPass));
+		for (VkImageView view : views)
+		{
+			key.push_back(reinterpret_cast<uint64_t>(view));
+		}
+		key.push_back(static_cast<uint64_t>(extent.width) << 32 | extent.height);
+
+		auto it = framebuffers.find(key);
+		if (it != framebuffers.end())
+		{
+			return it->second.framebuffer;
+		}
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferInfo.pAttachments = views.data();
+		framebufferInfo.width = extent.width;
+		framebufferInfo.height = extent.height;
+		framebufferInfo.layers = 1;
+
+		VkFramebuffer framebuffer;
+		if (vkCreateFramebuffer(device.GetDevice(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph framebuffer");
+		}
+		framebuffers.emplace(std::move(key), CachedFramebuffer{ framebuffer, views });
+		return framebuffer;
+	}
+
+	void RenderGraph::ReleaseImageViews(const std::vector<VkImageView>& views)
+	{
+		for (auto it = framebuffers.begin(); it != framebuffers.end();)
+		{
+			const std::vector<VkImageView>& attachments = it->second.views;
+			bool stale = std::any_of(attachments.begin(), attachments.end(), [&](VkImageView view)
+				{
+					return std::find(views.begin(), views.end(), view) != views.end();
+				});
+			if (!stale)
+			{
+				++it;
+				continue;
+			}
+			device.DeferDestroy([vkDevice = device.GetDevice(), framebuffer = it->second.framebuffer]()
+				{
+					vkDestroyFramebuffer(vkDevice, framebuffer, nullptr);
+				});
+			it = framebuffers.erase(it);
+		}
+	}
+
+	VkRenderPass RenderGraph::GetRenderPass(const Pass& pass, uint32_t position)
+	{
+		std::vector<VkAttachmentDescription> attachments;
+		for (const Attachment& attachment : pass.colorAttachments)
+		{
+			VkAttachmentDescription description{};
+			description.format = resources[attachment.resource].desc.format;
+			description.samples = VK_SAMPLE_COUNT_1_BIT;
+			description.loadOp = ToVkLoadOp(attachment.loadOp);
+			description.storeOp = GetStoreOp(attachment.resource, position);
+			description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			description.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			attachments.push_back(description);
+		}
+		if (pass.depthAttachment.resource != INVALID_RESOURCE)
+		{
+			VkAttachmentDescription description{};
+			description.format = resources[pass.depthAttachment.resource].desc.format;
+			description.samples = VK_SAMPLE_COUNT_1_BIT;
+			description.loadOp = ToVkLoadOp(pass.depthAttachment.loadOp);
+			description.storeOp = GetStoreOp(pass.depthAttachment.resource, position);
+			description.stencilLoadOp = description.loadOp;
+			description.stencilStoreOp = description.storeOp;
+			description.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			description.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			attachments.push_back(description);
+		}
+
+		std::vector<uint64_t> key;
+		for (const auto& description : attachments)
+		{
+			key.push_back(static_cast<uint64_t>(description.format) << 16 |
+				static_cast<uint64_t>(description.loadOp) << 8 | static_cast<uint64_t>(description.storeOp));
+		}
+		key.push_back(pass.depthAttachment.resource != INVALID_RESOURCE);
+
+		auto it = renderPasses.find(key);
+		if (it != renderPasses.end())
+		{
+			return it->second;
+		}
+
+		std::vector<VkAttachmentReference> colorReferences;
+		for (uint32_t i = 0; i < pass.colorAttachments.size(); i++)
+		{
+			colorReferences.push_back({ i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		}
+		VkAttachmentReference depthReference{
+			static_cast<uint32_t>(pass.colorAttachments.size()), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.pDepthStencilAttachment = pass.depthAttachment.resource != INVALID_RESOURCE ? &depthReference : nullptr;
+
+		// Layouts and dependencies are handled by the graph barriers around the pass
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		VkRenderPass renderPass;
+		if (vkCreateRenderPass(device.GetDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create render graph render pass");
+		}
+		renderPasses.emplace(std::move(key), renderPass);
+		return renderPass;
+	}
+
+	VkImageAspectFlags RenderGraph::GetAspect(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		case VK_FORMAT_S8_UINT:
+			return VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+
+	void RenderGraph::Dump(std::ostream& out) const
+	{
+		size_t culledCount = std::count_if(passes.begin(), passes.end(), [](const Pass& pass) { return pass.culled; });
+		out << "Render graph: " << order.size() << " passes, " << culledCount << " culled, "
+			<< resources.size() << " resources" << std::endl;
+
+		for (uint32_t position = 0; position < order.size(); position++)
+		{
+			const Pass& pass = passes[order[position]];
+			out << "  [" << position << "] " << pass.name << " (" << pass.imageBarriers.size() << " image barriers, "
+				<< pass.bufferBarriers.size() << " buffer barriers)" << std::endl;
+			for (const ResourceUse& use : pass.uses)
+			{
+				out << "      " << (use.write ? (use.read ? "read/write " : "write ") : "read ") << resources[use.resource].name << std::endl;
+			}
+		}
+		for (const Pass& pass : passes)
+		{
+			if (pass.culled)
+			{
+				out << "  culled: " << pass.name << std::endl;
+			}
+		}
+		if (!finalBarriers.empty())
+		{
+			out << "  final transitions: " << finalBarriers.size() << std::endl;
+		}
+
+		for (const ResourceEntry& resource : resources)
+		{
+			if (resource.physicalIndex == ~0u)
+			{
+				continue;
+			}
+			const PhysicalImage& physical = physicalImages[resource.physicalIndex];
+			out << "  transient " << resource.name << " " << resource.desc.extent.width << "x" << resource.desc.extent.height
+				<< " passes [" << resource.firstUse << ", " << resource.lastUse << "] block " << physical.block
+				<< ", " << std::fixed << std::setprecision(2) << ToMegabytes(physical.size) << " MB" << std::endl;
+		}
+		out << "Transient memory: " << std::fixed << std::setprecision(2) << ToMegabytes(aliasedBytes) << " MB in "
+			<< memoryBlocks.size() << " blocks, " << ToMegabytes(unaliasedBytes) << " MB without aliasing, saved "
+			<< ToMegabytes(unaliasedBytes - aliasedBytes) << " MB" << std::endl;
+		out.unsetf(std::ios::fixed);
+	}
+}
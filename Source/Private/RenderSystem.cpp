@@ -7,40 +7,39 @@
 
 #include <stdexcept>
 #include <array>
+#include <cassert>
+#include <algorithm>
 
 namespace Application
 {
-	struct SimplePushConstantData
-	{
-		glm::mat2 transform{ 1.0f };
-		glm::vec2 offset;
-		alignas(16) glm::vec3 color;
-	};
+	// Model vertices come from binding 0, the instance data from this one
+	constexpr uint32_t INSTANCE_BINDING = 1;
 
-	RenderSystem::RenderSystem(Device& device, VkRenderPass renderPass) : device{device}
+	RenderSystem::RenderSystem(Device& device, const RenderTargetInfo& target, BindlessDescriptors* bindless,
+		const Model::VertexLayout& vertexLayout) :
+		device{device}, bindless{bindless}, vertexLayout{vertexLayout}
 	{
 		CreatePipelineLayout();
-		CreatePipeline(renderPass);
+		CreatePipeline(target);
 	}
 
 	RenderSystem::~RenderSystem()
 	{
-		vkDestroyPipelineLayout(device.GetDevice(), pipelineLayout, nullptr);
+		device.DeferDestroy([vkDevice = device.GetDevice(), layout = pipelineLayout]()
+			{
+				vkDestroyPipelineLayout(vkDevice, layout, nullptr);
+			});
 	}
 
 	void RenderSystem::CreatePipelineLayout()
 	{
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(SimplePushConstantData);
-
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 0;
-		pipelineLayoutInfo.pSetLayouts = nullptr;
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		VkDescriptorSetLayout setLayout = bindless ? bindless->GetSetLayout() : VK_NULL_HANDLE;
+		pipelineLayoutInfo.setLayoutCount = bindless ? 1 : 0;
+		pipelineLayoutInfo.pSetLayouts = bindless ? &setLayout : nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
 		if (vkCreatePipelineLayout(device.GetDevice(),
 			&pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
 		{
@@ -48,51 +47,78 @@ namespace Application
 		}
 	}
 
-	void RenderSystem::CreatePipeline(VkRenderPass renderPass)
+	void RenderSystem::CreatePipeline(const RenderTargetInfo& target)
 	{
 		assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
 		PipelineConfigInfo pipelineConfig{};
 		Pipeline::DefaultPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.renderPass = renderPass;
+		Pipeline::SetRenderTarget(pipelineConfig, target);
 		pipelineConfig.pipelineLayout = pipelineLayout;
+		pipelineConfig.bindingDescriptions = vertexLayout.GetBindingDescriptions();
+		pipelineConfig.attributeDescriptions = vertexLayout.GetAttributeDescriptions();
+		// Per-object data follows the model's attributes
+		pipelineConfig.bindingDescriptions.push_back(InstanceBuffer::Instance::GetBindingDescription(INSTANCE_BINDING));
+		auto instanceAttributes = InstanceBuffer::Instance::GetAttributeDescriptions(INSTANCE_BINDING,
+			static_cast<uint32_t>(pipelineConfig.attributeDescriptions.size()));
+		pipelineConfig.attributeDescriptions.insert(pipelineConfig.attributeDescriptions.end(),
+			instanceAttributes.begin(), instanceAttributes.end());
 
 		// Creating pipeline
 		pipeline = std::make_unique<Pipeline>
 			(
 				device,
-				"Resources/Shaders/SimpleShader.vert.spv",
-				"Resources/Shaders/SimpleShader.frag.spv",
+				bindless ? "Resources/Shaders/BindlessShader.vert.spv" : "Resources/Shaders/SimpleShader.vert.spv",
+				bindless ? "Resources/Shaders/BindlessShader.frag.spv" : "Resources/Shaders/SimpleShader.frag.spv",
 				pipelineConfig
 			);
 	}
 
 
-	void RenderSystem::RenderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject>& gameObjects)
+	void RenderSystem::RenderGameObjects(VkCommandBuffer commandBuffer, const GameObjectPool& gameObjects,
+		const ModelPool& models, const InstanceBuffer& instances, const SpatialIndex* cullIndex)
 	{
-		pipeline->Bind(commandBuffer);
-
-		for (auto& obj : gameObjects)
+		if (cullIndex)
 		{
-			obj.transform2d.rotation = glm::mod(obj.transform2d.rotation + 0.01f, glm::two_pi<float>());
-
-			SimplePushConstantData push{};
-			push.offset = obj.transform2d.translation;
-			push.color = obj.color;
-			push.transform = obj.transform2d.mat2();
-
-			vkCmdPushConstants
-			(
-				commandBuffer,
-				pipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(SimplePushConstantData), &push
-			);
+			// The 2D scene is drawn in clip space, the screen is the [-1, 1] square
+			visibleIds.clear();
+			cullIndex->QueryRect({ glm::vec2{ -1.0f }, glm::vec2{ 1.0f } }, visibleIds);
+			std::fill(visible.begin(), visible.end(), 0);
+			for (SpatialIndex::Id id : visibleIds)
+			{
+				if (id >= visible.size())
+				{
+					visible.resize(static_cast<size_t>(id) + 1, 0);
+				}
+				visible[id] = 1;
+			}
+		}
 
-			obj.model->Bind(commandBuffer);
-			obj.model->Draw(commandBuffer);
+		pipeline->Bind(commandBuffer);
+		// Every texture is reachable from this one set, whatever the objects use
+		if (bindless)
+		{
+			bindless->Bind(commandBuffer, pipelineLayout);
 		}
+		instances.Bind(commandBuffer, INSTANCE_BINDING);
+
+		gameObjects.ForEach([&](const GameObject& obj)
+			{
+				// Destroyed models are skipped, their handles are stale
+				const Model* model = models.Get(obj.model);
+				if (!model || !model->IsReady())
+				{
+					return;
+				}
+				assert(model->GetLayout() == vertexLayout && "Model vertices don't match the pipeline's vertex input");
+				if (cullIndex && (obj.GetId() >= visible.size() || !visible[obj.GetId()]))
+				{
+					return;
+				}
+
+				model->Bind(commandBuffer);
+				model->Draw(commandBuffer, obj.GetId());
+			});
 
 	}
 }
\ No newline at end of file
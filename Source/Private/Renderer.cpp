@@ -1,12 +1,18 @@
 #include "../Public/Renderer.h"
+#include "../Public/Uploader.h"
 
 #include <stdexcept>
 #include <array>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
 
 namespace Application
 {
 
-	Renderer::Renderer(Device& device, Window& window) : device{device}, window{window}
+	Renderer::Renderer(Device& device, Window& window, const SwapChainSettings& settings) :
+		device{device}, window{window}, swapChainSettings{settings}
 	{
 		RecreateSwapChain();
 		CreateCommandBuffers();
@@ -15,6 +21,13 @@ namespace Application
 	Renderer::~Renderer()
 	{
 		FreeCommandBuffers();
+
+		ReportFrameStats();
+		if (recreateStats.count > 0)
+		{
+			std::cout << "Swap chain recreated " << recreateStats.count << " times, hitch avg "
+				<< recreateStats.totalMs / recreateStats.count << " ms, max " << recreateStats.maxMs << " ms" << std::endl;
+		}
 	}
 
 	void Renderer::CreateCommandBuffers()
@@ -37,29 +50,49 @@ namespace Application
 	void Renderer::RecreateSwapChain()
 	{
 		auto extend = window.GetExtend();
-		// User minimized the window
-		while (extend.width = +0 || extend.height == 0)
+		// User minimized the window, nothing can be presented until it comes back
+		while (extend.width == 0 || extend.height == 0)
 		{
-			extend = window.GetExtend();
 			glfwWaitEvents();
+			extend = window.GetExtend();
 		}
-		// Waiting for swapchain to not be in use
-		vkDeviceWaitIdle(device.GetDevice());
+
 		// Recreating the swapchain
 		if (swapChain == nullptr)
 		{
-			swapChain = std::make_unique<SwapChain>(device, extend);
+			swapChain = std::make_unique<SwapChain>(device, extend, swapChainSettings);
 		}
 		else
 		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			// No idle wait: the old swap chain is retired through oldSwapchain and handed to the
+			// deletion queue, it is destroyed once the frames still using it have completed
 			std::shared_ptr<SwapChain> oldSwapChain = std::move(swapChain);
-			swapChain = std::make_unique<SwapChain>(device, extend, oldSwapChain);
+			for (size_t i = 0; i < oldSwapChain->GetImageCount(); i++)
+			{
+				retiredImageViews.push_back(oldSwapChain->GetImageView(static_cast<int>(i)));
+			}
+			for (size_t i = 0; i < oldSwapChain->GetDepthImageCount(); i++)
+			{
+				retiredImageViews.push_back(oldSwapChain->GetDepthImageView(static_cast<int>(i)));
+			}
+			swapChain = std::make_unique<SwapChain>(device, extend, oldSwapChain, swapChainSettings);
 
 			if (!oldSwapChain->CompareSwapFormats(*swapChain.get()))
 			{
 				throw std::runtime_error("Swap chain image or depth format has change");
 			}
+			device.DeferDestroy([oldSwapChain]() mutable { oldSwapChain.reset(); });
+
+			auto end = std::chrono::high_resolution_clock::now();
+			double elapsedMs = std::chrono::duration<double, std::milli>(end - start).count();
+			recreateStats.count++;
+			recreateStats.lastMs = elapsedMs;
+			recreateStats.maxMs = std::max(recreateStats.maxMs, elapsedMs);
+			recreateStats.totalMs += elapsedMs;
 		}
+		currentFrameIndex = static_cast<int>(swapChain->GetCurrentFrame());
 	}
 
 	void Renderer::FreeCommandBuffers()
@@ -74,9 +107,85 @@ namespace Application
 		commandBuffers.clear();
 	}
 
+	void Renderer::SetSwapChainSettings(const SwapChainSettings& settings)
+	{
+		swapChainSettings = settings;
+		// Applied at the end of the current frame, the swap chain is recreated with the new settings
+		swapChainSettingsChanged = true;
+	}
+
+	void Renderer::RecordFrameStats(std::chrono::high_resolution_clock::time_point frameStart)
+	{
+		if (hasLastFrameStart)
+		{
+			// Welford's running mean and variance of the frame time
+			double frameMs = std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count();
+			frameStats.frameCount++;
+			double delta = frameMs - frameStats.meanFrameMs;
+			frameStats.meanFrameMs += delta / frameStats.frameCount;
+			frameStats.frameM2 += delta * (frameMs - frameStats.meanFrameMs);
+		}
+		lastFrameStart = frameStart;
+		hasLastFrameStart = true;
+
+		// Present ids are the frame timeline values. With present wait a frame is done once it is
+		// displayed, otherwise once the timeline says the GPU finished it. Checked once per frame
+		// so the latency is an upper bound off by at most one frame time.
+		auto now = std::chrono::high_resolution_clock::now();
+		frameStats.latencyToDisplay = device.SupportsPresentWait();
+		while (!pendingLatencies.empty())
+		{
+			const uint64_t frame = pendingLatencies.front().frame;
+			if (frameStats.latencyToDisplay)
+			{
+				// Presents of a retired swap chain can't be polled anymore
+				VkResult result = swapChain->CanPollPresent(frame) ? swapChain->PollPresent(frame) : VK_ERROR_OUT_OF_DATE_KHR;
+				if (result == VK_TIMEOUT)
+				{
+					break;
+				}
+				if (result != VK_SUCCESS)
+				{
+					pendingLatencies.pop_front();
+					continue;
+				}
+			}
+			else if (!device.IsFrameComplete(frame))
+			{
+				break;
+			}
+
+			double latencyMs =
+				std::chrono::duration<double, std::milli>(now - pendingLatencies.front().inputTime).count();
+			frameStats.latencyCount++;
+			frameStats.meanLatencyMs += (latencyMs - frameStats.meanLatencyMs) / frameStats.latencyCount;
+			frameStats.maxLatencyMs = std::max(frameStats.maxLatencyMs, latencyMs);
+			pendingLatencies.pop_front();
+		}
+	}
+
+	void Renderer::ReportFrameStats()
+	{
+		if (frameStats.frameCount > 0)
+		{
+			std::cout << "Present policy " << SwapChain::GetPresentPolicyName(swapChain->GetSettings().presentPolicy)
+				<< ", " << swapChain->GetSettings().framesInFlight << " frames in flight: "
+				<< frameStats.frameCount << " frames, frame time avg " << frameStats.meanFrameMs
+				<< " ms (stddev " << std::sqrt(frameStats.GetFrameTimeVariance()) << " ms), input to "
+				<< (frameStats.latencyToDisplay ? "display" : "GPU done") << " avg "
+				<< frameStats.meanLatencyMs << " ms, max " << frameStats.maxLatencyMs << " ms" << std::endl;
+		}
+
+		frameStats = {};
+		pendingLatencies.clear();
+		hasLastFrameStart = false;
+	}
+
 	VkCommandBuffer Renderer::BeginFrame()
 	{
 		assert(!isFrameStarted && "Can't start new frame while already making an other");
+		// Input was polled right before, this is when the frame's input is sampled
+		auto frameStart = std::chrono::high_resolution_clock::now();
 		auto result = swapChain->AcquireNextImage(&currentImageIndex);
 
 		// Window probably resized
@@ -92,6 +201,13 @@ namespace Application
 		}
 
 		isFrameStarted = true;
+		frameInputTime = frameStart;
+		RecordFrameStats(frameStart);
+
+		// AcquireNextImage waited for this slot's last timeline value, its transient descriptor
+		// sets are free again
+		descriptorAllocator.BeginFrame(currentFrameIndex);
+		device.CollectDeferredDestroys();
 
 		auto commandBuffer = getCurrentCommandBuffer();
 		VkCommandBufferBeginInfo beginInfo{};
@@ -102,6 +218,9 @@ namespace Application
 			throw std::runtime_error("Failed to start to record command buffer");
 		}
 
+		// Finished uploads become usable by everything recorded after this
+		device.GetUploader().AcquireCompleted(commandBuffer);
+
 		return commandBuffer;
 	}
 
@@ -115,10 +234,18 @@ namespace Application
 		}
 
 		auto result = swapChain->SubmitCommandBuffers(&commandBuffer, &currentImageIndex);
+		pendingLatencies.push_back({ device.GetSubmittedFrame(), frameInputTime });
+
 		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-			window.WasWindowResized())
+			window.WasWindowResized() || swapChainSettingsChanged)
 		{
 			window.ResetWindowResizedFlag();
+			if (swapChainSettingsChanged)
+			{
+				// Stats are per settings so they can be compared against each other
+				ReportFrameStats();
+				swapChainSettingsChanged = false;
+			}
 			RecreateSwapChain();
 		}
 		else if (result != VK_SUCCESS)
@@ -127,51 +254,48 @@ namespace Application
 		}
 
 		isFrameStarted = false;
-		currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
+		// The swap chain owns the frame slot rotation, its frames in flight count can change at runtime
+		currentFrameIndex = static_cast<int>(swapChain->GetCurrentFrame());
 	}
 
-	void Renderer::BeginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	RenderGraph::Resource Renderer::ImportSwapChainImage(RenderGraph& graph)
 	{
-		assert(isFrameStarted && "Can't begin render pass if frame is not started");
-		assert(commandBuffer && "Can't begin render pass using a command buffer from an other frame");
-
-		// Recording render pass cmd
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = swapChain->GetRenderPass();
-		renderPassInfo.framebuffer = swapChain->GetFrameBuffer(currentImageIndex);
-		renderPassInfo.renderArea.offset = { 0,0 };
-		renderPassInfo.renderArea.extent = swapChain->GetSwapChainExtent();
-
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { 0.01f, 0.01f, 0.01f, 1.0f };
-		clearValues[1].depthStencil = { 1, 0 };
-
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
-
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(swapChain->GetSwapChainExtent().width);
-		viewport.height = static_cast<float>(swapChain->GetSwapChainExtent().height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		VkRect2D scissor{ {0,0}, swapChain->GetSwapChainExtent() };
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		assert(isFrameStarted && "Can't import the swap chain image if frame is not started");
+
+		// Views of the retired swap chains are destroyed with them, and so are their framebuffers
+		if (!retiredImageViews.empty())
+		{
+			graph.ReleaseImageViews(retiredImageViews);
+			retiredImageViews.clear();
+		}
 
+		// The acquire semaphore is waited on at the color output stage, the first write waits for it
+		return graph.ImportImage(
+			"Backbuffer",
+			swapChain->GetImage(currentImageIndex),
+			swapChain->GetImageView(currentImageIndex),
+			swapChain->GetSwapChainImageFormat(),
+			swapChain->GetSwapChainExtent(),
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
 	}
 
-	void Renderer::EndSwapChainRenderPass(VkCommandBuffer commandBuffer)
+	RenderGraph::Resource Renderer::ImportSwapChainDepth(RenderGraph& graph)
 	{
-		assert(isFrameStarted && "Can't end render pass if frame is not started");
-		assert(commandBuffer && "Can't end render pass using a command buffer from an other frame");
+		assert(isFrameStarted && "Can't import the depth image if frame is not started");
 
-		// Ending recording
-		vkCmdEndRenderPass(commandBuffer);
+		// Each frame slot has its own depth image, frames in flight don't wait on each other's
+		// depth tests. Cleared on first use and discarded after the last one.
+		return graph.ImportImage(
+			"Depth",
+			swapChain->GetDepthImage(currentFrameIndex),
+			swapChain->GetDepthImageView(currentFrameIndex),
+			swapChain->GetSwapChainDepthFormat(),
+			swapChain->GetSwapChainExtent(),
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
 	}
 
 }
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "../Public/SceneFile.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+#include <unordered_map>
+#include <filesystem>
+#include <chrono>
+#include <random>
+#include <iostream>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr char SCENE_MAGIC[4] = { 'V', 'K', 'S', 'C' };
+		constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+		constexpr uint64_t SECTION_ALIGNMENT = 16;
+
+		constexpr uint32_t BENCHMARK_OBJECTS = 1'000'000;
+		constexpr uint32_t BENCHMARK_MODELS = 4;
+
+		double MsSince(std::chrono::high_resolution_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		uint64_t AlignUp(uint64_t value)
+		{
+			return (value + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+		}
+
+		uint64_t HandleKey(Handle<Model> handle)
+		{
+			return static_cast<uint64_t>(handle.index) << 32 | handle.generation;
+		}
+	}
+
+	// The sections are the components' memory as is
+	static_assert(sizeof(glm::vec2) == 8 && sizeof(glm::vec3) == 12, "Scene sections expect tightly packed vectors");
+
+	SceneFile::SceneFile(const std::string& filepath) : file{filepath}
+	{
+		if (file.GetSize() < sizeof(Header))
+		{
+			throw std::runtime_error("Not a scene file: " + filepath);
+		}
+		header = reinterpret_cast<const Header*>(file.GetData());
+		if (memcmp(header->magic, SCENE_MAGIC, sizeof(SCENE_MAGIC)) != 0)
+		{
+			throw std::runtime_error("Not a scene file: " + filepath);
+		}
+		if (header->version != VERSION)
+		{
+			throw std::runtime_error("Unsupported scene file version " + std::to_string(header->version) + ": " + filepath);
+		}
+		// Only written and read on little-endian machines, a mismatch means the wrong byte order
+		if (header->byteOrder != BYTE_ORDER_MARK)
+		{
+			throw std::runtime_error("Scene file byte order doesn't match this machine: " + filepath);
+		}
+		if (header->fileSize != file.GetSize())
+		{
+			throw std::runtime_error("Truncated scene file: " + filepath);
+		}
+
+		const uint64_t objectCount = header->objectCount;
+		const uint64_t expectedSizes[SECTION_COUNT] =
+		{
+			header->modelCount * sizeof(ModelName),
+			header->sectionSizes[STRINGS],
+			objectCount * sizeof(glm::vec2),
+			objectCount * sizeof(float),
+			objectCount * sizeof(glm::vec2),
+			objectCount * sizeof(glm::vec3),
+			objectCount * sizeof(uint32_t),
+			objectCount * sizeof(uint32_t)
+		};
+		for (uint32_t section = 0; section < SECTION_COUNT; section++)
+		{
+			const uint64_t offset = header->sectionOffsets[section];
+			const uint64_t size = header->sectionSizes[section];
+			if (size != expectedSizes[section] || offset % SECTION_ALIGNMENT != 0 ||
+				offset > header->fileSize || size > header->fileSize - offset)
+			{
+				throw std::runtime_error("Corrupted scene file section table: " + filepath);
+			}
+		}
+	}
+
+	std::string SceneFile::GetModelName(uint32_t model) const
+	{
+		const ModelName& name = Section<ModelName>(MODEL_NAMES)[model];
+		if (static_cast<uint64_t>(name.offset) + name.length > header->sectionSizes[STRINGS])
+		{
+			throw std::runtime_error("Corrupted scene file model name: " + file.GetPath());
+		}
+		return std::string{ Section<char>(STRINGS) + name.offset, name.length };
+	}
+
+	void SceneFile::Instantiate(GameObjectPool& gameObjects, const std::vector<Handle<Model>>& models) const
+	{
+		if (models.size() != GetModelCount())
+		{
+			throw std::runtime_error("Scene file models don't match the given handles: " + file.GetPath());
+		}
+
+		const uint32_t count = GetObjectCount();
+		const glm::vec2* translations = GetTranslations();
+		const float* rotations = GetRotations();
+		const glm::vec2* scales = GetScales();
+		const glm::vec3* colors = GetColors();
+		const uint32_t* textureIndices = GetTextureIndices();
+		const uint32_t* modelIndices = GetModelIndices();
+
+		gameObjects.Reserve(gameObjects.GetCount() + count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			GameObject& obj = *gameObjects.Get(gameObjects.CreateIndexed());
+			obj.transform2d.SetTranslation(translations[i]);
+			obj.transform2d.SetRotation(rotations[i]);
+			obj.transform2d.SetScale(scales[i]);
+			obj.color = colors[i];
+			obj.textureIndex = textureIndices[i];
+			// Out of range indices come from a damaged file, the object is kept without a model
+			obj.model = modelIndices[i] < models.size() ? models[modelIndices[i]] : Handle<Model>{};
+		}
+	}
+
+	void SceneFile::Write(const std::string& filepath, const GameObjectPool& gameObjects, const ModelTable& modelTable)
+	{
+		std::unordered_map<uint64_t, uint32_t> modelIndexOf;
+		std::vector<ModelName> modelNames;
+		std::string strings;
+		for (uint32_t i = 0; i < modelTable.size(); i++)
+		{
+			modelIndexOf[HandleKey(modelTable[i].second)] = i;
+			modelNames.push_back({ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(modelTable[i].first.size()) });
+			strings += modelTable[i].first;
+		}
+
+		const uint32_t count = gameObjects.GetCount();
+		std::vector<glm::vec2> translations;
+		std::vector<float> rotations;
+		std::vector<glm::vec2> scales;
+		std::vector<glm::vec3> colors;
+		std::vector<uint32_t> textureIndices;
+		std::vector<uint32_t> modelIndices;
+		translations.reserve(count);
+		rotations.reserve(count);
+		scales.reserve(count);
+		colors.reserve(count);
+		textureIndices.reserve(count);
+		modelIndices.reserve(count);
+		gameObjects.ForEach([&](const GameObject& obj)
+			{
+				translations.push_back(obj.transform2d.GetTranslation());
+				rotations.push_back(obj.transform2d.GetRotation());
+				scales.push_back(obj.transform2d.GetScale());
+				colors.push_back(obj.color);
+				textureIndices.push_back(obj.textureIndex);
+				auto it = modelIndexOf.find(HandleKey(obj.model));
+				modelIndices.push_back(it != modelIndexOf.end() ? it->second : NO_MODEL);
+			});
+
+		const std::pair<const void*, uint64_t> sections[SECTION_COUNT] =
+		{
+			{ modelNames.data(), modelNames.size() * sizeof(ModelName) },
+			{ strings.data(), strings.size() },
+			{ translations.data(), translations.size() * sizeof(glm::vec2) },
+			{ rotations.data(), rotations.size() * sizeof(float) },
+			{ scales.data(), scales.size() * sizeof(glm::vec2) },
+			{ colors.data(), colors.size() * sizeof(glm::vec3) },
+			{ textureIndices.data(), textureIndices.size() * sizeof(uint32_t) },
+			{ modelIndices.data(), modelIndices.size() * sizeof(uint32_t) }
+		};
+
+		Header header{};
+		memcpy(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+		header.version = VERSION;
+		header.byteOrder = BYTE_ORDER_MARK;
+		header.objectCount = count;
+		header.modelCount = static_cast<uint32_t>(modelTable.size());
+		uint64_t offset = AlignUp(sizeof(Header));
+		for (uint32_t section = 0; section < SECTION_COUNT; section++)
+		{
+			header.sectionOffsets[section] = offset;
+			header.sectionSizes[section] = sections[section].second;
+			offset = AlignUp(offset + sections[section].second);
+		}
+		header.fileSize = offset;
+
+		std::ofstream out{ filepath, std::ios::binary | std::ios::trunc };
+		if (!out.is_open())
+		{
+			throw std::runtime_error("Failed to open file for writing: " + filepath);
+		}
+		const char padding[SECTION_ALIGNMENT] = {};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(padding, AlignUp(sizeof(Header)) - sizeof(Header));
+		for (uint32_t section = 0; section < SECTION_COUNT; section++)
+		{
+			const uint64_t size = sections[section].second;
+			out.write(static_cast<const char*>(sections[section].first), size);
+			out.write(padding, AlignUp(size) - size);
+		}
+		if (!out)
+		{
+			throw std::runtime_error("Failed to write scene file: " + filepath);
+		}
+	}
+
+	void SceneFile::RunBenchmark()
+	{
+		std::mt19937 random{ 3 };
+		std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+
+		ModelTable modelTable;
+		std::vector<Handle<Model>> modelHandles;
+		for (uint32_t i = 0; i < BENCHMARK_MODELS; i++)
+		{
+			// Stand-in handles, the benchmark never draws
+			modelHandles.push_back({ i, 1 });
+			modelTable.push_back({ "Model" + std::to_string(i), modelHandles.back() });
+		}
+
+		GameObjectPool source;
+		source.Reserve(BENCHMARK_OBJECTS);
+		for (uint32_t i = 0; i < BENCHMARK_OBJECTS; i++)
+		{
+			GameObject& obj = *source.Get(source.CreateIndexed());
+			obj.transform2d.SetTranslation({ unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f });
+			obj.transform2d.SetRotation(unit(random) * 6.2831853f);
+			obj.transform2d.SetScale(glm::vec2{ 0.01f + unit(random) * 0.05f });
+			obj.color = { unit(random), unit(random), unit(random) };
+			obj.textureIndex = i % 16;
+			obj.model = modelHandles[i % BENCHMARK_MODELS];
+		}
+
+		const auto directory = std::filesystem::temp_directory_path();
+		const std::string binaryPath = (directory / "benchmark.scene").string();
+		const std::string textPath = (directory / "benchmark.scene.txt").string();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		Write(binaryPath, source, modelTable);
+		double binaryWriteMs = MsSince(start);
+
+		// One line per object, what a readable format costs
+		start = std::chrono::high_resolution_clock::now();
+		{
+			std::ofstream out{ textPath, std::ios::trunc };
+			source.ForEach([&](const GameObject& obj)
+				{
+					const auto& transform = obj.transform2d;
+					out << modelTable[obj.model.index].first << ' ' << transform.GetTranslation().x << ' '
+						<< transform.GetTranslation().y << ' ' << transform.GetRotation() << ' ' << transform.GetScale().x << ' '
+						<< transform.GetScale().y << ' ' << obj.color.x << ' ' << obj.color.y << ' ' << obj.color.z << ' '
+						<< obj.textureIndex << '\n';
+				});
+		}
+		double textWriteMs = MsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		double binaryMapMs = 0.0;
+		uint32_t binaryCount = 0;
+		{
+			SceneFile scene{ binaryPath };
+			binaryMapMs = MsSince(start);
+			GameObjectPool loaded;
+			scene.Instantiate(loaded, modelHandles);
+			binaryCount = loaded.GetCount();
+		}
+		double binaryLoadMs = MsSince(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		uint32_t textCount = 0;
+		{
+			std::unordered_map<std::string, Handle<Model>> modelByName;
+			for (const auto& [name, handle] : modelTable)
+			{
+				modelByName[name] = handle;
+			}
+
+			std::ifstream in{ textPath };
+			GameObjectPool loaded;
+			std::string modelName;
+			glm::vec2 translation;
+			float rotation;
+			glm::vec2 scale;
+			glm::vec3 color;
+			uint32_t textureIndex;
+			while (in >> modelName >> translation.x >> translation.y >> rotation >> scale.x >> scale.y >> color.x >> color.y
+				>> color.z >> textureIndex)
+			{
+				GameObject& obj = *loaded.Get(loaded.CreateIndexed());
+				obj.transform2d.SetTranslation(translation);
+				obj.transform2d.SetRotation(rotation);
+				obj.transform2d.SetScale(scale);
+				obj.color = color;
+				obj.textureIndex = textureIndex;
+				obj.model = modelByName[modelName];
+			}
+			textCount = loaded.GetCount();
+		}
+		double textLoadMs = MsSince(start);
+
+		const double binaryMb = std::filesystem::file_size(binaryPath) / (1024.0 * 1024.0);
+		const double textMb = std::filesystem::file_size(textPath) / (1024.0 * 1024.0);
+		std::cout << "Scene files, " << BENCHMARK_OBJECTS << " objects" << std::endl;
+		std::cout << "  binary: " << binaryMb << " MB, write " << binaryWriteMs << " ms (" << binaryMb * 1000.0 / binaryWriteMs
+			<< " MB/s), map " << binaryMapMs << " ms, map and instantiate " << binaryLoadMs << " ms, "
+			<< binaryCount << " objects" << std::endl;
+		std::cout << "  text: " << textMb << " MB, write " << textWriteMs << " ms (" << textMb * 1000.0 / textWriteMs
+			<< " MB/s), load " << textLoadMs << " ms, " << textCount << " objects" << std::endl;
+
+		std::filesystem::remove(binaryPath);
+		std::filesystem::remove(textPath);
+	}
+}
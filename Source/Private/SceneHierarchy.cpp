@@ -0,0 +1,475 @@
+#include "../Public/SceneHierarchy.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <string>
+
+namespace Application
+{
+	namespace
+	{
+		// Nodes per batch, smaller levels are computed on the calling thread
+		constexpr uint32_t MIN_BATCH = 1024;
+
+		constexpr uint32_t BENCHMARK_ITERATIONS = 10;
+		// 1 + 32 + 32^2 + 32^3 + 32^4 nodes
+		constexpr uint32_t BENCHMARK_WIDE_BRANCHING = 32;
+		constexpr uint32_t BENCHMARK_WIDE_DEPTH = 4;
+		// 256 chains of 4096 nodes
+		constexpr uint32_t BENCHMARK_DEEP_CHAINS = 256;
+		constexpr uint32_t BENCHMARK_DEEP_LENGTH = 4096;
+
+		double MsSince(std::chrono::high_resolution_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		WorldTransform2d Compose(const WorldTransform2d& parent, const Transform2dComponent& local)
+		{
+			return { parent.matrix * local.mat2(), parent.matrix * local.GetTranslation() + parent.translation };
+		}
+
+		// What the level sorted arrays replace, every node its own allocation
+		struct PointerNode
+		{
+			Transform2dComponent local;
+			WorldTransform2d world;
+			std::vector<std::unique_ptr<PointerNode>> children;
+		};
+
+		void Propagate(PointerNode& node, const WorldTransform2d& parentWorld)
+		{
+			node.world = Compose(parentWorld, node.local);
+			for (auto& child : node.children)
+			{
+				Propagate(*child, node.world);
+			}
+		}
+	}
+
+	SceneHierarchy::~SceneHierarchy()
+	{
+		for (Node& node : nodes)
+		{
+			if (node.object)
+			{
+				node.object->hierarchyNode = INVALID_NODE;
+				node.object->hierarchy = nullptr;
+			}
+		}
+	}
+
+	SceneHierarchy::NodeId SceneHierarchy::AddNode(NodeId parent)
+	{
+		if (parent != INVALID_NODE && (parent >= nodes.size() || !nodes[parent].alive))
+		{
+			throw std::runtime_error("Parent node doesn't exist");
+		}
+
+		NodeId id;
+		if (!freeIds.empty())
+		{
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+		else
+		{
+			id = static_cast<NodeId>(nodes.size());
+			nodes.emplace_back();
+		}
+
+		// Appended unsorted, the next Update puts it in its level
+		nodes[id] = { parent, static_cast<uint32_t>(order.size()), true };
+		order.push_back(id);
+		locals.emplace_back();
+		worlds.emplace_back();
+		localVersions.push_back(0);
+		worldChanged.push_back(1);
+		orderDirty = true;
+		return id;
+	}
+
+	void SceneHierarchy::RemoveNode(NodeId node)
+	{
+		if (node >= nodes.size() || !nodes[node].alive)
+		{
+			throw std::runtime_error("Node doesn't exist");
+		}
+
+		// The subtree's objects don't wait for the Update that frees the ids, the nodes only
+		// know their parent so every node is checked for an ancestor in the subtree
+		constexpr uint8_t UNKNOWN = 0;
+		constexpr uint8_t INSIDE = 1;
+		constexpr uint8_t OUTSIDE = 2;
+		std::vector<uint8_t> states(nodes.size(), UNKNOWN);
+		states[node] = INSIDE;
+		std::vector<NodeId> path;
+		for (NodeId id : order)
+		{
+			NodeId ancestor = id;
+			while (ancestor != INVALID_NODE && states[ancestor] == UNKNOWN)
+			{
+				path.push_back(ancestor);
+				ancestor = nodes[ancestor].parent;
+			}
+			const uint8_t state = ancestor == INVALID_NODE ? OUTSIDE : states[ancestor];
+			for (NodeId visited : path)
+			{
+				states[visited] = state;
+			}
+			path.clear();
+
+			if (state == INSIDE && nodes[id].object)
+			{
+				ReleaseObject(nodes[id]);
+			}
+		}
+
+		nodes[node].alive = false;
+		orderDirty = true;
+	}
+
+	void SceneHierarchy::ReleaseObject(Node& node)
+	{
+		node.object->hierarchyNode = INVALID_NODE;
+		node.object->hierarchy = nullptr;
+		releasedObjects.push_back(node.object->GetId());
+		node.object = nullptr;
+	}
+
+	void SceneHierarchy::SetParent(NodeId node, NodeId parent)
+	{
+		for (NodeId ancestor = parent; ancestor != INVALID_NODE; ancestor = nodes[ancestor].parent)
+		{
+			if (ancestor == node)
+			{
+				throw std::runtime_error("A node can't be parented to itself or its descendants");
+			}
+		}
+		nodes[node].parent = parent;
+		orderDirty = true;
+	}
+
+	void SceneHierarchy::Attach(GameObject& object, GameObject* parent)
+	{
+		for (GameObject* attached : { parent, &object })
+		{
+			if (attached && attached->hierarchy && attached->hierarchy != this)
+			{
+				throw std::runtime_error("Game object is attached to another hierarchy");
+			}
+		}
+
+		NodeId parentNode = INVALID_NODE;
+		if (parent)
+		{
+			if (parent->hierarchyNode == INVALID_NODE)
+			{
+				parent->hierarchyNode = AddNode();
+				parent->hierarchy = this;
+				nodes[parent->hierarchyNode].object = parent;
+			}
+			parentNode = parent->hierarchyNode;
+		}
+
+		if (object.hierarchyNode == INVALID_NODE)
+		{
+			object.hierarchyNode = AddNode(parentNode);
+			object.hierarchy = this;
+			nodes[object.hierarchyNode].object = &object;
+		}
+		else
+		{
+			SetParent(object.hierarchyNode, parentNode);
+		}
+	}
+
+	void SceneHierarchy::Detach(GameObject& object)
+	{
+		if (object.hierarchyNode != INVALID_NODE && object.hierarchy == this)
+		{
+			RemoveNode(object.hierarchyNode);
+		}
+	}
+
+	void SceneHierarchy::SyncLocals()
+	{
+		// Only the attached objects are visited, not the whole pool
+		for (NodeId id : order)
+		{
+			Node& node = nodes[id];
+			if (!node.alive || !node.object)
+			{
+				continue;
+			}
+			const Transform2dComponent& source = node.object->transform2d;
+			if (node.objectVersion == source.GetVersion())
+			{
+				continue;
+			}
+			node.objectVersion = source.GetVersion();
+
+			Transform2dComponent& local = locals[node.index];
+			local.SetTranslation(source.GetTranslation());
+			local.SetRotation(source.GetRotation());
+			local.SetScale(source.GetScale());
+		}
+	}
+
+	void SceneHierarchy::RebuildOrder()
+	{
+		// Children grouped by parent id
+		std::vector<uint32_t> childStarts(nodes.size() + 1, 0);
+		for (NodeId id : order)
+		{
+			if (nodes[id].alive && nodes[id].parent != INVALID_NODE)
+			{
+				childStarts[nodes[id].parent + 1]++;
+			}
+		}
+		for (size_t i = 1; i < childStarts.size(); i++)
+		{
+			childStarts[i] += childStarts[i - 1];
+		}
+		std::vector<NodeId> children(childStarts.back());
+		std::vector<uint32_t> childEnds(childStarts.begin(), childStarts.end() - 1);
+		for (NodeId id : order)
+		{
+			if (nodes[id].alive && nodes[id].parent != INVALID_NODE)
+			{
+				children[childEnds[nodes[id].parent]++] = id;
+			}
+		}
+
+		// Breadth first from the roots, a removed node's subtree is never reached
+		std::vector<NodeId> newOrder;
+		newOrder.reserve(order.size());
+		for (NodeId id : order)
+		{
+			if (nodes[id].alive && nodes[id].parent == INVALID_NODE)
+			{
+				newOrder.push_back(id);
+			}
+		}
+		levelStarts.assign(1, 0);
+		size_t levelBegin = 0;
+		while (levelBegin < newOrder.size())
+		{
+			const size_t levelEnd = newOrder.size();
+			levelStarts.push_back(static_cast<uint32_t>(levelEnd));
+			for (size_t i = levelBegin; i < levelEnd; i++)
+			{
+				const NodeId id = newOrder[i];
+				for (uint32_t child = childStarts[id]; child < childStarts[id + 1]; child++)
+				{
+					newOrder.push_back(children[child]);
+				}
+			}
+			levelBegin = levelEnd;
+		}
+
+		std::vector<Transform2dComponent> newLocals;
+		newLocals.reserve(newOrder.size());
+		for (NodeId id : newOrder)
+		{
+			newLocals.push_back(std::move(locals[nodes[id].index]));
+		}
+
+		for (NodeId id : order)
+		{
+			nodes[id].index = NOT_SORTED;
+		}
+		for (uint32_t i = 0; i < newOrder.size(); i++)
+		{
+			nodes[newOrder[i]].index = i;
+		}
+		// Removed nodes and their descendants free their ids
+		for (NodeId id : order)
+		{
+			if (nodes[id].index == NOT_SORTED)
+			{
+				nodes[id].alive = false;
+				freeIds.push_back(id);
+			}
+		}
+
+		parentIndices.resize(newOrder.size());
+		for (uint32_t i = 0; i < newOrder.size(); i++)
+		{
+			const NodeId parent = nodes[newOrder[i]].parent;
+			parentIndices[i] = parent == INVALID_NODE ? NOT_SORTED : nodes[parent].index;
+		}
+
+		order = std::move(newOrder);
+		locals = std::move(newLocals);
+		worlds.resize(order.size());
+		localVersions.resize(order.size());
+		worldChanged.resize(order.size());
+	}
+
+	void SceneHierarchy::Update(ThreadPool* threadPool)
+	{
+		if (orderDirty)
+		{
+			RebuildOrder();
+			orderDirty = false;
+			orderRebuilt = true;
+		}
+
+		// A level only reads the one above it, its nodes are independent
+		for (uint32_t level = 0; level < GetLevelCount(); level++)
+		{
+			const uint32_t begin = levelStarts[level];
+			const uint32_t end = levelStarts[level + 1];
+			if (threadPool)
+			{
+				threadPool->ParallelFor(end - begin, MIN_BATCH,
+					[this, begin](uint32_t first, uint32_t last) { UpdateLevel(begin + first, begin + last); });
+			}
+			else
+			{
+				UpdateLevel(begin, end);
+			}
+		}
+		orderRebuilt = false;
+
+		changedObjects.swap(releasedObjects);
+		releasedObjects.clear();
+		for (uint32_t i = 0; i < order.size(); i++)
+		{
+			const GameObject* object = nodes[order[i]].object;
+			if (worldChanged[i] && object)
+			{
+				changedObjects.push_back(object->GetId());
+			}
+		}
+	}
+
+	void SceneHierarchy::UpdateLevel(uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const uint32_t parent = parentIndices[i];
+			worlds[i] = parent == NOT_SORTED ?
+				WorldTransform2d::FromLocal(locals[i]) :
+				Compose(worlds[parent], locals[i]);
+
+			// A node moves with its parent, the parent's level is already done
+			const uint32_t version = locals[i].GetVersion();
+			worldChanged[i] = orderRebuilt || version != localVersions[i] || (parent != NOT_SORTED && worldChanged[parent]);
+			localVersions[i] = version;
+		}
+	}
+
+	void SceneHierarchy::RunBenchmark()
+	{
+		ThreadPool threadPool;
+
+		// Parents are given in depth first creation order, a parent comes before its children
+		auto run = [&](const std::string& name, const std::vector<uint32_t>& parents)
+			{
+				std::mt19937 random{ 11 };
+				std::uniform_real_distribution<float> rotation{ -0.1f, 0.1f };
+				std::uniform_real_distribution<float> translation{ -1.0f, 1.0f };
+				std::uniform_real_distribution<float> scale{ 0.99f, 1.01f };
+
+				SceneHierarchy hierarchy;
+				std::vector<std::unique_ptr<PointerNode>> roots;
+				std::vector<PointerNode*> pointerNodes(parents.size());
+				for (size_t i = 0; i < parents.size(); i++)
+				{
+					const bool root = parents[i] == INVALID_NODE;
+					hierarchy.AddNode(root ? INVALID_NODE : parents[i]);
+
+					auto node = std::make_unique<PointerNode>();
+					pointerNodes[i] = node.get();
+					(root ? roots : pointerNodes[parents[i]]->children).push_back(std::move(node));
+
+					const float nodeRotation = rotation(random);
+					const glm::vec2 nodeTranslation{ translation(random), translation(random) };
+					const glm::vec2 nodeScale{ scale(random), scale(random) };
+					for (Transform2dComponent* local : { &hierarchy.GetLocal(static_cast<NodeId>(i)), &pointerNodes[i]->local })
+					{
+						local->SetRotation(nodeRotation);
+						local->SetTranslation(nodeTranslation);
+						local->SetScale(nodeScale);
+					}
+				}
+
+				auto start = std::chrono::high_resolution_clock::now();
+				hierarchy.Update();
+				double sortMs = MsSince(start);
+
+				start = std::chrono::high_resolution_clock::now();
+				for (uint32_t iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++)
+				{
+					for (auto& root : roots)
+					{
+						Propagate(*root, WorldTransform2d{});
+					}
+				}
+				double recursiveMs = MsSince(start) / BENCHMARK_ITERATIONS;
+
+				start = std::chrono::high_resolution_clock::now();
+				for (uint32_t iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++)
+				{
+					hierarchy.Update();
+				}
+				double sortedMs = MsSince(start) / BENCHMARK_ITERATIONS;
+
+				start = std::chrono::high_resolution_clock::now();
+				for (uint32_t iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++)
+				{
+					hierarchy.Update(&threadPool);
+				}
+				double parallelMs = MsSince(start) / BENCHMARK_ITERATIONS;
+
+				// Both walks must agree
+				float maxDifference = 0.0f;
+				for (size_t i = 0; i < parents.size(); i++)
+				{
+					glm::vec2 difference = glm::abs(hierarchy.GetWorld(static_cast<NodeId>(i)).translation -
+						pointerNodes[i]->world.translation);
+					maxDifference = std::max(maxDifference, std::max(difference.x, difference.y));
+				}
+
+				std::cout << "  " << name << ", " << parents.size() << " nodes in " << hierarchy.GetLevelCount()
+					<< " levels: recursive " << recursiveMs << " ms, level sorted " << sortedMs << " ms, level sorted on "
+					<< threadPool.GetWorkerCount() + 1 << " threads " << parallelMs << " ms, first sort " << sortMs
+					<< " ms, max difference " << maxDifference << std::endl;
+			};
+
+		std::cout << "Scene hierarchy world transforms" << std::endl;
+
+		std::vector<uint32_t> parents;
+		auto addWide = [&](auto& self, uint32_t parent, uint32_t depth) -> void
+			{
+				const uint32_t node = static_cast<uint32_t>(parents.size());
+				parents.push_back(parent);
+				if (depth < BENCHMARK_WIDE_DEPTH)
+				{
+					for (uint32_t child = 0; child < BENCHMARK_WIDE_BRANCHING; child++)
+					{
+						self(self, node, depth + 1);
+					}
+				}
+			};
+		addWide(addWide, INVALID_NODE, 0);
+		run("wide tree", parents);
+
+		parents.clear();
+		for (uint32_t chain = 0; chain < BENCHMARK_DEEP_CHAINS; chain++)
+		{
+			parents.push_back(INVALID_NODE);
+			for (uint32_t i = 1; i < BENCHMARK_DEEP_LENGTH; i++)
+			{
+				parents.push_back(static_cast<uint32_t>(parents.size() - 1));
+			}
+		}
+		run("deep tree", parents);
+	}
+}
@@ -0,0 +1,507 @@
+#include "../Public/SpatialIndex.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <iostream>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr uint32_t BENCHMARK_OBJECTS = 1'000'000;
+		constexpr float BENCHMARK_WORLD_HALF_SIZE = 1000.0f;
+		constexpr uint32_t BENCHMARK_FRAMES = 10;
+		constexpr uint32_t BENCHMARK_QUERIES = 1000;
+		constexpr uint32_t BENCHMARK_BRUTE_FORCE_QUERIES = 20;
+		constexpr float BENCHMARK_QUERY_SIZE = 20.0f;
+		// Objects moved per frame in the Sync run
+		constexpr uint32_t BENCHMARK_SYNC_MOVED = 10'000;
+
+		double MsSince(std::chrono::high_resolution_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+	}
+
+	void SpatialIndex::QueryRadius(glm::vec2 center, float radius, std::vector<Id>& results) const
+	{
+		size_t first = results.size();
+		QueryRect({ center - radius, center + radius }, results);
+
+		// The rect query returns the square around the circle, keep the boxes closer than radius
+		const float radiusSquared = radius * radius;
+		results.erase(std::remove_if(results.begin() + first, results.end(),
+			[&](Id id)
+			{
+				const Aabb2d& bounds = GetBounds(id);
+				glm::vec2 offset = glm::clamp(center, bounds.min, bounds.max) - center;
+				return glm::dot(offset, offset) > radiusSquared;
+			}), results.end());
+	}
+
+	void SpatialIndex::Insert(const GameObject& object, const SceneHierarchy* hierarchy)
+	{
+		Update(object.GetId(), BoundsOf(object, hierarchy));
+	}
+
+	void SpatialIndex::Sync(const GameObjectPool& gameObjects, const TransformChangeList& changes,
+		const SceneHierarchy* hierarchy)
+	{
+		// Destroyed since they changed, or never inserted
+		auto sync = [&](Id id)
+			{
+				if (gameObjects.IsAlive(id) && Contains(id))
+				{
+					Update(id, BoundsOf(gameObjects[id], hierarchy));
+				}
+			};
+
+		for (Id id : changes.GetChanged())
+		{
+			sync(id);
+		}
+		// Moved with a parent or detached, their own transform didn't change
+		if (hierarchy)
+		{
+			for (Id id : hierarchy->GetChangedObjects())
+			{
+				sync(id);
+			}
+		}
+	}
+
+	Aabb2d SpatialIndex::BoundsOf(const Transform2dComponent& transform)
+	{
+		return BoundsOf(WorldTransform2d::FromLocal(transform));
+	}
+
+	Aabb2d SpatialIndex::BoundsOf(const WorldTransform2d& transform)
+	{
+		// Half extents of the rotated and scaled unit square
+		glm::vec2 halfExtent = 0.5f * (glm::abs(transform.matrix[0]) + glm::abs(transform.matrix[1]));
+		return { transform.translation - halfExtent, transform.translation + halfExtent };
+	}
+
+	Aabb2d SpatialIndex::BoundsOf(const GameObject& object, const SceneHierarchy* hierarchy)
+	{
+		return hierarchy ? BoundsOf(hierarchy->GetWorld(object)) : BoundsOf(object.transform2d);
+	}
+
+	SpatialHashGrid::SpatialHashGrid(float cellSize, uint32_t bucketCount) :
+		cellSize{cellSize}, inverseCellSize{1.0f / cellSize}, bucketMask{bucketCount - 1}
+	{
+		assert(bucketCount > 0 && (bucketCount & (bucketCount - 1)) == 0 && "Bucket count must be a power of two");
+		buckets.resize(bucketCount + 1);
+		oversizedBucket = bucketCount;
+	}
+
+	glm::ivec2 SpatialHashGrid::CellOf(glm::vec2 position) const
+	{
+		// Clamped so far away positions don't overflow the cell coordinates
+		glm::vec2 cell = glm::clamp(glm::floor(position * inverseCellSize), glm::vec2{ -1e9f }, glm::vec2{ 1e9f });
+		return glm::ivec2{ cell };
+	}
+
+	uint32_t SpatialHashGrid::BucketOf(glm::ivec2 cell) const
+	{
+		return (static_cast<uint32_t>(cell.x) * 73856093u ^ static_cast<uint32_t>(cell.y) * 19349663u) & bucketMask;
+	}
+
+	void SpatialHashGrid::Update(Id id, const Aabb2d& bounds)
+	{
+		if (id >= entries.size())
+		{
+			entries.resize(static_cast<size_t>(id) + 1);
+		}
+
+		glm::vec2 size = bounds.Size();
+		bool oversized = size.x > cellSize || size.y > cellSize;
+		glm::ivec2 cell = oversized ? glm::ivec2{ 0 } : CellOf(bounds.Center());
+		uint32_t bucket = oversized ? oversizedBucket : BucketOf(cell);
+
+		Entry& entry = entries[id];
+		entry.bounds = bounds;
+		entry.cell = cell;
+		if (entry.bucket == bucket)
+		{
+			return;
+		}
+
+		if (entry.bucket != NOT_PRESENT)
+		{
+			RemoveFromBucket(id);
+		}
+		else
+		{
+			count++;
+		}
+		entry.bucket = bucket;
+		entry.slot = static_cast<uint32_t>(buckets[bucket].size());
+		buckets[bucket].push_back(id);
+	}
+
+	void SpatialHashGrid::Remove(Id id)
+	{
+		if (!Contains(id))
+		{
+			return;
+		}
+		RemoveFromBucket(id);
+		entries[id].bucket = NOT_PRESENT;
+		count--;
+	}
+
+	void SpatialHashGrid::RemoveFromBucket(Id id)
+	{
+		const Entry& entry = entries[id];
+		auto& bucket = buckets[entry.bucket];
+		Id last = bucket.back();
+		bucket[entry.slot] = last;
+		entries[last].slot = entry.slot;
+		bucket.pop_back();
+	}
+
+	void SpatialHashGrid::QueryRect(const Aabb2d& rect, std::vector<Id>& results) const
+	{
+		for (Id id : buckets[oversizedBucket])
+		{
+			if (entries[id].bounds.Intersects(rect))
+			{
+				results.push_back(id);
+			}
+		}
+
+		// An object overlapping rect has its center at most half a cell outside of it
+		const glm::vec2 margin{ cellSize * 0.5f };
+		glm::ivec2 minCell = CellOf(rect.min - margin);
+		glm::ivec2 maxCell = CellOf(rect.max + margin);
+		int64_t cellCount = (static_cast<int64_t>(maxCell.x) - minCell.x + 1) * (static_cast<int64_t>(maxCell.y) - minCell.y + 1);
+
+		// More cells than buckets, every bucket would be visited anyway
+		if (cellCount >= static_cast<int64_t>(oversizedBucket))
+		{
+			for (uint32_t bucket = 0; bucket < oversizedBucket; bucket++)
+			{
+				for (Id id : buckets[bucket])
+				{
+					if (entries[id].bounds.Intersects(rect))
+					{
+						results.push_back(id);
+					}
+				}
+			}
+			return;
+		}
+
+		for (int32_t y = minCell.y; y <= maxCell.y; y++)
+		{
+			for (int32_t x = minCell.x; x <= maxCell.x; x++)
+			{
+				glm::ivec2 cell{ x, y };
+				// Buckets are shared by colliding cells, only this cell's objects are reported
+				// here so none is reported twice
+				for (Id id : buckets[BucketOf(cell)])
+				{
+					const Entry& entry = entries[id];
+					if (entry.cell == cell && entry.bounds.Intersects(rect))
+					{
+						results.push_back(id);
+					}
+				}
+			}
+		}
+	}
+
+	LooseQuadtree::LooseQuadtree(const Aabb2d& worldBounds, uint32_t maxDepth) :
+		worldBounds{worldBounds}, maxDepth{std::min(maxDepth, MAX_DEPTH)}
+	{
+		glm::vec2 size = worldBounds.Size();
+		worldSize = std::max(size.x, size.y);
+	}
+
+	uint64_t LooseQuadtree::ParentKey(uint64_t key)
+	{
+		uint32_t level = static_cast<uint32_t>(key >> 58);
+		uint32_t x = static_cast<uint32_t>(key >> 29) & ((1u << 29) - 1);
+		uint32_t y = static_cast<uint32_t>(key) & ((1u << 29) - 1);
+		return MakeKey(level - 1, x >> 1, y >> 1);
+	}
+
+	uint64_t LooseQuadtree::NodeOf(const Aabb2d& bounds) const
+	{
+		if (!worldBounds.Contains(bounds))
+		{
+			return MakeKey(0, 0, 0);
+		}
+
+		// Deepest level whose cells are at least as large as the object, a loose node then
+		// contains every object centered in its cell
+		glm::vec2 size = bounds.Size();
+		float extent = std::max(size.x, size.y);
+		uint32_t level = maxDepth;
+		if (extent > 0.0f)
+		{
+			float fit = std::floor(std::log2(worldSize / extent));
+			level = std::min(maxDepth, static_cast<uint32_t>(std::max(0.0f, fit)));
+		}
+
+		uint32_t cellsPerSide = 1u << level;
+		float nodeSize = worldSize / cellsPerSide;
+		glm::vec2 local = (bounds.Center() - worldBounds.min) / nodeSize;
+		uint32_t x = std::min(static_cast<uint32_t>(local.x), cellsPerSide - 1);
+		uint32_t y = std::min(static_cast<uint32_t>(local.y), cellsPerSide - 1);
+		return MakeKey(level, x, y);
+	}
+
+	void LooseQuadtree::Update(Id id, const Aabb2d& bounds)
+	{
+		if (id >= entries.size())
+		{
+			entries.resize(static_cast<size_t>(id) + 1);
+		}
+
+		uint64_t key = NodeOf(bounds);
+		Entry& entry = entries[id];
+		entry.bounds = bounds;
+		if (entry.node == key)
+		{
+			return;
+		}
+
+		if (entry.node != NOT_PRESENT)
+		{
+			Remove(id);
+		}
+		count++;
+
+		Node& node = nodes[key];
+		entry.node = key;
+		entry.slot = static_cast<uint32_t>(node.objects.size());
+		node.objects.push_back(id);
+		for (uint64_t ancestor = key;; ancestor = ParentKey(ancestor))
+		{
+			nodes[ancestor].subtreeCount++;
+			if ((ancestor >> 58) == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	void LooseQuadtree::Remove(Id id)
+	{
+		if (!Contains(id))
+		{
+			return;
+		}
+
+		Entry& entry = entries[id];
+		auto& objects = nodes.find(entry.node)->second.objects;
+		Id last = objects.back();
+		objects[entry.slot] = last;
+		entries[last].slot = entry.slot;
+		objects.pop_back();
+
+		for (uint64_t ancestor = entry.node;; ancestor = ParentKey(ancestor))
+		{
+			auto it = nodes.find(ancestor);
+			if (--it->second.subtreeCount == 0)
+			{
+				nodes.erase(it);
+			}
+			if ((ancestor >> 58) == 0)
+			{
+				break;
+			}
+		}
+
+		entry.node = NOT_PRESENT;
+		count--;
+	}
+
+	void LooseQuadtree::QueryRect(const Aabb2d& rect, std::vector<Id>& results) const
+	{
+		QueryNode(0, 0, 0, rect, results);
+	}
+
+	void LooseQuadtree::QueryNode(uint32_t level, uint32_t x, uint32_t y, const Aabb2d& rect, std::vector<Id>& results) const
+	{
+		auto it = nodes.find(MakeKey(level, x, y));
+		if (it == nodes.end())
+		{
+			return;
+		}
+
+		// The root also holds the objects outside the world, it is always visited
+		if (level > 0)
+		{
+			float nodeSize = worldSize / (1u << level);
+			glm::vec2 looseMin = worldBounds.min + glm::vec2{ x, y } * nodeSize - nodeSize * 0.5f;
+			if (!Aabb2d{ looseMin, looseMin + nodeSize * 2.0f }.Intersects(rect))
+			{
+				return;
+			}
+		}
+
+		const Node& node = it->second;
+		for (Id id : node.objects)
+		{
+			if (entries[id].bounds.Intersects(rect))
+			{
+				results.push_back(id);
+			}
+		}
+
+		if (level < maxDepth && node.subtreeCount > node.objects.size())
+		{
+			for (uint32_t child = 0; child < 4; child++)
+			{
+				QueryNode(level + 1, x * 2 + (child & 1), y * 2 + (child >> 1), rect, results);
+			}
+		}
+	}
+
+	void SpatialIndex::RunBenchmark()
+	{
+		std::mt19937 random{ 7 };
+		std::uniform_real_distribution<float> position{ -BENCHMARK_WORLD_HALF_SIZE, BENCHMARK_WORLD_HALF_SIZE };
+		std::uniform_real_distribution<float> size{ 0.5f, 2.0f };
+		std::uniform_real_distribution<float> velocity{ -5.0f, 5.0f };
+
+		std::vector<Aabb2d> startBounds(BENCHMARK_OBJECTS);
+		std::vector<glm::vec2> velocities(BENCHMARK_OBJECTS);
+		for (uint32_t i = 0; i < BENCHMARK_OBJECTS; i++)
+		{
+			glm::vec2 center{ position(random), position(random) };
+			glm::vec2 halfExtent = glm::vec2{ size(random), size(random) } * 0.5f;
+			startBounds[i] = { center - halfExtent, center + halfExtent };
+			velocities[i] = { velocity(random), velocity(random) };
+		}
+		std::vector<glm::vec2> queryCenters(BENCHMARK_QUERIES);
+		for (auto& center : queryCenters)
+		{
+			center = { position(random), position(random) };
+		}
+
+		std::cout << "Spatial index, " << BENCHMARK_OBJECTS << " moving objects in a "
+			<< BENCHMARK_WORLD_HALF_SIZE * 2.0f << " units world, " << BENCHMARK_QUERY_SIZE << " units queries" << std::endl;
+
+		auto run = [&](SpatialIndex& index, const char* name)
+			{
+				std::vector<Aabb2d> bounds = startBounds;
+				auto start = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < BENCHMARK_OBJECTS; i++)
+				{
+					index.Update(i, bounds[i]);
+				}
+				double insertMs = MsSince(start);
+
+				// Wrapping around the world, as a game would keep them in
+				const float dt = 1.0f / 60.0f;
+				start = std::chrono::high_resolution_clock::now();
+				for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++)
+				{
+					for (uint32_t i = 0; i < BENCHMARK_OBJECTS; i++)
+					{
+						glm::vec2 offset = velocities[i] * dt;
+						glm::vec2 center = bounds[i].Center() + offset;
+						if (std::abs(center.x) > BENCHMARK_WORLD_HALF_SIZE || std::abs(center.y) > BENCHMARK_WORLD_HALF_SIZE)
+						{
+							offset -= center * 2.0f * 0.999f;
+						}
+						bounds[i].min += offset;
+						bounds[i].max += offset;
+						index.Update(i, bounds[i]);
+					}
+				}
+				double updateMs = MsSince(start) / BENCHMARK_FRAMES;
+
+				std::vector<Id> results;
+				start = std::chrono::high_resolution_clock::now();
+				for (glm::vec2 center : queryCenters)
+				{
+					index.QueryRect({ center - BENCHMARK_QUERY_SIZE * 0.5f, center + BENCHMARK_QUERY_SIZE * 0.5f }, results);
+				}
+				double rectUs = MsSince(start) * 1000.0 / BENCHMARK_QUERIES;
+				size_t rectResults = results.size();
+
+				results.clear();
+				start = std::chrono::high_resolution_clock::now();
+				for (glm::vec2 center : queryCenters)
+				{
+					index.QueryRadius(center, BENCHMARK_QUERY_SIZE * 0.5f, results);
+				}
+				double radiusUs = MsSince(start) * 1000.0 / BENCHMARK_QUERIES;
+
+				std::cout << "  " << name << ": insert " << insertMs << " ms, update " << updateMs << " ms per frame, rect query "
+					<< rectUs << " us (" << rectResults / BENCHMARK_QUERIES << " results), radius query " << radiusUs << " us ("
+					<< results.size() / BENCHMARK_QUERIES << " results)" << std::endl;
+			};
+
+		{
+			// Cells as large as the largest object, nothing goes to the oversized list
+			SpatialHashGrid grid{ 2.0f, 1 << 20 };
+			run(grid, "hash grid");
+		}
+		{
+			LooseQuadtree quadtree{ { glm::vec2{ -BENCHMARK_WORLD_HALF_SIZE }, glm::vec2{ BENCHMARK_WORLD_HALF_SIZE } } };
+			run(quadtree, "loose quadtree");
+		}
+
+		// Game objects reporting their moves, Sync only visits the ones that moved
+		{
+			GameObjectPool objects;
+			objects.Reserve(BENCHMARK_OBJECTS);
+			TransformChangeList changes;
+			SpatialHashGrid grid{ 2.0f, 1 << 20 };
+			for (uint32_t i = 0; i < BENCHMARK_OBJECTS; i++)
+			{
+				GameObject& object = *objects.Get(objects.CreateIndexed());
+				object.transform2d.SetTranslation(startBounds[i].Center());
+				object.transform2d.SetScale(startBounds[i].Size());
+				object.transform2d.Track(&changes, object.GetId());
+				grid.Insert(object);
+			}
+			changes.Clear();
+
+			const float dt = 1.0f / 60.0f;
+			double syncMs = 0.0;
+			for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++)
+			{
+				for (uint32_t i = 0; i < BENCHMARK_SYNC_MOVED; i++)
+				{
+					const Id id = static_cast<Id>(random() % BENCHMARK_OBJECTS);
+					Transform2dComponent& transform = objects[id].transform2d;
+					transform.SetTranslation(glm::clamp(transform.GetTranslation() + velocities[id] * dt,
+						glm::vec2{ -BENCHMARK_WORLD_HALF_SIZE }, glm::vec2{ BENCHMARK_WORLD_HALF_SIZE }));
+				}
+
+				auto start = std::chrono::high_resolution_clock::now();
+				grid.Sync(objects, changes);
+				syncMs += MsSince(start);
+				changes.Clear();
+			}
+
+			std::cout << "  hash grid sync, " << BENCHMARK_SYNC_MOVED << " objects moved per frame: "
+				<< syncMs / BENCHMARK_FRAMES << " ms per frame" << std::endl;
+		}
+
+		// What every query costs without an index
+		size_t bruteForceResults = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t query = 0; query < BENCHMARK_BRUTE_FORCE_QUERIES; query++)
+		{
+			glm::vec2 center = queryCenters[query];
+			Aabb2d rect{ center - BENCHMARK_QUERY_SIZE * 0.5f, center + BENCHMARK_QUERY_SIZE * 0.5f };
+			for (const Aabb2d& bounds : startBounds)
+			{
+				bruteForceResults += bounds.Intersects(rect) ? 1 : 0;
+			}
+		}
+		std::cout << "  linear scan: rect query " << MsSince(start) * 1000.0 / BENCHMARK_BRUTE_FORCE_QUERIES << " us ("
+			<< bruteForceResults / BENCHMARK_BRUTE_FORCE_QUERIES << " results)" << std::endl;
+	}
+}
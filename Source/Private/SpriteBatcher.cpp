@@ -0,0 +1,293 @@
+#include "../Public/SpriteBatcher.h"
+#include "../Public/Uploader.h"
+
+#include <stdexcept>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <string>
+
+namespace Application
+{
+	namespace
+	{
+		struct SpritePushConstantData
+		{
+			int32_t textureIndex;
+		};
+
+		constexpr uint32_t BENCHMARK_FRAMES = 20;
+		// Different textures in the benchmark scenes
+		constexpr uint32_t BENCHMARK_TEXTURES = 8;
+	}
+
+	SpriteBatcher::SpriteBatcher(Device& device, const RenderTargetInfo& target, BindlessDescriptors* bindless) :
+		device{device},
+		bindless{bindless},
+		vertexRing{ device, MAX_SPRITES_PER_FRAME * 4 * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT }
+	{
+		CreateIndexBuffer();
+		CreatePipelineLayout();
+		CreatePipelines(target);
+	}
+
+	SpriteBatcher::~SpriteBatcher()
+	{
+		// The index upload may still be in flight
+		device.GetUploader().DeferDestroy(indexUploadTicket, [vkDevice = device.GetDevice(), layout = pipelineLayout,
+			buffer = indexBuffer, memory = indexBufferMemory]()
+			{
+				vkDestroyPipelineLayout(vkDevice, layout, nullptr);
+				vkDestroyBuffer(vkDevice, buffer, nullptr);
+				vkFreeMemory(vkDevice, memory, nullptr);
+			});
+	}
+
+	std::vector<VkVertexInputBindingDescription> SpriteBatcher::Vertex::GetBindingDescriptions()
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(Vertex);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> SpriteBatcher::Vertex::GetAttributeDescriptions()
+	{
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(Vertex, position);
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
+		attributeDescriptions[1].offset = offsetof(Vertex, uv);
+		attributeDescriptions[2].location = 2;
+		attributeDescriptions[2].binding = 0;
+		attributeDescriptions[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributeDescriptions[2].offset = offsetof(Vertex, color);
+		return attributeDescriptions;
+	}
+
+	void SpriteBatcher::CreateIndexBuffer()
+	{
+		std::vector<uint32_t> indices(MAX_SPRITES_PER_FRAME * 6);
+		for (uint32_t sprite = 0; sprite < MAX_SPRITES_PER_FRAME; sprite++)
+		{
+			const uint32_t base = sprite * 4;
+			const uint32_t quad[] = { base, base + 1, base + 2, base + 2, base + 3, base };
+			memcpy(&indices[sprite * 6], quad, sizeof(quad));
+		}
+
+		VkDeviceSize bufferSize = sizeof(uint32_t) * indices.size();
+		device.CreateBuffer
+		(
+			bufferSize,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			indexBuffer,
+			indexBufferMemory
+		);
+
+		std::vector<uint8_t> data(static_cast<size_t>(bufferSize));
+		memcpy(data.data(), indices.data(), data.size());
+		indexUploadTicket = device.GetUploader().UploadBuffer(indexBuffer, 0, std::move(data),
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	}
+
+	void SpriteBatcher::CreatePipelineLayout()
+	{
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(SpritePushConstantData);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		VkDescriptorSetLayout setLayout = bindless ? bindless->GetSetLayout() : VK_NULL_HANDLE;
+		pipelineLayoutInfo.setLayoutCount = bindless ? 1 : 0;
+		pipelineLayoutInfo.pSetLayouts = bindless ? &setLayout : nullptr;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(device.GetDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create sprite pipeline layout");
+		}
+	}
+
+	void SpriteBatcher::CreatePipelines(const RenderTargetInfo& target)
+	{
+		PipelineConfigInfo pipelineConfig{};
+		Pipeline::DefaultPipelineConfigInfo(pipelineConfig);
+		Pipeline::SetRenderTarget(pipelineConfig, target);
+		pipelineConfig.bindingDescriptions = Vertex::GetBindingDescriptions();
+		pipelineConfig.attributeDescriptions = Vertex::GetAttributeDescriptions();
+		pipelineConfig.pipelineLayout = pipelineLayout;
+		// Painter's order, the last sprite drawn is on top
+		pipelineConfig.depthStencilInfo.depthTestEnable = VK_FALSE;
+		pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+		pipelineConfig.colorBlendAttachment.blendEnable = VK_TRUE;
+		pipelineConfig.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		pipelineConfig.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipelineConfig.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+
+		const std::string fragFilepath = bindless ?
+			"Resources/Shaders/SpriteBindless.frag.spv" : "Resources/Shaders/Sprite.frag.spv";
+
+		pipelineConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		pipelines[static_cast<size_t>(BlendMode::Alpha)] = std::make_unique<Pipeline>(
+			device, "Resources/Shaders/Sprite.vert.spv", fragFilepath, pipelineConfig);
+
+		pipelineConfig.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		pipelines[static_cast<size_t>(BlendMode::Additive)] = std::make_unique<Pipeline>(
+			device, "Resources/Shaders/Sprite.vert.spv", fragFilepath, pipelineConfig);
+	}
+
+	void SpriteBatcher::Begin(int frameIndex)
+	{
+		vertexRing.BeginFrame(frameIndex);
+		auto allocation = vertexRing.Allocate(MAX_SPRITES_PER_FRAME * 4 * sizeof(Vertex));
+		vertices = static_cast<Vertex*>(allocation.data);
+		vertexOffset = allocation.offset;
+		batches.clear();
+		stats = {};
+	}
+
+	uint32_t SpriteBatcher::PackColor(const glm::vec4& color)
+	{
+		glm::vec4 scaled = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+		return static_cast<uint32_t>(scaled.r) | static_cast<uint32_t>(scaled.g) << 8 |
+			static_cast<uint32_t>(scaled.b) << 16 | static_cast<uint32_t>(scaled.a) << 24;
+	}
+
+	void SpriteBatcher::WriteSprite(const Sprite& sprite, Vertex* quad)
+	{
+		// Rotated half extents, the corners are the center plus or minus both
+		const float c = std::cos(sprite.rotation);
+		const float s = std::sin(sprite.rotation);
+		const glm::vec2 axisX = glm::vec2{ c, s } * (sprite.size.x * 0.5f);
+		const glm::vec2 axisY = glm::vec2{ -s, c } * (sprite.size.y * 0.5f);
+		const uint32_t color = PackColor(sprite.color);
+
+		// Write combined memory, every field is written once and in order
+		quad[0] = { sprite.position - axisX - axisY, sprite.uvMin, color };
+		quad[1] = { sprite.position + axisX - axisY, { sprite.uvMax.x, sprite.uvMin.y }, color };
+		quad[2] = { sprite.position + axisX + axisY, sprite.uvMax, color };
+		quad[3] = { sprite.position - axisX + axisY, { sprite.uvMin.x, sprite.uvMax.y }, color };
+	}
+
+	void SpriteBatcher::Draw(const Sprite& sprite)
+	{
+		Draw(&sprite, 1);
+	}
+
+	void SpriteBatcher::Draw(const Sprite* sprites, size_t count)
+	{
+		assert(vertices != nullptr && "Cannot draw sprites before Begin");
+		if (stats.spriteCount + count > MAX_SPRITES_PER_FRAME)
+		{
+			throw std::runtime_error("Too many sprites in one frame, increase MAX_SPRITES_PER_FRAME");
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < count; i++)
+		{
+			const Sprite& sprite = sprites[i];
+			// Textures only matter with bindless, the batch only breaks when they do
+			uint32_t textureIndex = bindless ? sprite.textureIndex : BindlessDescriptors::INVALID_INDEX;
+			if (batches.empty() || batches.back().textureIndex != textureIndex || batches.back().blendMode != sprite.blendMode)
+			{
+				batches.push_back({ stats.spriteCount, 0, textureIndex, sprite.blendMode });
+			}
+			batches.back().spriteCount++;
+
+			WriteSprite(sprite, vertices + static_cast<size_t>(stats.spriteCount) * 4);
+			stats.spriteCount++;
+		}
+		stats.batchCount = static_cast<uint32_t>(batches.size());
+		stats.writeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void SpriteBatcher::Render(VkCommandBuffer commandBuffer)
+	{
+		if (batches.empty() || !device.GetUploader().IsAvailable(indexUploadTicket))
+		{
+			return;
+		}
+
+		VkBuffer buffers[] = { vertexRing.GetBuffer() };
+		VkDeviceSize offsets[] = { vertexOffset };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		BlendMode boundMode = BlendMode::Count;
+		for (const Batch& batch : batches)
+		{
+			if (batch.blendMode != boundMode)
+			{
+				pipelines[static_cast<size_t>(batch.blendMode)]->Bind(commandBuffer);
+				// Same layout for every pipeline, the set stays bound across pipeline changes
+				if (bindless && boundMode == BlendMode::Count)
+				{
+					bindless->Bind(commandBuffer, pipelineLayout);
+				}
+				boundMode = batch.blendMode;
+			}
+
+			SpritePushConstantData push{};
+			push.textureIndex = batch.textureIndex == BindlessDescriptors::INVALID_INDEX ?
+				-1 : static_cast<int32_t>(batch.textureIndex);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+				sizeof(SpritePushConstantData), &push);
+			vkCmdDrawIndexed(commandBuffer, batch.spriteCount * 6, 1, batch.firstSprite * 6, 0, 0);
+		}
+	}
+
+	void SpriteBatcher::RunBenchmark(Device& device, const RenderTargetInfo& target, BindlessDescriptors* bindless)
+	{
+		SpriteBatcher batcher{ device, target, bindless };
+		std::mt19937 random{ 42 };
+		std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+
+		std::cout << "Sprite batching, " << BENCHMARK_FRAMES << " frames"
+			<< (bindless ? "" : " (no bindless, textures don't break batches)") << std::endl;
+		for (uint32_t count : { 10'000u, 100'000u })
+		{
+			std::vector<Sprite> sprites(count);
+			for (auto& sprite : sprites)
+			{
+				sprite.position = { unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f };
+				sprite.size = glm::vec2{ 0.01f + unit(random) * 0.02f };
+				sprite.rotation = unit(random) * 6.2831853f;
+				sprite.color = { unit(random), unit(random), unit(random), 1.0f };
+			}
+
+			// Grouped by texture like a tile map or an atlas user, then one texture change per sprite
+			// as the worst case
+			for (bool interleaved : { false, true })
+			{
+				for (uint32_t i = 0; i < count; i++)
+				{
+					uint32_t texture = interleaved ? i % BENCHMARK_TEXTURES : i * BENCHMARK_TEXTURES / count;
+					sprites[i].textureIndex = texture;
+				}
+
+				double totalMs = 0.0;
+				for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++)
+				{
+					batcher.Begin(frame % SwapChain::MAX_FRAMES_IN_FLIGHT);
+					batcher.Draw(sprites.data(), sprites.size());
+					totalMs += batcher.GetStats().writeMs;
+				}
+
+				std::cout << "  " << count << " sprites, " << (interleaved ? "interleaved" : "grouped") << " textures: "
+					<< static_cast<uint64_t>(count * BENCHMARK_FRAMES / totalMs) << " sprites/ms, "
+					<< batcher.GetStats().batchCount << " batches" << std::endl;
+			}
+		}
+	}
+}
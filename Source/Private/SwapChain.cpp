@@ -2,7 +2,9 @@
 #include "../Public/Device.h"
 
 // std
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -13,28 +15,52 @@
 namespace Application
 {
 
-    SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent)
-        : device{ deviceRef }, windowExtent{ extent } 
+    SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, const SwapChainSettings& settings)
+        : device{ deviceRef }, windowExtent{ extent }, settings{ settings }
     {
         Init();
     }
 
-    SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, std::shared_ptr<SwapChain> previous)
-        : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{previous}
+    SwapChain::SwapChain(
+        Device& deviceRef,
+        VkExtent2D extent,
+        std::shared_ptr<SwapChain> previous,
+        const SwapChainSettings& settings)
+        : device{ deviceRef }, windowExtent{ extent }, settings{ settings }, oldSwapChain{previous}
     {
         Init();
 
-        // Clean up old swap chain
+        // The caller keeps the retired swap chain alive until its frames have drained
         oldSwapChain = nullptr;
     }
 
     void SwapChain::Init()
     {
+        settings.framesInFlight = std::clamp(settings.framesInFlight, 1u, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+
         CreateSwapChain();
         CreateImageViews();
-        CreateRenderPass();
+
+        // Dynamic rendering needs no render pass, pipelines only depend on the formats
+        const bool dynamicRendering = device.SupportsDynamicRendering();
+
+        // Same formats give a compatible render pass, pipelines built against it stay valid
+        swapChainDepthFormat = FindDepthFormat();
+        if (dynamicRendering)
+        {
+            renderPass = VK_NULL_HANDLE;
+        }
+        else if (oldSwapChain != nullptr && oldSwapChain->CompareSwapFormats(*this))
+        {
+            renderPass = oldSwapChain->renderPass;
+            oldSwapChain->renderPass = VK_NULL_HANDLE;
+        }
+        else
+        {
+            CreateRenderPass();
+        }
+
         CreateDepthResources();
-        CreateFramebuffers();
         CreateSyncObjects();
     }
 
@@ -52,37 +78,30 @@ namespace Application
             swapChain = nullptr;
         }
 
-        for (int i = 0; i < depthImages.size(); i++)
+        for (size_t i = 0; i < depthImages.size(); i++)
         {
             vkDestroyImageView(device.GetDevice(), depthImageViews[i], nullptr);
             vkDestroyImage(device.GetDevice(), depthImages[i], nullptr);
             vkFreeMemory(device.GetDevice(), depthImageMemorys[i], nullptr);
         }
 
-        for (auto framebuffer : swapChainFramebuffers)
+        if (renderPass != VK_NULL_HANDLE)
         {
-            vkDestroyFramebuffer(device.GetDevice(), framebuffer, nullptr);
+            vkDestroyRenderPass(device.GetDevice(), renderPass, nullptr);
         }
 
-        vkDestroyRenderPass(device.GetDevice(), renderPass, nullptr);
-
-        // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
+        // cleanup synchronization objects, empty if they were handed to the next swap chain
+        for (size_t i = 0; i < renderFinishedSemaphores.size(); i++) 
         {
             vkDestroySemaphore(device.GetDevice(), renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(device.GetDevice(), imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(device.GetDevice(), inFlightFences[i], nullptr);
         }
     }
 
     VkResult SwapChain::AcquireNextImage(uint32_t* imageIndex)
     {
-        vkWaitForFences(
-            device.GetDevice(),
-            1,
-            &inFlightFences[currentFrame],
-            VK_TRUE,
-            std::numeric_limits<uint64_t>::max());
+        // Only blocks when the GPU is more than MAX_FRAMES_IN_FLIGHT frames behind
+        device.WaitForFrame(inFlightFrames[currentFrame]);
 
         VkResult result = vkAcquireNextImageKHR(
             device.GetDevice(),
@@ -98,31 +117,52 @@ namespace Application
     VkResult SwapChain::SubmitCommandBuffers(
         const VkCommandBuffer* buffers, uint32_t* imageIndex) 
     {
-        if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
+        // Usually already complete, the wait is skipped without a driver call
+        if (!device.IsFrameComplete(imagesInFlight[*imageIndex]))
         {
-            vkWaitForFences(device.GetDevice(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+            device.WaitForFrame(imagesInFlight[*imageIndex]);
         }
-        imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+
+        const uint64_t frameValue = device.BeginFrameSubmission();
+        inFlightFrames[currentFrame] = frameValue;
+        imagesInFlight[*imageIndex] = frameValue;
 
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        // Work from other queues this frame consumes, then the acquired image
+        std::vector<VkSemaphore> waitSemaphores = { imageAvailableSemaphores[currentFrame] };
+        std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+        std::vector<uint64_t> waitValues = { 0 };
+        for (const auto& wait : device.TakeFrameWaits())
+        {
+            waitSemaphores.push_back(wait.semaphore);
+            waitStages.push_back(wait.stages);
+            waitValues.push_back(wait.value);
+        }
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
 
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
 
-        VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
+        // Binary semaphore for the presentation engine, timeline value for everything else
+        VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame], device.GetFrameTimeline() };
+        uint64_t signalValues[] = { 0, frameValue };
+        submitInfo.signalSemaphoreCount = 2;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        vkResetFences(device.GetDevice(), 1, &inFlightFences[currentFrame]);
-        if (vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-            VK_SUCCESS) 
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = 2;
+        timelineInfo.pSignalSemaphoreValues = signalValues;
+        submitInfo.pNext = &timelineInfo;
+
+        auto queueLock = device.LockQueueSubmission();
+        if (vkQueueSubmit(device.GetGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) 
         {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
@@ -131,7 +171,7 @@ namespace Application
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
         VkSwapchainKHR swapChains[] = { swapChain };
         presentInfo.swapchainCount = 1;
@@ -139,9 +179,25 @@ namespace Application
 
         presentInfo.pImageIndices = imageIndex;
 
+        VkPresentIdKHR presentId{};
+        if (waitForPresent != nullptr)
+        {
+            presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentId.swapchainCount = 1;
+            presentId.pPresentIds = &frameValue;
+            presentInfo.pNext = &presentId;
+
+            if (firstPresentId == 0)
+            {
+                firstPresentId = frameValue;
+            }
+            lastPresentId = frameValue;
+        }
+
         auto result = vkQueuePresentKHR(device.GetPresentQueue(), &presentInfo);
+        queueLock.unlock();
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % settings.framesInFlight;
 
         return result;
     }
@@ -150,7 +206,7 @@ namespace Application
         SwapChainSupportDetails swapChainSupport = device.GetSwapChainSupport();
 
         VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
+        presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities);
 
         uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -210,6 +266,47 @@ namespace Application
 
         swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
+
+        if (device.SupportsPresentWait())
+        {
+            waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+                vkGetDeviceProcAddr(device.GetDevice(), "vkWaitForPresentKHR"));
+        }
+
+        if (device.IsExtensionEnabled(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME))
+        {
+            auto getRefreshCycleDuration = reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>(
+                vkGetDeviceProcAddr(device.GetDevice(), "vkGetRefreshCycleDurationGOOGLE"));
+            VkRefreshCycleDurationGOOGLE refreshCycle{};
+            if (getRefreshCycleDuration != nullptr &&
+                getRefreshCycleDuration(device.GetDevice(), swapChain, &refreshCycle) == VK_SUCCESS)
+            {
+                refreshDurationNs = refreshCycle.refreshDuration;
+            }
+        }
+    }
+
+    bool SwapChain::WaitForPresent(uint32_t maxQueuedPresents, uint64_t timeoutNs)
+    {
+        if (waitForPresent == nullptr)
+        {
+            return false;
+        }
+
+        // Ids presented before this swap chain existed can't be waited on through it
+        if (lastPresentId < firstPresentId + maxQueuedPresents || firstPresentId == 0)
+        {
+            return true;
+        }
+
+        VkResult result = waitForPresent(device.GetDevice(), swapChain, lastPresentId - maxQueuedPresents, timeoutNs);
+        return result == VK_SUCCESS || result == VK_TIMEOUT;
+    }
+
+    VkResult SwapChain::PollPresent(uint64_t presentId)
+    {
+        assert(CanPollPresent(presentId) && "Present id not presented through this swap chain with present wait");
+        return waitForPresent(device.GetDevice(), swapChain, presentId, 0);
     }
 
     void SwapChain::CreateImageViews()
@@ -242,6 +339,7 @@ namespace Application
         depthAttachment.format = FindDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
         depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        // Depth is never read after the pass, nothing is written back to memory
         depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -272,11 +370,13 @@ namespace Application
         subpass.pColorAttachments = &colorAttachmentRef;
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+        // A frame slot's depth image is reused by the slot's next frame (also across swap chain
+        // recreation), the previous depth writes must be done before it is cleared again
         VkSubpassDependency dependency = {};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.srcAccessMask = 0;
-        dependency.srcStageMask =
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
         dependency.dstSubpass = 0;
         dependency.dstStageMask =
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
@@ -300,57 +400,51 @@ namespace Application
         }
     }
 
-    void SwapChain::CreateFramebuffers() 
-    {
-        swapChainFramebuffers.resize(GetImageCount());
-        for (size_t i = 0; i < GetImageCount(); i++)
-        {
-            std::array<VkImageView, 2> attachments = { swapChainImageViews[i], depthImageViews[i] };
-
-            VkExtent2D swapChainExtent = GetSwapChainExtent();
-            VkFramebufferCreateInfo framebufferInfo = {};
-            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-            framebufferInfo.pAttachments = attachments.data();
-            framebufferInfo.width = swapChainExtent.width;
-            framebufferInfo.height = swapChainExtent.height;
-            framebufferInfo.layers = 1;
-
-            if (vkCreateFramebuffer(
-                device.GetDevice(),
-                &framebufferInfo,
-                nullptr,
-                &swapChainFramebuffers[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create framebuffer!");
-            }
-        }
-    }
-
     void SwapChain::CreateDepthResources() 
     {
         VkFormat depthFormat = FindDepthFormat();
         swapChainDepthFormat = depthFormat;
         VkExtent2D swapChainExtent = GetSwapChainExtent();
 
-        depthImages.resize(GetImageCount());
-        depthImageMemorys.resize(GetImageCount());
-        depthImageViews.resize(GetImageCount());
+        // A framebuffer may be smaller than its attachments, when the window shrinks the previous
+        // depth images are kept instead of reallocated
+        depthExtent = swapChainExtent;
+        if (oldSwapChain != nullptr && oldSwapChain->swapChainDepthFormat == depthFormat &&
+            swapChainExtent.width <= oldSwapChain->depthExtent.width &&
+            swapChainExtent.height <= oldSwapChain->depthExtent.height)
+        {
+            depthExtent = oldSwapChain->depthExtent;
+            depthImages = std::move(oldSwapChain->depthImages);
+            depthImageMemorys = std::move(oldSwapChain->depthImageMemorys);
+            depthImageViews = std::move(oldSwapChain->depthImageViews);
+            oldSwapChain->depthImages.clear();
+            oldSwapChain->depthImageMemorys.clear();
+            oldSwapChain->depthImageViews.clear();
+        }
+
+        // Depth is cleared at the start of each frame and never read after it, a frame slot only
+        // needs its own image. Only create what is missing, frames in flight can grow.
+        size_t reusedCount = depthImages.size();
+        size_t depthImageCount = std::max(reusedCount, static_cast<size_t>(settings.framesInFlight));
+        depthImages.resize(depthImageCount);
+        depthImageMemorys.resize(depthImageCount);
+        depthImageViews.resize(depthImageCount);
 
-        for (int i = 0; i < depthImages.size(); i++)
+        for (size_t i = reusedCount; i < depthImages.size(); i++)
         {
             VkImageCreateInfo imageInfo{};
             imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
             imageInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageInfo.extent.width = swapChainExtent.width;
-            imageInfo.extent.height = swapChainExtent.height;
+            imageInfo.extent.width = depthExtent.width;
+            imageInfo.extent.height = depthExtent.height;
             imageInfo.extent.depth = 1;
             imageInfo.mipLevels = 1;
             imageInfo.arrayLayers = 1;
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            // Never leaves tile memory on tilers, lazily allocated memory may not even be backed
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
@@ -359,7 +453,8 @@ namespace Application
                 imageInfo,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 depthImages[i],
-                depthImageMemorys[i]);
+                depthImageMemorys[i],
+                VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
 
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -381,25 +476,36 @@ namespace Application
 
     void SwapChain::CreateSyncObjects() 
     {
+        imagesInFlight.resize(GetImageCount(), 0);
+
+        // Frame slots carry on where the previous swap chain stopped, the renderer's frame index
+        // and the timeline values of the frames still in flight stay valid
+        if (oldSwapChain != nullptr)
+        {
+            imageAvailableSemaphores = std::move(oldSwapChain->imageAvailableSemaphores);
+            renderFinishedSemaphores = std::move(oldSwapChain->renderFinishedSemaphores);
+            inFlightFrames = oldSwapChain->inFlightFrames;
+            // Slots dropped by a lower frames in flight count keep their values for when they come back
+            currentFrame = oldSwapChain->currentFrame % settings.framesInFlight;
+            oldSwapChain->imageAvailableSemaphores.clear();
+            oldSwapChain->renderFinishedSemaphores.clear();
+            return;
+        }
+
         imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
         renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(GetImageCount(), VK_NULL_HANDLE);
+        // Frame 0 is always complete, nothing to wait for on first use
+        inFlightFrames.resize(MAX_FRAMES_IN_FLIGHT, 0);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo = {};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) 
         {
             if (vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
                 VK_SUCCESS ||
                 vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-                VK_SUCCESS ||
-                vkCreateFence(device.GetDevice(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+                VK_SUCCESS)
             {
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
@@ -424,26 +530,49 @@ namespace Application
     VkPresentModeKHR SwapChain::ChooseSwapPresentMode(
         const std::vector<VkPresentModeKHR>& availablePresentModes) 
     {
-        for (const auto& availablePresentMode : availablePresentModes) 
+        std::vector<VkPresentModeKHR> preferredModes;
+        switch (settings.presentPolicy)
         {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) 
+        case PresentPolicy::LowestLatency:
+            preferredModes = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+            break;
+        case PresentPolicy::Uncapped:
+            preferredModes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+            break;
+        case PresentPolicy::Adaptive:
+            preferredModes = { VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+            break;
+        case PresentPolicy::VSync:
+            break;
+        }
+
+        for (VkPresentModeKHR preferredMode : preferredModes)
+        {
+            if (std::find(availablePresentModes.begin(), availablePresentModes.end(), preferredMode) !=
+                availablePresentModes.end())
             {
-                std::cout << "Present mode: Mailbox" << std::endl;
-                return availablePresentMode;
+                std::cout << "Present mode: " << (preferredMode == VK_PRESENT_MODE_MAILBOX_KHR ? "Mailbox" :
+                    preferredMode == VK_PRESENT_MODE_IMMEDIATE_KHR ? "Immediate" : "Adaptive V-Sync") << std::endl;
+                return preferredMode;
             }
         }
 
-        // for (const auto &availablePresentMode : availablePresentModes) {
-        //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-        //     std::cout << "Present mode: Immediate" << std::endl;
-        //     return availablePresentMode;
-        //   }
-        // }
-
         std::cout << "Present mode: V-Sync" << std::endl;
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
+    const char* SwapChain::GetPresentPolicyName(PresentPolicy policy)
+    {
+        switch (policy)
+        {
+        case PresentPolicy::LowestLatency: return "lowest latency";
+        case PresentPolicy::VSync: return "vsync";
+        case PresentPolicy::Uncapped: return "uncapped";
+        case PresentPolicy::Adaptive: return "adaptive";
+        }
+        return "unknown";
+    }
+
     VkExtent2D SwapChain::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) 
     {
         if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) 
@@ -0,0 +1,274 @@
+#include "../Public/Texture.h"
+#include "../Public/Uploader.h"
+
+// Universal (ETC1S / UASTC) textures need the Basis Universal transcoder, define
+// VULKOUCH_BASISU and add Dependencies\BASISU to the include paths to enable it
+#ifdef VULKOUCH_BASISU
+#include <basisu_transcoder.h>
+#endif
+
+#include <fstream>
+#include <stdexcept>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+namespace Application
+{
+	namespace
+	{
+		constexpr VkFormatFeatureFlags SAMPLED_FEATURES =
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+		// Transcode targets for universal textures, best quality per byte first. Color goes to the
+		// sRGB formats, linear data (normals, roughness, masks) to the UNORM ones.
+		const std::vector<VkFormat> UNIVERSAL_SRGB_TARGETS =
+		{
+			VK_FORMAT_BC7_SRGB_BLOCK,
+			VK_FORMAT_ASTC_4x4_SRGB_BLOCK,
+			VK_FORMAT_BC3_SRGB_BLOCK,
+			VK_FORMAT_R8G8B8A8_SRGB
+		};
+		const std::vector<VkFormat> UNIVERSAL_UNORM_TARGETS =
+		{
+			VK_FORMAT_BC7_UNORM_BLOCK,
+			VK_FORMAT_ASTC_4x4_UNORM_BLOCK,
+			VK_FORMAT_BC3_UNORM_BLOCK,
+			VK_FORMAT_R8G8B8A8_UNORM
+		};
+	}
+
+	Texture::Texture(Device& device, const std::string& filepath) : device{device}
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		Ktx2File file{ filepath };
+		format = ChooseUploadFormat(device, file);
+		width = file.GetWidth();
+		height = file.GetHeight();
+		mipLevels = file.GetLevelCount();
+
+		auto levels = file.GetUniversalFormat() != Ktx2File::UniversalFormat::None ?
+			TranscodeLevels(file) : LoadLevels(file);
+
+		CreateImage(levels);
+		CreateImageView();
+		CreateSampler();
+
+		auto end = std::chrono::high_resolution_clock::now();
+		std::cout << "Texture " << filepath << ": " << width << "x" << height << ", " << mipLevels
+			<< " mips, " << sizeInBytes / 1024 << " KiB, loaded in "
+			<< std::chrono::duration<float, std::milli>(end - start).count() << " ms" << std::endl;
+	}
+
+	Texture::~Texture()
+	{
+		// The transfer queue may still write the image
+		device.GetUploader().DeferDestroy(uploadTicket, [vkDevice = device.GetDevice(), sampler = sampler, imageView = imageView,
+			image = image, imageMemory = imageMemory]()
+			{
+				vkDestroySampler(vkDevice, sampler, nullptr);
+				vkDestroyImageView(vkDevice, imageView, nullptr);
+				vkDestroyImage(vkDevice, image, nullptr);
+				vkFreeMemory(vkDevice, imageMemory, nullptr);
+			});
+	}
+
+	bool Texture::IsReady() const
+	{
+		return device.GetUploader().IsAvailable(uploadTicket);
+	}
+
+	VkFormat Texture::ChooseUploadFormat(Device& device, const Ktx2File& file)
+	{
+		if (file.GetUniversalFormat() != Ktx2File::UniversalFormat::None)
+		{
+			for (VkFormat candidate : file.IsSrgb() ? UNIVERSAL_SRGB_TARGETS : UNIVERSAL_UNORM_TARGETS)
+			{
+				if (device.IsFormatSupported(candidate, VK_IMAGE_TILING_OPTIMAL, SAMPLED_FEATURES))
+				{
+					return candidate;
+				}
+			}
+			throw std::runtime_error("No transcode target supported for: " + file.GetPath());
+		}
+
+		if (device.IsFormatSupported(file.GetFormat(), VK_IMAGE_TILING_OPTIMAL, SAMPLED_FEATURES))
+		{
+			return file.GetFormat();
+		}
+		// BC formats missing on the device (mobile GPUs) fall back to plain RGBA8
+		if (Ktx2File::CanDecodeOnCpu(file.GetFormat()))
+		{
+			return Ktx2File::GetDecodedFormat(file.GetFormat());
+		}
+		throw std::runtime_error("Texture format not supported by the device: " + file.GetPath());
+	}
+
+	std::vector<std::vector<uint8_t>> Texture::LoadLevels(const Ktx2File& file)
+	{
+		std::vector<std::vector<uint8_t>> levels(mipLevels);
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			levels[level] = file.ReadLevel(level);
+			if (format != file.GetFormat())
+			{
+				levels[level] = Ktx2File::DecodeToRgba8(
+					file.GetFormat(), file.GetLevelWidth(level), file.GetLevelHeight(level), levels[level]);
+			}
+		}
+		return levels;
+	}
+
+	std::vector<std::vector<uint8_t>> Texture::TranscodeLevels(const Ktx2File& file)
+	{
+#ifdef VULKOUCH_BASISU
+		static bool transcoderInitialized = false;
+		if (!transcoderInitialized)
+		{
+			basist::basisu_transcoder_init();
+			transcoderInitialized = true;
+		}
+
+		// The basisu transcoder works on the whole container in memory
+		std::ifstream input{ file.GetPath(), std::ios::ate | std::ios::binary };
+		std::vector<char> container(static_cast<size_t>(input.tellg()));
+		input.seekg(0);
+		input.read(container.data(), container.size());
+		basist::ktx2_transcoder transcoder;
+		if (!transcoder.init(container.data(), static_cast<uint32_t>(container.size())) ||
+			!transcoder.start_transcoding())
+		{
+			throw std::runtime_error("Failed to start transcoding: " + file.GetPath());
+		}
+
+		basist::transcoder_texture_format target;
+		switch (format)
+		{
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK: target = basist::transcoder_texture_format::cTFBC7_RGBA; break;
+		case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+		case VK_FORMAT_ASTC_4x4_UNORM_BLOCK: target = basist::transcoder_texture_format::cTFASTC_4x4_RGBA; break;
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK: target = basist::transcoder_texture_format::cTFBC3_RGBA; break;
+		default: target = basist::transcoder_texture_format::cTFRGBA32; break;
+		}
+
+		std::vector<std::vector<uint8_t>> levels(mipLevels);
+		for (uint32_t level = 0; level < mipLevels; level++)
+		{
+			uint32_t levelWidth = file.GetLevelWidth(level);
+			uint32_t levelHeight = file.GetLevelHeight(level);
+			levels[level].resize(static_cast<size_t>(Ktx2File::GetLevelSize(format, levelWidth, levelHeight)));
+
+			// Output size is in blocks for compressed targets and in pixels for RGBA32
+			uint32_t outputSize = static_cast<uint32_t>(levels[level].size() / Ktx2File::GetBlockSize(format));
+			if (!transcoder.transcode_image_level(level, 0, 0, levels[level].data(), outputSize, target))
+			{
+				throw std::runtime_error("Failed to transcode texture: " + file.GetPath());
+			}
+		}
+		return levels;
+#else
+		throw std::runtime_error("Built without the Basis Universal transcoder, can't load: " + file.GetPath());
+#endif
+	}
+
+	void Texture::CreateImage(const std::vector<std::vector<uint8_t>>& levels)
+	{
+		// Level offsets are kept 16 byte aligned for block copies
+		VkDeviceSize dataSize = 0;
+		for (const auto& level : levels)
+		{
+			sizeInBytes += level.size();
+			dataSize += (level.size() + 15) & ~VkDeviceSize{ 15 };
+		}
+
+		// Every level goes through a single upload
+		std::vector<uint8_t> data(static_cast<size_t>(dataSize));
+		std::vector<VkBufferImageCopy> regions(levels.size());
+		VkDeviceSize offset = 0;
+		for (uint32_t level = 0; level < levels.size(); level++)
+		{
+			memcpy(data.data() + offset, levels[level].data(), levels[level].size());
+
+			regions[level] = {};
+			regions[level].bufferOffset = offset;
+			regions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			regions[level].imageSubresource.mipLevel = level;
+			regions[level].imageSubresource.baseArrayLayer = 0;
+			regions[level].imageSubresource.layerCount = 1;
+			regions[level].imageExtent =
+			{
+				width >> level ? width >> level : 1,
+				height >> level ? height >> level : 1,
+				1
+			};
+			offset += (levels[level].size() + 15) & ~VkDeviceSize{ 15 };
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { width, height, 1 };
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		device.CreateImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+		// Copied on the transfer queue, nothing waits for it here
+		uploadTicket = device.GetUploader().UploadImage(image, { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 },
+			std::move(data), std::move(regions), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	void Texture::CreateImageView()
+	{
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(device.GetDevice(), &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture image view");
+		}
+	}
+
+	void Texture::CreateSampler()
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.anisotropyEnable = VK_TRUE;
+		samplerInfo.maxAnisotropy = device.properties.limits.maxSamplerAnisotropy;
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+		samplerInfo.compareEnable = VK_FALSE;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = static_cast<float>(mipLevels);
+		samplerInfo.mipLodBias = 0.0f;
+
+		if (vkCreateSampler(device.GetDevice(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create texture sampler");
+		}
+	}
+}
@@ -0,0 +1,413 @@
+#include "../Public/TextureStreamer.h"
+#include "../Public/Texture.h"
+
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Application
+{
+	TextureStreamer::TextureStreamer(Device& device, VkDeviceSize memoryBudget) :
+		device{device}, memoryBudget{memoryBudget}
+	{
+		if (this->memoryBudget == 0)
+		{
+			this->memoryBudget = device.GetDeviceLocalMemoryBudget().budget / 4;
+		}
+		std::cout << "Texture streaming budget: " << this->memoryBudget / (1024 * 1024) << " MiB" << std::endl;
+
+		CreateSampler();
+		worker = std::thread{ &TextureStreamer::WorkerLoop, this };
+	}
+
+	TextureStreamer::~TextureStreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ queueMutex };
+			stopWorker = true;
+		}
+		queueCondition.notify_one();
+		worker.join();
+
+		for (auto& texture : textures)
+		{
+			device.DeferDestroy([vkDevice = device.GetDevice(), imageView = texture->imageView,
+				image = texture->image, imageMemory = texture->imageMemory]()
+				{
+					vkDestroyImageView(vkDevice, imageView, nullptr);
+					vkDestroyImage(vkDevice, image, nullptr);
+					vkFreeMemory(vkDevice, imageMemory, nullptr);
+				});
+		}
+		device.DeferDestroy([vkDevice = device.GetDevice(), sampler = sampler]()
+			{
+				vkDestroySampler(vkDevice, sampler, nullptr);
+			});
+	}
+
+	TextureStreamer::Handle TextureStreamer::Load(const std::string& filepath)
+	{
+		auto texture = std::make_unique<StreamedTexture>();
+		texture->file = std::make_unique<Ktx2File>(filepath);
+		if (texture->file->GetUniversalFormat() != Ktx2File::UniversalFormat::None)
+		{
+			throw std::runtime_error("Universal textures can't be streamed, load them with Texture: " + filepath);
+		}
+		texture->format = Texture::ChooseUploadFormat(device, *texture->file);
+
+		const uint32_t mipCount = texture->file->GetLevelCount();
+		texture->tailMip = mipCount - 1;
+		for (uint32_t level = 0; level < mipCount; level++)
+		{
+			if (std::max(texture->file->GetLevelWidth(level), texture->file->GetLevelHeight(level)) <= MIP_TAIL_SIZE)
+			{
+				texture->tailMip = level;
+				break;
+			}
+		}
+		texture->residentMip = mipCount;
+		texture->requestedMip = texture->tailMip;
+
+		// The mip tail is small, read it right away so the next Update uploads it with the streamed levels
+		texture->loadPending = true;
+		LoadResult tail{ 0, texture->tailMip, ReadLevels(*texture, texture->tailMip, mipCount - 1) };
+
+		// The worker reads from the texture list, don't reallocate it under its feet
+		std::lock_guard<std::mutex> lock{ queueMutex };
+		textures.push_back(std::move(texture));
+		const Handle handle = static_cast<Handle>(textures.size() - 1);
+		tail.handle = handle;
+		results.push_back(std::move(tail));
+		return handle;
+	}
+
+	void TextureStreamer::RequestSize(Handle handle, float screenWidth, float screenHeight)
+	{
+		auto& texture = *textures[handle];
+
+		float ratio = std::max(
+			texture.file->GetWidth() / std::max(screenWidth, 1.0f),
+			texture.file->GetHeight() / std::max(screenHeight, 1.0f));
+		uint32_t mip = ratio > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(ratio))) : 0;
+		mip = std::min(mip, texture.tailMip);
+
+		// Keep the most detailed request when the texture is drawn several times in a frame
+		if (texture.lastUsedFrame != currentFrame)
+		{
+			texture.requestedMip = mip;
+			texture.lastUsedFrame = currentFrame;
+		}
+		else
+		{
+			texture.requestedMip = std::min(texture.requestedMip, mip);
+		}
+	}
+
+	void TextureStreamer::Update(VkCommandBuffer commandBuffer)
+	{
+		std::vector<LoadResult> completed;
+		{
+			std::lock_guard<std::mutex> lock{ queueMutex };
+			completed.swap(results);
+		}
+
+		// Every level read since the last frame goes through one staging buffer, offsets are
+		// aligned for any texel block size
+		VkDeviceSize stagingSize = 0;
+		for (const auto& result : completed)
+		{
+			for (const auto& level : result.levels)
+			{
+				stagingSize += (level.size() + 15) & ~VkDeviceSize{ 15 };
+			}
+		}
+		VkBuffer stagingBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+		uint8_t* staging = nullptr;
+		if (stagingSize > 0)
+		{
+			device.CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				stagingBuffer, stagingBufferMemory);
+			vkMapMemory(device.GetDevice(), stagingBufferMemory, 0, stagingSize, 0, reinterpret_cast<void**>(&staging));
+		}
+
+		VkDeviceSize stagingOffset = 0;
+		for (const auto& result : completed)
+		{
+			auto& texture = *textures[result.handle];
+			texture.loadPending = false;
+
+			std::vector<VkBufferImageCopy> uploads;
+			for (uint32_t i = 0; i < result.levels.size(); i++)
+			{
+				const uint32_t level = result.firstMip + i;
+				memcpy(staging + stagingOffset, result.levels[i].data(), result.levels[i].size());
+
+				VkBufferImageCopy region{};
+				region.bufferOffset = stagingOffset;
+				region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+				region.imageExtent = { texture.file->GetLevelWidth(level), texture.file->GetLevelHeight(level), 1 };
+				uploads.push_back(region);
+				stagingOffset += (result.levels[i].size() + 15) & ~VkDeviceSize{ 15 };
+			}
+			Rebuild(commandBuffer, texture, result.firstMip, stagingBuffer, uploads);
+		}
+
+		if (stagingBuffer != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(device.GetDevice(), stagingBufferMemory);
+			device.DeferDestroy([vkDevice = device.GetDevice(), stagingBuffer, stagingBufferMemory]()
+				{
+					vkDestroyBuffer(vkDevice, stagingBuffer, nullptr);
+					vkFreeMemory(vkDevice, stagingBufferMemory, nullptr);
+				});
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ queueMutex };
+			for (Handle handle = 0; handle < textures.size(); handle++)
+			{
+				auto& texture = *textures[handle];
+				if (!texture.loadPending && texture.lastUsedFrame == currentFrame &&
+					texture.requestedMip < texture.residentMip)
+				{
+					requests.push_back({ handle, texture.requestedMip, texture.residentMip - 1 });
+					texture.loadPending = true;
+				}
+			}
+		}
+		queueCondition.notify_one();
+
+		EvictOverBudget(commandBuffer);
+		currentFrame++;
+	}
+
+	VkDescriptorImageInfo TextureStreamer::GetDescriptorInfo(Handle handle) const
+	{
+		return { sampler, textures[handle]->imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	}
+
+	void TextureStreamer::WorkerLoop()
+	{
+		while (true)
+		{
+			LoadRequest request;
+			const StreamedTexture* texture;
+			{
+				std::unique_lock<std::mutex> lock{ queueMutex };
+				queueCondition.wait(lock, [this] { return stopWorker || !requests.empty(); });
+				if (stopWorker)
+				{
+					return;
+				}
+				request = requests.front();
+				requests.pop_front();
+				// Textures are never removed so the pointer stays valid while reading
+				texture = textures[request.handle].get();
+			}
+
+			LoadResult result{ request.handle, request.firstMip, ReadLevels(*texture, request.firstMip, request.lastMip) };
+
+			std::lock_guard<std::mutex> lock{ queueMutex };
+			results.push_back(std::move(result));
+		}
+	}
+
+	std::vector<std::vector<uint8_t>> TextureStreamer::ReadLevels(
+		const StreamedTexture& texture, uint32_t firstMip, uint32_t lastMip)
+	{
+		std::vector<std::vector<uint8_t>> levels;
+		for (uint32_t level = firstMip; level <= lastMip; level++)
+		{
+			levels.push_back(texture.file->ReadLevel(level));
+			if (texture.format != texture.file->GetFormat())
+			{
+				levels.back() = Ktx2File::DecodeToRgba8(texture.file->GetFormat(),
+					texture.file->GetLevelWidth(level), texture.file->GetLevelHeight(level), levels.back());
+			}
+		}
+		return levels;
+	}
+
+	void TextureStreamer::EvictOverBudget(VkCommandBuffer commandBuffer)
+	{
+		std::vector<uint32_t> plannedMips(textures.size());
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			plannedMips[i] = textures[i]->residentMip;
+		}
+
+		VkDeviceSize plannedBytes = residentBytes;
+		while (plannedBytes > memoryBudget)
+		{
+			// Drop the top level of the least recently used texture that isn't needed this frame
+			size_t victim = textures.size();
+			for (size_t i = 0; i < textures.size(); i++)
+			{
+				const auto& texture = *textures[i];
+				if (plannedMips[i] < texture.tailMip && !texture.loadPending && texture.lastUsedFrame < currentFrame &&
+					(victim == textures.size() || texture.lastUsedFrame < textures[victim]->lastUsedFrame))
+				{
+					victim = i;
+				}
+			}
+
+			if (victim == textures.size())
+			{
+				// Everything resident is visible, nothing can go
+				break;
+			}
+			const auto& file = *textures[victim]->file;
+			plannedBytes -= Ktx2File::GetLevelSize(textures[victim]->format,
+				file.GetLevelWidth(plannedMips[victim]), file.GetLevelHeight(plannedMips[victim]));
+			plannedMips[victim]++;
+		}
+
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			if (plannedMips[i] != textures[i]->residentMip)
+			{
+				Rebuild(commandBuffer, *textures[i], plannedMips[i], VK_NULL_HANDLE, {});
+			}
+		}
+	}
+
+	void TextureStreamer::Rebuild(VkCommandBuffer commandBuffer, StreamedTexture& texture, uint32_t newResidentMip,
+		VkBuffer stagingBuffer, const std::vector<VkBufferImageCopy>& uploads)
+	{
+		const Ktx2File& file = *texture.file;
+		const uint32_t mipCount = file.GetLevelCount();
+		const uint32_t oldResidentMip = texture.residentMip;
+		const uint32_t newLevelCount = mipCount - newResidentMip;
+
+		VkImage image;
+		VkDeviceMemory imageMemory;
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = { file.GetLevelWidth(newResidentMip), file.GetLevelHeight(newResidentMip), 1 };
+		imageInfo.mipLevels = newLevelCount;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = texture.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		device.CreateImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+		std::vector<VkImageMemoryBarrier> barriers(1);
+		barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].image = image;
+		barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, newLevelCount, 0, 1 };
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[0].srcAccessMask = 0;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		if (texture.image != VK_NULL_HANDLE)
+		{
+			VkImageMemoryBarrier oldBarrier = barriers[0];
+			oldBarrier.image = texture.image;
+			oldBarrier.subresourceRange.levelCount = mipCount - oldResidentMip;
+			oldBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			oldBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			oldBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			oldBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barriers.push_back(oldBarrier);
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		// Levels that are both in the old and the new image are copied on the GPU
+		if (texture.image != VK_NULL_HANDLE)
+		{
+			std::vector<VkImageCopy> copies;
+			for (uint32_t level = std::max(newResidentMip, oldResidentMip); level < mipCount; level++)
+			{
+				VkImageCopy copy{};
+				copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - oldResidentMip, 0, 1 };
+				copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - newResidentMip, 0, 1 };
+				copy.extent = { file.GetLevelWidth(level), file.GetLevelHeight(level), 1 };
+				copies.push_back(copy);
+			}
+			vkCmdCopyImage(commandBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+		}
+		if (!uploads.empty())
+		{
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(uploads.size()), uploads.data());
+		}
+
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, barriers.data());
+
+		// Frames in flight may still sample the old image, it goes once they have retired
+		if (texture.image != VK_NULL_HANDLE)
+		{
+			device.DeferDestroy([vkDevice = device.GetDevice(), imageView = texture.imageView,
+				image = texture.image, imageMemory = texture.imageMemory]()
+				{
+					vkDestroyImageView(vkDevice, imageView, nullptr);
+					vkDestroyImage(vkDevice, image, nullptr);
+					vkFreeMemory(vkDevice, imageMemory, nullptr);
+				});
+		}
+
+		texture.image = image;
+		texture.imageMemory = imageMemory;
+		texture.residentMip = newResidentMip;
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = texture.format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, newLevelCount, 0, 1 };
+		if (vkCreateImageView(device.GetDevice(), &viewInfo, nullptr, &texture.imageView) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create streamed texture image view");
+		}
+
+		residentBytes -= texture.residentSize;
+		texture.residentSize = 0;
+		for (uint32_t level = newResidentMip; level < mipCount; level++)
+		{
+			texture.residentSize += Ktx2File::GetLevelSize(
+				texture.format, file.GetLevelWidth(level), file.GetLevelHeight(level));
+		}
+		residentBytes += texture.residentSize;
+	}
+
+	void TextureStreamer::CreateSampler()
+	{
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_LINEAR;
+		samplerInfo.minFilter = VK_FILTER_LINEAR;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.anisotropyEnable = VK_TRUE;
+		samplerInfo.maxAnisotropy = device.properties.limits.maxSamplerAnisotropy;
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.minLod = 0.0f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+		if (vkCreateSampler(device.GetDevice(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create streaming sampler");
+		}
+	}
+}
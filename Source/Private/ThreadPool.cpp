@@ -0,0 +1,110 @@
+#include "../Public/ThreadPool.h"
+
+#include <algorithm>
+
+namespace Application
+{
+	namespace
+	{
+		// Batches per thread, a few more than one so uneven batches even out
+		constexpr uint32_t BATCHES_PER_THREAD = 4;
+	}
+
+	ThreadPool::ThreadPool(uint32_t workerCount)
+	{
+		workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back(&ThreadPool::WorkerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		wakeCondition.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	uint32_t ThreadPool::DefaultWorkerCount()
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	void ThreadPool::ParallelFor(uint32_t count, uint32_t minBatch, const RangeFunction& function)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		const uint32_t threadCount = GetWorkerCount() + 1;
+		const uint32_t size = std::max(std::max(minBatch, 1u), (count + threadCount * BATCHES_PER_THREAD - 1) /
+			(threadCount * BATCHES_PER_THREAD));
+		if (workers.empty() || size >= count)
+		{
+			function(0, count);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			this->function = &function;
+			this->count = count;
+			batchSize = size;
+			batchCount = (count + size - 1) / size;
+			nextBatch.store(0, std::memory_order_relaxed);
+			activeWorkers = GetWorkerCount();
+			generation++;
+		}
+		wakeCondition.notify_all();
+
+		RunBatches();
+
+		// The loop's state belongs to this call until every worker is done with it
+		std::unique_lock<std::mutex> lock{ mutex };
+		doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+		this->function = nullptr;
+	}
+
+	void ThreadPool::RunBatches()
+	{
+		for (uint32_t batch = nextBatch.fetch_add(1); batch < batchCount; batch = nextBatch.fetch_add(1))
+		{
+			const uint32_t begin = batch * batchSize;
+			(*function)(begin, std::min(count, begin + batchSize));
+		}
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		uint64_t seenGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+				if (stopping)
+				{
+					return;
+				}
+				seenGeneration = generation;
+			}
+
+			RunBatches();
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (--activeWorkers == 0)
+			{
+				doneCondition.notify_one();
+			}
+		}
+	}
+}
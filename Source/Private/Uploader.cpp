@@ -0,0 +1,464 @@
+#include "../Public/Uploader.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <iterator>
+#include <algorithm>
+#include <iostream>
+
+namespace Application
+{
+	Uploader::Uploader(Device& device) : device{device}
+	{
+		sharedQueue = device.GetTransferQueue() == device.GetGraphicsQueue() ||
+			device.GetTransferQueue() == device.GetPresentQueue() ||
+			device.GetTransferQueue() == device.GetComputeQueue();
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device.GetTransferQueueFamily();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		if (vkCreateCommandPool(device.GetDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload command pool");
+		}
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		if (vkCreateSemaphore(device.GetDevice(), &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload timeline semaphore");
+		}
+
+		worker = std::thread{ &Uploader::WorkerLoop, this };
+	}
+
+	Uploader::~Uploader()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopWorker = true;
+		}
+		condition.notify_one();
+		worker.join();
+
+		if (submittedValue > 0)
+		{
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &submittedValue;
+			if (vkWaitSemaphores(device.GetDevice(), &waitInfo, UINT64_MAX) != VK_SUCCESS)
+			{
+				std::cerr << "Failed to wait for uploads before destroying them" << std::endl;
+			}
+		}
+		ReleaseCompletedBatches();
+
+		// The device destroys them after its own idle wait
+		for (PendingDestroy& pending : pendingDestroys)
+		{
+			device.DeferDestroy(std::move(pending.destroy));
+		}
+		pendingDestroys.clear();
+
+		vkDestroySemaphore(device.GetDevice(), timeline, nullptr);
+		vkDestroyCommandPool(device.GetDevice(), commandPool, nullptr);
+	}
+
+	Uploader::Ticket Uploader::UploadBuffer(
+		VkBuffer buffer,
+		VkDeviceSize offset,
+		std::vector<uint8_t>&& data,
+		VkPipelineStageFlags dstStages,
+		VkAccessFlags dstAccess)
+	{
+		Request request{};
+		request.buffer = buffer;
+		request.offset = offset;
+		request.data = std::move(data);
+		request.dstStages = dstStages;
+		request.dstAccess = dstAccess;
+		return Enqueue(std::move(request));
+	}
+
+	Uploader::Ticket Uploader::UploadImage(
+		VkImage image,
+		const VkImageSubresourceRange& range,
+		std::vector<uint8_t>&& data,
+		std::vector<VkBufferImageCopy>&& regions,
+		VkImageLayout finalLayout,
+		VkPipelineStageFlags dstStages,
+		VkAccessFlags dstAccess)
+	{
+		Request request{};
+		request.image = image;
+		request.range = range;
+		request.data = std::move(data);
+		request.regions = std::move(regions);
+		request.finalLayout = finalLayout;
+		request.dstStages = dstStages;
+		request.dstAccess = dstAccess;
+		return Enqueue(std::move(request));
+	}
+
+	Uploader::Ticket Uploader::Enqueue(Request&& request)
+	{
+		assert(!request.data.empty() && "Nothing to upload");
+		Ticket ticket;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			ticket = nextTicket++;
+			request.ticket = ticket;
+			requests.push_back(std::move(request));
+		}
+		condition.notify_one();
+		return ticket;
+	}
+
+	void Uploader::AcquireCompleted(VkCommandBuffer commandBuffer)
+	{
+		uint64_t completedValue = 0;
+		vkGetSemaphoreCounterValue(device.GetDevice(), timeline, &completedValue);
+
+		std::vector<PendingAcquire> ready;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			while (!pendingAcquires.empty() && pendingAcquires.front().timelineValue <= completedValue)
+			{
+				ready.push_back(std::move(pendingAcquires.front()));
+				pendingAcquires.pop_front();
+			}
+		}
+		if (ready.empty())
+		{
+			return;
+		}
+
+		VkPipelineStageFlags dstStages = 0;
+		uint64_t waitValue = 0;
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		for (auto& acquire : ready)
+		{
+			if (!acquire.error.empty())
+			{
+				std::cerr << "Uploads " << acquire.firstTicket << " to " << acquire.lastTicket << " failed: "
+					<< acquire.error << std::endl;
+				failures.push_back({ acquire.firstTicket, acquire.lastTicket, std::move(acquire.error) });
+				continue;
+			}
+			dstStages |= acquire.dstStages;
+			waitValue = acquire.timelineValue;
+			bufferBarriers.insert(bufferBarriers.end(), acquire.bufferBarriers.begin(), acquire.bufferBarriers.end());
+			imageBarriers.insert(imageBarriers.end(), acquire.imageBarriers.begin(), acquire.imageBarriers.end());
+		}
+
+		// The semaphore wait is already satisfied, it orders the acquire after the release
+		// without stalling the frame
+		if (waitValue > 0)
+		{
+			device.AddFrameWait(timeline, waitValue, dstStages);
+		}
+		if (!bufferBarriers.empty() || !imageBarriers.empty())
+		{
+			vkCmdPipelineBarrier(commandBuffer, dstStages, dstStages, 0,
+				0, nullptr,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+		}
+		availableTicket = ready.back().lastTicket;
+
+		// This frame waits for the uploads it acquired, once it retires the transfer queue is
+		// done with their resources too
+		auto done = std::partition(pendingDestroys.begin(), pendingDestroys.end(),
+			[this](const PendingDestroy& pending) { return pending.ticket > availableTicket; });
+		for (auto it = done; it != pendingDestroys.end(); ++it)
+		{
+			device.DeferDestroy(std::move(it->destroy));
+		}
+		pendingDestroys.erase(done, pendingDestroys.end());
+	}
+
+	const std::string* Uploader::GetError(Ticket ticket) const
+	{
+		for (const Failure& failure : failures)
+		{
+			if (ticket >= failure.firstTicket && ticket <= failure.lastTicket)
+			{
+				return &failure.error;
+			}
+		}
+		return nullptr;
+	}
+
+	void Uploader::DeferDestroy(Ticket ticket, std::function<void()>&& destroy)
+	{
+		if (ticket <= availableTicket)
+		{
+			device.DeferDestroy(std::move(destroy));
+			return;
+		}
+		pendingDestroys.push_back({ ticket, std::move(destroy) });
+	}
+
+	void Uploader::WorkerLoop()
+	{
+		while (true)
+		{
+			std::vector<Request> work;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				condition.wait(lock, [this] { return stopWorker || !requests.empty(); });
+				if (stopWorker)
+				{
+					return;
+				}
+				// Everything queued so far goes in one submission
+				work.assign(std::make_move_iterator(requests.begin()), std::make_move_iterator(requests.end()));
+				requests.clear();
+			}
+
+			ReleaseCompletedBatches();
+
+			// Reported through the tickets, the render thread finds out in AcquireCompleted
+			Batch batch{};
+			try
+			{
+				Submit(work, batch);
+			}
+			catch (const std::exception& exception)
+			{
+				DestroyBatch(batch);
+
+				PendingAcquire failed{};
+				failed.timelineValue = submittedValue;
+				failed.firstTicket = work.front().ticket;
+				failed.lastTicket = work.back().ticket;
+				failed.error = exception.what();
+				std::lock_guard<std::mutex> lock{ mutex };
+				pendingAcquires.push_back(std::move(failed));
+			}
+		}
+	}
+
+	void Uploader::Submit(std::vector<Request>& work, Batch& batch)
+	{
+		// Offsets aligned for any texel block size
+		VkDeviceSize stagingSize = 0;
+		for (const auto& request : work)
+		{
+			stagingSize += (request.data.size() + 15) & ~VkDeviceSize{ 15 };
+		}
+
+		device.CreateBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			batch.stagingBuffer, batch.stagingMemory);
+
+		uint8_t* mapped;
+		if (vkMapMemory(device.GetDevice(), batch.stagingMemory, 0, stagingSize, 0, reinterpret_cast<void**>(&mapped)) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to map upload staging memory");
+		}
+		std::vector<VkDeviceSize> stagingOffsets;
+		VkDeviceSize stagingOffset = 0;
+		for (const auto& request : work)
+		{
+			memcpy(mapped + stagingOffset, request.data.data(), request.data.size());
+			stagingOffsets.push_back(stagingOffset);
+			stagingOffset += (request.data.size() + 15) & ~VkDeviceSize{ 15 };
+		}
+		vkUnmapMemory(device.GetDevice(), batch.stagingMemory);
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = commandPool;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device.GetDevice(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate upload command buffer");
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+		std::vector<VkImageMemoryBarrier> transferBarriers;
+		for (const auto& request : work)
+		{
+			if (request.image != VK_NULL_HANDLE)
+			{
+				VkImageMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = request.image;
+				barrier.subresourceRange = request.range;
+				transferBarriers.push_back(barrier);
+			}
+		}
+		if (!transferBarriers.empty())
+		{
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(transferBarriers.size()), transferBarriers.data());
+		}
+
+		for (size_t i = 0; i < work.size(); i++)
+		{
+			const Request& request = work[i];
+			if (request.image != VK_NULL_HANDLE)
+			{
+				std::vector<VkBufferImageCopy> regions = request.regions;
+				for (auto& region : regions)
+				{
+					region.bufferOffset += stagingOffsets[i];
+				}
+				vkCmdCopyBufferToImage(batch.commandBuffer, batch.stagingBuffer, request.image,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+			}
+			else
+			{
+				VkBufferCopy copy{ stagingOffsets[i], request.offset, request.data.size() };
+				vkCmdCopyBuffer(batch.commandBuffer, batch.stagingBuffer, request.buffer, 1, &copy);
+			}
+		}
+
+		// Release to the graphics family (or only the layout change without a dedicated family),
+		// the acquire half is the same barrier recorded on the graphics queue
+		const bool dedicated = device.HasDedicatedTransferQueue();
+		const uint32_t srcFamily = dedicated ? device.GetTransferQueueFamily() : VK_QUEUE_FAMILY_IGNORED;
+		const uint32_t dstFamily = dedicated ? device.GetGraphicsQueueFamily() : VK_QUEUE_FAMILY_IGNORED;
+
+		PendingAcquire acquire{};
+		std::vector<VkBufferMemoryBarrier> releaseBuffers;
+		std::vector<VkImageMemoryBarrier> releaseImages;
+		for (size_t i = 0; i < work.size(); i++)
+		{
+			const Request& request = work[i];
+			acquire.dstStages |= request.dstStages;
+			if (request.image != VK_NULL_HANDLE)
+			{
+				VkImageMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = 0;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = request.finalLayout;
+				barrier.srcQueueFamilyIndex = srcFamily;
+				barrier.dstQueueFamilyIndex = dstFamily;
+				barrier.image = request.image;
+				barrier.subresourceRange = request.range;
+				releaseImages.push_back(barrier);
+
+				if (dedicated)
+				{
+					barrier.srcAccessMask = 0;
+					barrier.dstAccessMask = request.dstAccess;
+					acquire.imageBarriers.push_back(barrier);
+				}
+			}
+			else if (dedicated)
+			{
+				// Without a family change the semaphore alone makes the copy visible
+				VkBufferMemoryBarrier barrier{};
+				barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = 0;
+				barrier.srcQueueFamilyIndex = srcFamily;
+				barrier.dstQueueFamilyIndex = dstFamily;
+				barrier.buffer = request.buffer;
+				barrier.offset = request.offset;
+				barrier.size = request.data.size();
+				releaseBuffers.push_back(barrier);
+
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = request.dstAccess;
+				acquire.bufferBarriers.push_back(barrier);
+			}
+		}
+		if (!releaseBuffers.empty() || !releaseImages.empty())
+		{
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr,
+				static_cast<uint32_t>(releaseBuffers.size()), releaseBuffers.data(),
+				static_cast<uint32_t>(releaseImages.size()), releaseImages.data());
+		}
+		if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record uploads");
+		}
+
+		// Only counted once submitted, the destructor waits for submittedValue
+		batch.timelineValue = submittedValue + 1;
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &batch.timelineValue;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &timeline;
+
+		{
+			std::unique_lock<std::mutex> queueLock;
+			if (sharedQueue)
+			{
+				queueLock = device.LockQueueSubmission();
+			}
+			if (vkQueueSubmit(device.GetTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to submit uploads");
+			}
+		}
+		submittedValue = batch.timelineValue;
+
+		acquire.timelineValue = batch.timelineValue;
+		acquire.firstTicket = work.front().ticket;
+		acquire.lastTicket = work.back().ticket;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			pendingAcquires.push_back(std::move(acquire));
+		}
+		batches.push_back(batch);
+	}
+
+	void Uploader::ReleaseCompletedBatches()
+	{
+		uint64_t completedValue = 0;
+		vkGetSemaphoreCounterValue(device.GetDevice(), timeline, &completedValue);
+		while (!batches.empty() && batches.front().timelineValue <= completedValue)
+		{
+			DestroyBatch(batches.front());
+			batches.pop_front();
+		}
+	}
+
+	void Uploader::DestroyBatch(const Batch& batch)
+	{
+		if (batch.commandBuffer != VK_NULL_HANDLE)
+		{
+			vkFreeCommandBuffers(device.GetDevice(), commandPool, 1, &batch.commandBuffer);
+		}
+		vkDestroyBuffer(device.GetDevice(), batch.stagingBuffer, nullptr);
+		vkFreeMemory(device.GetDevice(), batch.stagingMemory, nullptr);
+	}
+}
@@ -25,6 +25,12 @@ namespace Application
 		window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
 		glfwSetWindowUserPointer(window, this);
 		glfwSetFramebufferSizeCallback(window, FrameBufferResizeCallback);
+		glfwSetKeyCallback(window, KeyCallback);
+	}
+
+	bool Window::ConsumeKeyPress(int key)
+	{
+		return pressedKeys.erase(key) > 0;
 	}
 
 	void Window::CreateWindowSurface(VkInstance instance, VkSurfaceKHR* surface)
@@ -42,4 +48,13 @@ namespace Application
 		window->width = width;
 		window->height = height;
 	}
+
+	void Window::KeyCallback(GLFWwindow* glfwWindow, int key, int scancode, int action, int mods)
+	{
+		if (action == GLFW_PRESS)
+		{
+			auto window = reinterpret_cast<Window*>(glfwGetWindowUserPointer(glfwWindow));
+			window->pressedKeys.insert(key);
+		}
+	}
 }
@@ -3,14 +3,23 @@
 #include <stdexcept>
 #include <cstdlib>
 #include <iostream>
+#include <string>
 
-int main()
+int main(int argc, char* argv[])
 {
 	Application::App app{};
 
 	try
 	{
-		app.Run();
+		// --bench [name] runs the benchmarks instead of the app, all of them without a name
+		if (argc > 1 && std::string{ argv[1] } == "--bench")
+		{
+			app.RunBenchmarks(argc > 2 ? argv[2] : "");
+		}
+		else
+		{
+			app.Run();
+		}
 	}
 	catch (const std::exception& e)
 	{
@@ -3,8 +3,17 @@
 #include "Device.h"
 #include "Renderer.h"
 #include "GameObject.h"
+#include "BindlessDescriptors.h"
+#include "FramePacer.h"
+#include "SpriteBatcher.h"
+#include "SpatialIndex.h"
+#include "SceneHierarchy.h"
+#include "InstanceBuffer.h"
+#include "MeshImporter.h"
+#include "TextureStreamer.h"
 
 #include <memory>
+#include <string>
 
 namespace Application
 {
@@ -19,14 +28,58 @@ namespace Application
 
 		static constexpr int WIDTH = 800;
 		static constexpr int HEIGHT = 600;
+		// Frame rate of the limiter toggled with L
+		static constexpr double TARGET_FRAME_RATE = 60.0;
+		static constexpr uint32_t PARTICLE_COUNT = 100'000;
+		static constexpr uint32_t MAX_GAME_OBJECTS = 65'536;
+		// Loaded instead of the built-in scene when present
+		static constexpr const char* SCENE_PATH = "Resources/Scenes/Default.scene";
+		// Every .obj, .gltf and .glb in it is imported and shown along the bottom of the screen
+		static constexpr const char* MESH_DIRECTORY = "Resources/Meshes";
+		// Every .ktx2 in it is streamed and shown along the top of the screen with the sprites
+		static constexpr const char* TEXTURE_DIRECTORY = "Resources/Textures";
+		// Side of the streamed texture sprites, in clip space units
+		static constexpr float STREAMED_SPRITE_SIZE = 0.3f;
+		// Every model lives in the [-0.5, 0.5] model square, snorm16 positions cover it
+		static constexpr Model::VertexLayout VERTEX_LAYOUT = Model::VertexLayout::Compact();
 
 		void Run();
+		// Empty name runs every benchmark
+		void RunBenchmarks(const std::string& name);
 	private:
 		void LoadGameObjects();
+		void ImportMeshes();
+		void StreamTextures();
+		// Asks for the mips the streamed textures need on screen, streams them and draws them
+		// when visible
+		void UpdateStreamedTextures(VkCommandBuffer commandBuffer, SpriteBatcher& spriteBatcher, bool visible);
+		void HandleSwapChainSettingsKeys();
+		void DrawSpriteDemo(SpriteBatcher& spriteBatcher, float time);
 
 		Window window{ WIDTH, HEIGHT, "Jen fentre" };
 		Device device{ window };
 		Renderer renderer{ device, window };
-		std::vector<GameObject> gameObjects;
+		FramePacer framePacer;
+		RenderGraph renderGraph{ device };
+		std::unique_ptr<BindlessDescriptors> bindless;
+		TextureStreamer textureStreamer{ device };
+
+		struct StreamedSprite
+		{
+			TextureStreamer::Handle handle;
+			uint32_t textureIndex = BindlessDescriptors::INVALID_INDEX;
+			VkImageView imageView = VK_NULL_HANDLE;
+		};
+		std::vector<StreamedSprite> streamedSprites;
+		ModelPool models;
+		// After the models, its workers stop before the pool goes away
+		MeshImporter meshImporter{ device, models, VERTEX_LAYOUT };
+		// Before the objects, their transforms report changes to it until they are destroyed
+		InstanceBuffer instanceBuffer{ device, MAX_GAME_OBJECTS };
+		GameObjectPool gameObjects;
+		// Parent / child transforms of the objects attached to it
+		SceneHierarchy sceneHierarchy;
+		// Cells about the size of the objects, in clip space units
+		SpatialHashGrid spatialIndex{ 0.5f };
 	};
 }
\ No newline at end of file
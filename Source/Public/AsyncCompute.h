@@ -0,0 +1,58 @@
+#pragma once
+#include "Device.h"
+#include "SwapChain.h"
+
+#include <array>
+#include <mutex>
+
+namespace Application
+{
+	// Records and submits compute work on the compute queue, next to the graphics queue when
+	// the device has a compute only family and on another graphics queue otherwise. Work is
+	// ordered against the frames with timeline semaphores only: compute waits for the graphics
+	// frame that last used its buffers and the frame using the results waits for the compute
+	// value at the stage that reads them, neither side waits on the CPU.
+	//
+	// Buffers shared by both queues are created with concurrent sharing over
+	// Device::GetGraphicsComputeFamilies(), so no ownership transfer is needed.
+	class AsyncCompute
+	{
+	public:
+		AsyncCompute(Device& device);
+		~AsyncCompute();
+
+		AsyncCompute(const AsyncCompute&) = delete;
+		AsyncCompute& operator=(const AsyncCompute&) = delete;
+
+		// Command buffer of the frame slot, ready to record. Blocks only if the slot's previous
+		// compute submission is still running.
+		VkCommandBuffer Begin(int frameIndex);
+		// Submits the recorded commands once graphics frame waitFrame has completed (0 to not
+		// wait) and returns the compute value they signal. The frame being recorded can't be
+		// waited for, it would wait for this submission in turn.
+		uint64_t Submit(VkCommandBuffer commandBuffer, uint64_t waitFrame = 0);
+		// The next frame submission waits for value before running stages
+		void WaitInFrame(uint64_t value, VkPipelineStageFlags stages)
+		{
+			device.AddFrameWait(timeline, value, stages);
+		}
+
+		bool IsComplete(uint64_t value);
+		void Wait(uint64_t value);
+		uint64_t GetSubmittedValue() const { return submittedValue; }
+		VkSemaphore GetTimeline() { return timeline; }
+		bool IsAsync() const { return device.HasAsyncComputeFamily(); }
+
+	private:
+		Device& device;
+		VkCommandPool commandPool;
+		std::array<VkCommandBuffer, SwapChain::MAX_FRAMES_IN_FLIGHT> commandBuffers;
+		std::array<uint64_t, SwapChain::MAX_FRAMES_IN_FLIGHT> slotValues{};
+		VkSemaphore timeline;
+		int recordingSlot = -1;
+		uint64_t submittedValue = 0;
+		uint64_t completedValueCache = 0;
+		// Queue shared with another role, submits take the device queue lock
+		bool sharedQueue;
+	};
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Device.h"
+#include "SwapChain.h"
+
+#include <vector>
+#include <utility>
+
+namespace Application
+{
+	// One global descriptor set holding every texture and storage buffer in large partially
+	// bound arrays. Objects reference resources by index (push constants or SSBO) so draws
+	// using different textures don't need their own descriptor set.
+	class BindlessDescriptors
+	{
+	public:
+		static constexpr uint32_t TEXTURE_BINDING = 0;
+		static constexpr uint32_t STORAGE_BUFFER_BINDING = 1;
+		static constexpr uint32_t MAX_TEXTURES = 16384;
+		static constexpr uint32_t MAX_STORAGE_BUFFERS = 4096;
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		BindlessDescriptors(Device& device);
+		~BindlessDescriptors();
+
+		BindlessDescriptors(const BindlessDescriptors&) = delete;
+		BindlessDescriptors& operator=(const BindlessDescriptors&) = delete;
+
+		VkDescriptorSetLayout GetSetLayout() const { return setLayout; }
+		VkDescriptorSet GetDescriptorSet() const { return descriptorSet; }
+
+		// Descriptors can be written while the set is bound (update after bind)
+		uint32_t AddTexture(const VkDescriptorImageInfo& imageInfo);
+		void UpdateTexture(uint32_t index, const VkDescriptorImageInfo& imageInfo);
+		void RemoveTexture(uint32_t index);
+
+		uint32_t AddStorageBuffer(const VkDescriptorBufferInfo& bufferInfo);
+		void UpdateStorageBuffer(uint32_t index, const VkDescriptorBufferInfo& bufferInfo);
+		void RemoveStorageBuffer(uint32_t index);
+
+		// Removed slots may still be read by in-flight frames, they are recycled here once the
+		// device frame timeline has passed the frame that removed them
+		void NextFrame();
+
+		void Bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout,
+			VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+	private:
+		struct SlotAllocator
+		{
+			uint32_t capacity = 0;
+			uint32_t next = 0;
+			std::vector<uint32_t> freeSlots;
+			std::vector<std::pair<uint32_t, uint64_t>> retiredSlots;
+
+			uint32_t Allocate();
+		};
+
+		void CreateSetLayout();
+		void CreatePool();
+		void AllocateSet();
+
+		Device& device;
+		VkDescriptorSetLayout setLayout;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet descriptorSet;
+
+		SlotAllocator textureSlots;
+		SlotAllocator bufferSlots;
+	};
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "Device.h"
+#include "SwapChain.h"
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+
+namespace Application
+{
+	// Descriptor set layouts deduplicated by their binding signature
+	class DescriptorLayoutCache
+	{
+	public:
+		DescriptorLayoutCache(Device& device) : device{device} {}
+		~DescriptorLayoutCache();
+
+		DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+		DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+
+		VkDescriptorSetLayout GetLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+
+	private:
+		struct LayoutKey
+		{
+			std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+			bool operator==(const LayoutKey& other) const;
+		};
+
+		struct LayoutKeyHash
+		{
+			size_t operator()(const LayoutKey& key) const;
+		};
+
+		Device& device;
+		std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutKeyHash> layouts;
+	};
+
+	// Hands out descriptor sets from pools that grow on demand. Persistent sets live as long
+	// as the allocator, transient sets are only valid for the frame they were allocated in
+	// and are all released together by resetting that frame's pools.
+	class DescriptorAllocator
+	{
+	public:
+		DescriptorAllocator(Device& device);
+		~DescriptorAllocator();
+
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+		VkDescriptorSetLayout GetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+		{
+			return layoutCache.GetLayout(bindings);
+		}
+
+		VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+		VkDescriptorSet AllocateTransient(VkDescriptorSetLayout layout);
+
+		// Reset the pools of frameIndex, only call once that frame's submission has completed
+		void BeginFrame(int frameIndex);
+
+	private:
+		struct PoolList
+		{
+			VkDescriptorPool current = VK_NULL_HANDLE;
+			std::vector<VkDescriptorPool> used;
+			std::vector<VkDescriptorPool> available;
+			uint32_t nextPoolSize = 64;
+		};
+
+		VkDescriptorSet AllocateFrom(PoolList& pools, VkDescriptorSetLayout layout);
+		VkDescriptorPool GrabPool(PoolList& pools);
+		void DestroyPools(PoolList& pools);
+
+		static constexpr uint32_t MAX_POOL_SIZE = 4096;
+
+		Device& device;
+		DescriptorLayoutCache layoutCache;
+		PoolList persistentPools;
+		std::array<PoolList, SwapChain::MAX_FRAMES_IN_FLIGHT> framePools;
+		int currentFrame = 0;
+	};
+
+	// Small helper to fill a set with one vkUpdateDescriptorSets call
+	class DescriptorWriter
+	{
+	public:
+		DescriptorWriter& WriteBuffer(uint32_t binding, VkDescriptorType type, const VkDescriptorBufferInfo& bufferInfo);
+		DescriptorWriter& WriteImage(uint32_t binding, VkDescriptorType type, const VkDescriptorImageInfo& imageInfo);
+		void Update(Device& device, VkDescriptorSet set);
+
+	private:
+		// Info pointers are patched in Update, the vectors may reallocate while writing
+		std::vector<VkDescriptorBufferInfo> bufferInfos;
+		std::vector<VkDescriptorImageInfo> imageInfos;
+		std::vector<VkWriteDescriptorSet> writes;
+		std::vector<size_t> infoIndices;
+	};
+}
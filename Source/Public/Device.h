@@ -4,6 +4,11 @@
 // std lib headers
 #include <string>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <memory>
 
 namespace Application {
 
@@ -18,8 +23,14 @@ namespace Application {
     {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        // Transfer only family when the device has one, the graphics family is used otherwise
+        uint32_t transferFamily;
+        // Compute without graphics, the graphics family is used otherwise
+        uint32_t computeFamily;
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
+        bool transferFamilyHasValue = false;
+        bool computeFamilyHasValue = false;
 
         bool IsComplete() 
         {
@@ -27,6 +38,14 @@ namespace Application {
         }
     };
 
+    struct MemoryBudget
+    {
+        VkDeviceSize budget;
+        VkDeviceSize usage;
+    };
+
+    class Uploader;
+
     class Device {
     public:
 #ifdef NDEBUG
@@ -46,34 +65,114 @@ namespace Application {
 
         VkCommandPool GetCommandPool() { return commandPool; }
         VkDevice GetDevice() { return device; }
+        VkPhysicalDevice GetPhysicalDevice() { return physicalDevice; }
         VkSurfaceKHR GetSurface() { return surface; }
         VkQueue GetGraphicsQueue() { return graphicsQueue; }
         VkQueue GetPresentQueue() { return presentQueue; }
+        // A second graphics queue or the graphics queue itself when there is no transfer only family
+        VkQueue GetTransferQueue() { return transferQueue; }
+        // Another graphics queue or the graphics queue itself when there is no compute only family
+        VkQueue GetComputeQueue() { return computeQueue; }
+        uint32_t GetGraphicsQueueFamily() const { return graphicsFamily; }
+        uint32_t GetTransferQueueFamily() const { return transferFamily; }
+        uint32_t GetComputeQueueFamily() const { return computeFamily; }
+        bool HasAsyncComputeFamily() const { return computeFamily != graphicsFamily; }
+        // Families a buffer written by compute and read by graphics is shared between, with
+        // concurrent sharing when there are two no ownership transfer is needed
+        std::vector<uint32_t> GetGraphicsComputeFamilies() const
+        {
+            return HasAsyncComputeFamily() ? std::vector<uint32_t>{ graphicsFamily, computeFamily } : std::vector<uint32_t>{ graphicsFamily };
+        }
+        // Uploads then need queue family ownership transfers to be used by the graphics queue
+        bool HasDedicatedTransferQueue() const { return transferFamily != graphicsFamily; }
+        // Queues are externally synchronized, held around submits and presents to a queue the
+        // upload thread may share
+        std::unique_lock<std::mutex> LockQueueSubmission() { return std::unique_lock<std::mutex>{ queueSubmissionMutex }; }
+        // Asynchronous buffer and image uploads on the transfer queue
+        Uploader& GetUploader() { return *uploader; }
+
+        bool IsExtensionEnabled(const char* extension) const;
+        // Vulkan 1.2 features actually enabled on the logical device
+        const VkPhysicalDeviceVulkan12Features& GetEnabledVulkan12Features() const { return enabledVulkan12Features; }
+        bool SupportsBindless() const;
+        // VK_KHR_present_id + VK_KHR_present_wait: presents carry an id the CPU can wait on
+        bool SupportsPresentWait() const
+        {
+            return enabledPresentIdFeatures.presentId && enabledPresentWaitFeatures.presentWait;
+        }
+        // VK_KHR_dynamic_rendering: passes render to image views, pipelines only depend on formats
+        bool SupportsDynamicRendering() const { return enabledDynamicRenderingFeatures.dynamicRendering; }
+        void CmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR& renderingInfo)
+        {
+            cmdBeginRendering(commandBuffer, &renderingInfo);
+        }
+        void CmdEndRendering(VkCommandBuffer commandBuffer) { cmdEndRendering(commandBuffer); }
+        // Device local heaps budget, from VK_EXT_memory_budget when available or estimated from heap sizes
+        MemoryBudget GetDeviceLocalMemoryBudget();
+
+        // Frame timeline: the submission of frame N signals value N on this semaphore.
+        // Any system can check if the GPU is done with a frame without blocking.
+        VkSemaphore GetFrameTimeline() { return frameTimeline; }
+        uint64_t GetSubmittedFrame() const { return submittedFrame; }
+        uint64_t BeginFrameSubmission() { return ++submittedFrame; }
+        uint64_t GetCompletedFrame();
+        bool IsFrameComplete(uint64_t frame)
+        {
+            if (frame > completedFrameCache)
+            {
+                completedFrameCache = GetCompletedFrame();
+            }
+            return frame <= completedFrameCache;
+        }
+        void WaitForFrame(uint64_t frame);
+
+        // Semaphore values the next frame submission waits for at the given stages, used to
+        // consume work from other queues. Called from the render thread only.
+        struct FrameWait
+        {
+            VkSemaphore semaphore;
+            uint64_t value;
+            VkPipelineStageFlags stages;
+        };
+        void AddFrameWait(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stages);
+        std::vector<FrameWait> TakeFrameWaits() { return std::move(frameWaits); }
+        // Work on another queue that must be done before the frame being recorded retires,
+        // DeferDestroy keeps resources until the semaphore reaches value as well. The semaphore
+        // must stay alive until ReleaseFrameDependencies. Called from the render thread only.
+        void AddFrameDependency(VkSemaphore semaphore, uint64_t value);
+        void ReleaseFrameDependencies(VkSemaphore semaphore);
+
+        // Runs destroy once every frame that may still reference the resource has retired,
+        // the frame being recorded included. Safe to call from any thread.
+        void DeferDestroy(std::function<void()>&& destroy);
+        // Destroys the resources whose frames have completed, called once per frame
+        void CollectDeferredDestroys();
 
         SwapChainSupportDetails GetSwapChainSupport() { return QuerySwapChainSupport(physicalDevice); }
         uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        bool HasMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
         QueueFamilyIndices FindPhysicalQueueFamilies() { return FindQueueFamilies(physicalDevice); }
         VkFormat FindSupportedFormat(
             const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+        bool IsFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
 
         // Buffer Helper Functions
+        // With more than one queue family the buffer is shared concurrently between them
         void CreateBuffer(
             VkDeviceSize size,
             VkBufferUsageFlags usage,
             VkMemoryPropertyFlags properties,
             VkBuffer& buffer,
-            VkDeviceMemory& bufferMemory);
-        VkCommandBuffer BeginSingleTimeCommands();
-        void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
-        void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-        void CopyBufferToImage(
-            VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+            VkDeviceMemory& bufferMemory,
+            const std::vector<uint32_t>& queueFamilies = {});
 
+        // preferredProperties are added to properties when a memory type has them all
         void CreateImageWithInfo(
             const VkImageCreateInfo& imageInfo,
             VkMemoryPropertyFlags properties,
             VkImage& image,
-            VkDeviceMemory& imageMemory);
+            VkDeviceMemory& imageMemory,
+            VkMemoryPropertyFlags preferredProperties = 0);
 
         VkPhysicalDeviceProperties properties;
 
@@ -84,6 +183,7 @@ namespace Application {
         void PickPhysicalDevice();
         void CreateLogicalDevice();
         void CreateCommandPool();
+        void CreateFrameTimeline();
 
         // helper functions
         bool IsDeviceSuitable(VkPhysicalDevice device);
@@ -105,8 +205,57 @@ namespace Application {
         VkSurfaceKHR surface;
         VkQueue graphicsQueue;
         VkQueue presentQueue;
+        VkQueue transferQueue;
+        VkQueue computeQueue;
+        uint32_t graphicsFamily;
+        uint32_t transferFamily;
+        uint32_t computeFamily;
+        std::mutex queueSubmissionMutex;
+        std::unique_ptr<Uploader> uploader;
+        std::vector<FrameWait> frameWaits;
+
+        VkSemaphore frameTimeline;
+        // Read by DeferDestroy from loader threads
+        std::atomic<uint64_t> submittedFrame{ 0 };
+        uint64_t completedFrameCache = 0;
+
+        struct DeferredDestroy
+        {
+            uint64_t frame;
+            std::function<void()> destroy;
+        };
+        // Ordered by frame, pushes always use the latest submitted frame
+        std::deque<DeferredDestroy> deferredDestroys;
+        std::mutex deferredDestroysMutex;
+
+        struct FrameDependency
+        {
+            uint64_t frame;
+            VkSemaphore semaphore;
+            uint64_t value;
+        };
+        // Ordered by frame, render thread only
+        std::deque<FrameDependency> frameDependencies;
+        // Last frame whose commands and dependencies have all completed
+        uint64_t GetRetiredFrame();
 
         const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
         const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        // Enabled only when the physical device supports them
+        const std::vector<const char*> optionalDeviceExtensions =
+        {
+            VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+            VK_KHR_PRESENT_ID_EXTENSION_NAME,
+            VK_KHR_PRESENT_WAIT_EXTENSION_NAME,
+            VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME,
+            VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME
+        };
+        std::vector<const char*> enabledDeviceExtensions;
+        VkPhysicalDeviceVulkan12Features enabledVulkan12Features{};
+        VkPhysicalDevicePresentIdFeaturesKHR enabledPresentIdFeatures{};
+        VkPhysicalDevicePresentWaitFeaturesKHR enabledPresentWaitFeatures{};
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR enabledDynamicRenderingFeatures{};
+        PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+        PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
     };
 }
\ No newline at end of file
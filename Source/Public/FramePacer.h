@@ -0,0 +1,59 @@
+#pragma once
+#include "Renderer.h"
+
+#include <array>
+#include <chrono>
+
+namespace Application
+{
+	// Limits the frame rate to a target by sleeping before the next frame starts. Most of the
+	// wait is a high resolution OS sleep, the last part is a short spin since sleeps overshoot.
+	// With present wait the frame also starts only once the previous one reached the display,
+	// with display timing the interval snaps to a multiple of the refresh period.
+	class FramePacer
+	{
+	public:
+		using Clock = std::chrono::high_resolution_clock;
+
+		static constexpr double HISTOGRAM_BUCKET_MS = 0.5;
+		static constexpr size_t HISTOGRAM_BUCKETS = 100;
+
+		// A target of 0 doesn't limit, frame times are still recorded
+		FramePacer(double targetFrameRate = 0.0);
+		~FramePacer();
+
+		FramePacer(const FramePacer&) = delete;
+		FramePacer& operator=(const FramePacer&) = delete;
+
+		void SetTargetFrameRate(double frameRate) { targetFrameRate = frameRate; }
+		double GetTargetFrameRate() const { return targetFrameRate; }
+
+		// Blocks until the next frame should start, call right before polling input
+		void Wait(Renderer& renderer);
+
+		// Prints the frame time histogram and percentiles since the last report, then clears it
+		void ReportHistogram(const char* label);
+
+	private:
+		void SleepUntil(Clock::time_point deadline);
+		void RecordFrameTime(double frameMs);
+		double GetPercentile(double percentile) const;
+
+		double targetFrameRate;
+		Clock::time_point nextFrameStart;
+		Clock::time_point lastFrameStart;
+		bool hasLastFrameStart = false;
+
+		// How early the OS sleep returns control for the final spin, follows the measured overshoot
+		double spinMarginMs = 1.0;
+
+		// Last bucket also counts every frame above the histogram range
+		std::array<uint32_t, HISTOGRAM_BUCKETS> histogram{};
+		uint32_t frameCount = 0;
+		double maxFrameMs = 0.0;
+
+#ifdef _WIN32
+		void* waitableTimer = nullptr;
+#endif
+	};
+}
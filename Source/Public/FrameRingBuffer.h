@@ -0,0 +1,60 @@
+#pragma once
+#include "Device.h"
+#include "SwapChain.h"
+
+#include <array>
+#include <cstring>
+
+namespace Application
+{
+	// Persistently mapped buffer split in one region per frame in flight. Systems sub-allocate
+	// per-frame and per-object data from the current region with plain stores and read it at
+	// the allocation's offset, the region is reused once its frame has completed.
+	class FrameRingBuffer
+	{
+	public:
+		struct Allocation
+		{
+			void* data;
+			// Offset from the start of the buffer
+			uint32_t offset;
+		};
+
+		FrameRingBuffer(
+			Device& device,
+			VkDeviceSize frameSize,
+			VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		~FrameRingBuffer();
+
+		FrameRingBuffer(const FrameRingBuffer&) = delete;
+		FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+
+		// Start writing in frameIndex's region, its previous content must no longer be in use
+		void BeginFrame(int frameIndex);
+
+		Allocation Allocate(VkDeviceSize size);
+
+		template<typename T>
+		uint32_t Push(const T& value)
+		{
+			Allocation allocation = Allocate(sizeof(T));
+			memcpy(allocation.data, &value, sizeof(T));
+			return allocation.offset;
+		}
+
+		VkBuffer GetBuffer() const { return buffer; }
+		VkDeviceSize GetAlignment() const { return alignment; }
+		VkDeviceSize GetUsedBytes() const { return head - frameBase; }
+
+	private:
+		Device& device;
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		uint8_t* mapped = nullptr;
+
+		VkDeviceSize frameSize;
+		VkDeviceSize alignment;
+		VkDeviceSize frameBase = 0;
+		VkDeviceSize head = 0;
+	};
+}
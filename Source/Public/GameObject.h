@@ -1,59 +1,138 @@
 #pragma once
 #include "Model.h"
+#include "Pool.h"
 
 #include <memory>
+#include <vector>
 namespace Application
 {
+	class SceneHierarchy;
+
+	// Indices of the transforms changed during a frame, each listed once, filled by the
+	// transforms themselves so consumers only visit what moved
+	class TransformChangeList
+	{
+	public:
+		const std::vector<uint32_t>& GetChanged() const { return changed; }
+		// Starts the next frame's list, a transform changed again is listed again
+		void Clear()
+		{
+			changed.clear();
+			stamp++;
+		}
+
+	private:
+		friend struct Transform2dComponent;
+
+		std::vector<uint32_t> changed;
+		uint64_t stamp = 1;
+	};
+
+	// Setters bump the version and mark the matrix dirty, mat2() only recomputes it after a change
 	struct Transform2dComponent
 	{
-		glm::vec2 translation{};
-		glm::vec2 scale{ 1.0f, 1.0f };
-		float rotation;
+	public:
+		const glm::vec2& GetTranslation() const { return translation; }
+		const glm::vec2& GetScale() const { return scale; }
+		float GetRotation() const { return rotation; }
+
+		void SetTranslation(const glm::vec2& value)
+		{
+			translation = value;
+			Changed(false);
+		}
+		void SetScale(const glm::vec2& value)
+		{
+			scale = value;
+			Changed(true);
+		}
+		void SetRotation(float value)
+		{
+			rotation = value;
+			Changed(true);
+		}
+
+		// Rotation * scale, cached until the rotation or scale change
+		const glm::mat2& mat2() const
+		{
+			if (matrixDirty)
+			{
+				UpdateMatrix();
+			}
+			return matrix;
+		}
 
-		glm::mat2 mat2() 
+		// Increases on every change, lets consumers skip transforms they already saw
+		uint32_t GetVersion() const { return version; }
+
+		// Reports changes to list under index, the transform is listed right away so the
+		// consumer picks up its current state
+		void Track(TransformChangeList* list, uint32_t index);
+
+	private:
+		void Changed(bool matrixChanged)
 		{
-			const float s = glm::sin(rotation);
-			const float c = glm::cos(rotation);
-			glm::mat2 rotMat
+			version++;
+			matrixDirty |= matrixChanged;
+			if (changeList && queuedStamp != changeList->stamp)
 			{
-				{c, s},
-				{-s, c}
-			};
-
-			glm::mat2 scaleMat
-			{ 
-				{scale.x, 0.0f}, 
-				{0.0f, scale.y} 
-			};
-			return rotMat * scaleMat;
+				queuedStamp = changeList->stamp;
+				changeList->changed.push_back(changeIndex);
+			}
 		}
+		void UpdateMatrix() const;
+
+		glm::vec2 translation{};
+		glm::vec2 scale{ 1.0f, 1.0f };
+		float rotation = 0.0f;
+
+		uint32_t version = 0;
+		mutable bool matrixDirty = true;
+		mutable glm::mat2 matrix{ 1.0f };
+
+		TransformChangeList* changeList = nullptr;
+		uint32_t changeIndex = 0;
+		// Stamp of the list the transform was last queued in
+		uint64_t queuedStamp = 0;
 	};
 
 	class GameObject
 	{
 	public:
+		// Slot in the object's pool, reused once the object is destroyed
 		using id_t = unsigned int;
 
-		static GameObject CreateGameObject()
-		{
-			static id_t currentId = 0;
-			return GameObject{ currentId++ };
-		}
-
 		id_t GetId() const { return id; }
 
-		std::shared_ptr<Model> model{};
+		Handle<Model> model{};
 		glm::vec3 color{};
 		Transform2dComponent transform2d;
+		// Slot in BindlessDescriptors, ignored when rendering without bindless
+		uint32_t textureIndex = ~0u;
+		// SceneHierarchy node given by SceneHierarchy::Attach, transform2d is relative to the
+		// parent's world transform while the object has one
+		uint32_t hierarchyNode = ~0u;
+
+		// Leaves its hierarchy, the descendants are detached with it
+		~GameObject();
 
+		// Not movable, the hierarchy holds on to the address of its attached objects
 		GameObject(const GameObject&) = delete;
 		GameObject& operator=(const GameObject&) = delete;
-		GameObject(GameObject&&) = default;
-		GameObject& operator=(GameObject&&) = default;
+
+		// Spawn and despawn churn of a pool against a vector of objects holding shared models
+		static void RunPoolBenchmark();
 
 	private:
+		// Created by GameObjectPool::CreateIndexed
+		template<typename, uint32_t> friend class Pool;
+		friend class SceneHierarchy;
 		GameObject(id_t objId) : id{ objId } {}
 
 		id_t id;
+		// Set with hierarchyNode
+		SceneHierarchy* hierarchy = nullptr;
 	};
-}
\ No newline at end of file
+
+	using GameObjectPool = Pool<GameObject>;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "Device.h"
+#include "FrameRingBuffer.h"
+#include "GameObject.h"
+#include "SceneHierarchy.h"
+
+#include <vector>
+
+namespace Application
+{
+	// Per-object draw data in one device-local buffer read at instance rate, instance i is
+	// the game object in pool slot i. The objects' transforms report their changes, each frame
+	// only the changed instances are written to a staging region and copied over as a few
+	// merged ranges.
+	class InstanceBuffer
+	{
+	public:
+		struct Instance
+		{
+			// Columns of the transform's mat2
+			glm::vec2 transform0;
+			glm::vec2 transform1;
+			glm::vec2 offset;
+			glm::vec3 color;
+			// Index in the bindless texture array or -1
+			int32_t textureIndex;
+
+			static VkVertexInputBindingDescription GetBindingDescription(uint32_t binding);
+			static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(
+				uint32_t binding, uint32_t firstLocation);
+		};
+
+		// Of the last Flush
+		struct Stats
+		{
+			uint32_t changedCount = 0;
+			uint32_t rangeCount = 0;
+			VkDeviceSize copiedBytes = 0;
+		};
+
+		// Stages the copies wait for and make their writes visible to
+		static constexpr VkPipelineStageFlags READ_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		static constexpr VkAccessFlags READ_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+		InstanceBuffer(Device& device, uint32_t capacity);
+		~InstanceBuffer();
+
+		InstanceBuffer(const InstanceBuffer&) = delete;
+		InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+		// Tracks every object's transform and uploads all of them at the next Flush
+		void Assign(GameObjectPool& gameObjects);
+		// Tracks a created object, its instance is uploaded at the next Flush
+		void Track(GameObject& gameObject);
+		// For changes the transforms don't report, like the color or texture
+		void MarkChanged(uint32_t index);
+		// Writes the changed instances in frameIndex's staging region and records their
+		// copies, outside a render pass. Destroyed objects' instances are left as they are.
+		// Objects attached to hierarchy use its world transforms, the ones its last Update
+		// moved are written too.
+		void Flush(int frameIndex, VkCommandBuffer commandBuffer, const GameObjectPool& gameObjects,
+			const SceneHierarchy* hierarchy = nullptr);
+		void Bind(VkCommandBuffer commandBuffer, uint32_t binding) const;
+
+		VkBuffer GetBuffer() const { return buffer; }
+		// Transforms changed since the last Flush, which clears it
+		const TransformChangeList& GetChangeList() const { return changeList; }
+		const Stats& GetStats() const { return stats; }
+
+	private:
+		static Instance MakeInstance(const GameObject& obj, const SceneHierarchy* hierarchy);
+
+		Device& device;
+		uint32_t capacity;
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		// A frame can rewrite every instance
+		FrameRingBuffer staging;
+
+		TransformChangeList changeList;
+		std::vector<uint32_t> markedIndices;
+
+		// Reused between frames
+		std::vector<uint32_t> changed;
+		std::vector<VkBufferCopy> copies;
+		Stats stats;
+	};
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Application
+{
+	// Reader for KTX2 texture containers (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html).
+	// Only the header and the level index are read when opening the file, mip levels are
+	// read on demand so a caller can upload the small levels first.
+	class Ktx2File
+	{
+	public:
+		enum class Supercompression : uint32_t
+		{
+			None = 0,
+			BasisLZ = 1,
+			Zstandard = 2,
+			Zlib = 3
+		};
+
+		// Universal formats are stored with VK_FORMAT_UNDEFINED and described by the DFD color model
+		enum class UniversalFormat
+		{
+			None,
+			ETC1S,
+			UASTC
+		};
+
+		struct Level
+		{
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		Ktx2File(const std::string& filepath);
+
+		VkFormat GetFormat() const { return format; }
+		uint32_t GetWidth() const { return width; }
+		uint32_t GetHeight() const { return height; }
+		uint32_t GetLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+		uint32_t GetLayerCount() const { return layerCount; }
+		uint32_t GetLevelWidth(uint32_t level) const { return width >> level ? width >> level : 1; }
+		uint32_t GetLevelHeight(uint32_t level) const { return height >> level ? height >> level : 1; }
+		Supercompression GetSupercompression() const { return supercompression; }
+		UniversalFormat GetUniversalFormat() const { return universalFormat; }
+		// From the DFD transfer function, tells universal textures holding color from linear data
+		bool IsSrgb() const { return srgb; }
+		const std::string& GetPath() const { return filepath; }
+		const Level& GetLevel(uint32_t level) const { return levels[level]; }
+
+		std::vector<uint8_t> ReadLevel(uint32_t level) const;
+		std::vector<uint8_t> ReadGlobalData() const;
+
+		static bool IsBlockCompressed(VkFormat format);
+		static void GetBlockExtent(VkFormat format, uint32_t& blockWidth, uint32_t& blockHeight);
+		static uint32_t GetBlockSize(VkFormat format);
+		static VkDeviceSize GetLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+		// Decode BC1-BC5 data to RGBA8, used when the device can't sample the compressed format
+		static bool CanDecodeOnCpu(VkFormat format);
+		static VkFormat GetDecodedFormat(VkFormat format);
+		static std::vector<uint8_t> DecodeToRgba8(
+			VkFormat format, uint32_t width, uint32_t height, const std::vector<uint8_t>& data);
+
+	private:
+		void ReadDataFormatDescriptor(const std::vector<uint8_t>& dfd);
+
+		std::string filepath;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t layerCount = 1;
+		Supercompression supercompression = Supercompression::None;
+		UniversalFormat universalFormat = UniversalFormat::None;
+		bool srgb = false;
+		uint64_t globalDataOffset = 0;
+		uint64_t globalDataLength = 0;
+		std::vector<Level> levels;
+	};
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace Application
+{
+	// Read-only view of a whole file mapped into memory, pages are read by the OS on first
+	// access instead of copied through a stream
+	class MappedFile
+	{
+	public:
+		// Throws if the file can't be opened or mapped
+		MappedFile(const std::string& filepath);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const uint8_t* GetData() const { return data; }
+		size_t GetSize() const { return size; }
+		const std::string& GetPath() const { return filepath; }
+
+	private:
+		std::string filepath;
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+
+#ifdef _WIN32
+		void* file = nullptr;
+		void* mapping = nullptr;
+#else
+		int file = -1;
+#endif
+	};
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "Model.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace Application
+{
+	// Triangle list ready to become a Model
+	struct MeshData
+	{
+		std::vector<Model::Vertex> vertices;
+		std::vector<uint32_t> indices;
+		// Source z of imported meshes, scaled like the positions, only kept until cooking
+		std::vector<float> depths;
+	};
+
+	// Cooked copies of imported meshes, one file per source mesh, already indexed and in the
+	// optimized order. Positions are stored as 16 bit snorm relative to the mesh bounds and
+	// colors as RGBA8, a cooked mesh is read by mapping the file and expanding the arrays.
+	// A cooked file records the size and time of its source and is ignored once they change.
+	class MeshCache
+	{
+	public:
+		static constexpr uint32_t VERSION = 2;
+
+		MeshCache(const std::string& directory);
+
+		// Fills mesh from the cooked copy of sourcePath, false when there is none or it is out of date
+		bool TryLoad(const std::string& sourcePath, MeshData& mesh) const;
+		// Cooks mesh for sourcePath, safe to call for different sources from several threads
+		void Store(const std::string& sourcePath, const MeshData& mesh) const;
+
+		std::string GetCookedPath(const std::string& sourcePath) const;
+		const std::string& GetDirectory() const { return directory; }
+
+	private:
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			// 0x01020304 as written by a little-endian machine
+			uint32_t byteOrder;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			// 2 or 4 bytes
+			uint32_t indexSize;
+			// Source the file was cooked from
+			uint64_t sourceSize;
+			int64_t sourceTime;
+			// Quantization range of the positions
+			float boundsMin[2];
+			float boundsMax[2];
+			// From the start of the file
+			uint64_t positionsOffset;
+			uint64_t colorsOffset;
+			uint64_t indicesOffset;
+			uint64_t fileSize;
+		};
+
+		static bool GetSourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time);
+
+		std::string directory;
+	};
+}
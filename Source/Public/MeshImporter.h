@@ -0,0 +1,108 @@
+#pragma once
+#include "Model.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace Application
+{
+	// Imports .obj, .gltf and .glb meshes on worker threads. A mesh is parsed once, cooked into
+	// the MeshCache and read back from there by later runs until its source changes. Meshes are
+	// flattened for the 2D renderer: x and y are kept (y up), z is dropped, and the result is
+	// scaled into the unit square models are drawn in. glTF node transforms are not applied,
+	// every triangle primitive of every mesh is merged in its own space.
+	class MeshImporter
+	{
+	public:
+		using LoadedCallback = std::function<void(Handle<Model>)>;
+
+		struct LoadInfo
+		{
+			bool fromCache = false;
+			// Parse or cache read, cooking included
+			double milliseconds = 0.0;
+			// Before and after cooking, only filled when the mesh was imported
+			MeshOptimizer::VertexCacheStats importedCache;
+			MeshOptimizer::VertexCacheStats cookedCache;
+		};
+
+		static constexpr const char* DEFAULT_CACHE_DIRECTORY = "Resources/MeshCache";
+
+		// Models are created with vertexLayout. A worker count of 0 uses one worker per hardware
+		// thread, up to 4.
+		MeshImporter(Device& device, ModelPool& models, const Model::VertexLayout& vertexLayout = Model::VertexLayout::Full(),
+			const std::string& cacheDirectory = DEFAULT_CACHE_DIRECTORY, uint32_t workerCount = 0);
+		~MeshImporter();
+
+		MeshImporter(const MeshImporter&) = delete;
+		MeshImporter& operator=(const MeshImporter&) = delete;
+
+		// Imports in the background, onLoaded gets the model from Update or right away when the
+		// file is already loaded. Meshes that fail to import are reported and never call back.
+		void Load(const std::string& filepath, LoadedCallback onLoaded);
+
+		// Creates the models of the finished imports and calls their callbacks, call once per frame
+		void Update();
+		bool IsIdle() const;
+
+		// Reads the cooked mesh or imports and cooks it, safe to call from any thread
+		static MeshData LoadMesh(const std::string& filepath, const MeshCache& cache, LoadInfo* info = nullptr);
+
+		// Flattened straight from the file, not cooked, throw on malformed files
+		static MeshData ImportObj(const std::string& filepath);
+		static MeshData ImportGltf(const std::string& filepath);
+
+		// Welds identical vertices, orders the triangles for the vertex cache and overdraw and
+		// the vertices for fetching
+		static void Cook(MeshData& mesh);
+
+		// Cold import against cached loads of generated .obj and .glb meshes
+		static void RunBenchmark();
+
+	private:
+		struct ImportRequest
+		{
+			std::string filepath;
+		};
+
+		struct ImportResult
+		{
+			std::string filepath;
+			MeshData mesh;
+			LoadInfo info;
+			std::string error;
+		};
+
+		struct LoadedMesh
+		{
+			Handle<Model> model;
+			bool pending = true;
+			std::vector<LoadedCallback> callbacks;
+		};
+
+		void WorkerLoop();
+
+		Device& device;
+		ModelPool& models;
+		Model::VertexLayout vertexLayout;
+		MeshCache cache;
+
+		std::unordered_map<std::string, LoadedMesh> meshes;
+		uint32_t pendingCount = 0;
+
+		std::vector<std::thread> workers;
+		mutable std::mutex queueMutex;
+		std::condition_variable queueCondition;
+		std::deque<ImportRequest> requests;
+		std::vector<ImportResult> results;
+		bool stopWorkers = false;
+	};
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace Application
+{
+	// Import time reordering of indexed triangle lists. Triangles are first ordered for the
+	// post-transform vertex cache (Tipsify), groups of them are then sorted so that outer,
+	// outward facing parts are drawn first and hide what is behind them, at a bounded vertex
+	// cache cost, and the vertices are finally laid out in the order the triangles fetch them.
+	class MeshOptimizer
+	{
+	public:
+		// Post-transform cache entries assumed by the optimization and the statistics
+		static constexpr uint32_t CACHE_SIZE = 16;
+
+		struct VertexCacheStats
+		{
+			// Vertices transformed per triangle, 0.5 at best for large regular meshes, 3 at worst
+			float acmr = 0.0f;
+			// Vertices transformed per referenced vertex, 1 at best
+			float atvr = 0.0f;
+		};
+
+		// Simulates a FIFO cache of cacheSize vertices
+		static VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount,
+			uint32_t cacheSize = CACHE_SIZE);
+
+		// Bytes read per byte of referenced vertices through a 16 KiB direct mapped cache of 64
+		// byte lines, 1 when every line is read once
+		static float AnalyzeVertexFetch(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t vertexSize);
+
+		// Pixels shaded per pixel covered, rasterized with a depth test and back faces culled
+		// from the six axis directions, 1 when nothing is drawn over
+		static float AnalyzeOverdraw(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions);
+
+		// Tipsify, linear in the triangle count
+		static std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount,
+			uint32_t cacheSize = CACHE_SIZE);
+
+		// Cuts cache optimized indices into clusters wherever a triangle misses on all its
+		// vertices, or sooner when the ACMR stays within threshold times the cluster's, and draws
+		// the clusters outermost and outward facing first. Flat meshes keep their order.
+		static std::vector<uint32_t> OptimizeOverdraw(const std::vector<uint32_t>& indices,
+			const std::vector<glm::vec3>& positions, uint32_t cacheSize = CACHE_SIZE, float threshold = 1.05f);
+
+		// Renumbers the vertices in the order indices first use them, rewriting indices. Returns
+		// the new index of every vertex, ~0u for the ones no triangle uses.
+		static std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+		// Moves vertices to the places given by OptimizeVertexFetch, dropping the unused ones
+		template<typename T>
+		static void RemapVertices(std::vector<T>& vertices, const std::vector<uint32_t>& remap)
+		{
+			uint32_t usedCount = 0;
+			for (uint32_t target : remap)
+			{
+				usedCount += target != ~0u;
+			}
+			std::vector<T> remapped(usedCount);
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				if (remap[i] != ~0u)
+				{
+					remapped[remap[i]] = vertices[i];
+				}
+			}
+			vertices = std::move(remapped);
+		}
+
+		// Statistics of authored, shuffled and optimized orders of a grid, a sphere and a torus
+		static void RunBenchmark();
+	};
+}
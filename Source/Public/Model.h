@@ -1,5 +1,6 @@
 #pragma once
 #include "Device.h"
+#include "Pool.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -14,27 +15,89 @@ namespace Application
 		{
 			glm::vec2 position;
 			glm::vec3 color;
+		};
+
+		// How the vertices are stored in the vertex buffer. The shaders read floats whatever the
+		// formats, a pipeline only draws models created with the layout it was created with.
+		struct VertexLayout
+		{
+			enum class PositionFormat : uint8_t
+			{
+				Float32,
+				// 2^-11 relative precision, any range
+				Half,
+				// 2^-15 steps, positions must be within [-1, 1]
+				Snorm16
+			};
+			enum class ColorFormat : uint8_t
+			{
+				Float32,
+				// RGBA8, 1/255 steps, colors are clamped to [0, 1]
+				Unorm8
+			};
+
+			PositionFormat position = PositionFormat::Float32;
+			ColorFormat color = ColorFormat::Float32;
+
+			// 20 bytes per vertex
+			static constexpr VertexLayout Full() { return {}; }
+			// 8 bytes per vertex, for anything drawn in the model square
+			static constexpr VertexLayout Compact() { return { PositionFormat::Snorm16, ColorFormat::Unorm8 }; }
 
-			static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions();
-			static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
+			bool operator==(const VertexLayout& other) const { return position == other.position && color == other.color; }
+			bool operator!=(const VertexLayout& other) const { return !(*this == other); }
+
+			uint32_t GetStride() const;
+			std::vector<VkVertexInputBindingDescription> GetBindingDescriptions() const;
+			std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions() const;
+
+			// Throws when a position is out of the range of the format
+			std::vector<uint8_t> Pack(const std::vector<Vertex>& vertices) const;
+			std::vector<Vertex> Unpack(const std::vector<uint8_t>& data) const;
+
+			// Round trips random vertices through every layout and throws if an error goes over
+			// the format's bound, reports the errors and the memory per vertex
+			static void RunPrecisionTest();
 		};
 
-		Model(Device& device, const std::vector<Vertex>& verticies);
+		// Without indices the vertices are drawn as a triangle list
+		Model(Device& device, const std::vector<Vertex>& verticies, const std::vector<uint32_t>& indices = {},
+			const VertexLayout& layout = VertexLayout::Full());
 		~Model();
 
 		Model(const Model&) = delete;
 		Model& operator=(const Model&) = delete;
 
-		void Bind(VkCommandBuffer commandBuffer);
-		void Draw(VkCommandBuffer commandBuffer);
+		// False until the vertex and index uploads have reached the graphics queue, for good when
+		// they failed (Uploader::GetError)
+		bool IsReady() const;
+		const VertexLayout& GetLayout() const { return layout; }
+		void Bind(VkCommandBuffer commandBuffer) const;
+		// firstInstance selects the per-instance data bound next to the vertices
+		void Draw(VkCommandBuffer commandBuffer, uint32_t firstInstance = 0) const;
 
 	private:
 		void CreateVertexBuffers(const std::vector<Vertex>& verticies);
+		void CreateIndexBuffer(const std::vector<uint32_t>& indices);
 
 		Device &device;
+		VertexLayout layout;
 
 		VkBuffer vertexBuffer;
 		VkDeviceMemory vertexBufferMemory;
 		uint32_t vertexCount;
+		// Uploads fail one by one, both must be available before drawing. 0 without indices,
+		// always available.
+		uint64_t vertexUploadTicket;
+		uint64_t indexUploadTicket = 0;
+
+		// 16 bit indices when every vertex is reachable with them
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+		VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+		uint32_t indexCount = 0;
 	};
-}
+
+	// Models are shared by handle, a destroyed model's handles go stale
+	using ModelPool = Pool<Model>;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+#include "Device.h"
+#include "Pipline.h"
+#include "Descriptors.h"
+#include "AsyncCompute.h"
+
+#include <memory>
+#include <array>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace Application
+{
+	// Particles living entirely on the GPU. Each frame the async compute queue simulates the
+	// previous frame's particles into a scratch buffer, compacts the living ones into the other
+	// particle buffer and appends the new ones after them. The count ends up in the indirect
+	// draw arguments the frame draws with, the CPU never reads anything back.
+	class ParticleSystem
+	{
+	public:
+		struct Emitter
+		{
+			glm::vec2 position{ 0.0f, 0.9f };
+			// Particles per second
+			float rate = 50'000.0f;
+			float minLife = 1.0f;
+			float maxLife = 2.0f;
+		};
+
+		ParticleSystem(
+			Device& device,
+			AsyncCompute& asyncCompute,
+			DescriptorAllocator& descriptorAllocator,
+			const RenderTargetInfo& target,
+			uint32_t capacity);
+		~ParticleSystem();
+
+		ParticleSystem(const ParticleSystem&) = delete;
+		ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+		// Submits the simulation of the frame being recorded, its draws wait for it on the GPU
+		void Simulate(int frameIndex, float deltaTime);
+		void Render(VkCommandBuffer commandBuffer);
+
+		Emitter& GetEmitter() { return emitter; }
+		uint32_t GetCapacity() const { return capacity; }
+
+		// Simulation throughput at 100k, 1M and 4M particles, printed to the console
+		static void RunBenchmark(
+			Device& device,
+			AsyncCompute& asyncCompute,
+			DescriptorAllocator& descriptorAllocator,
+			const RenderTargetInfo& target);
+
+	private:
+		static constexpr uint32_t GROUP_SIZE = 256;
+
+		// Matches the shaders, std430
+		struct Particle
+		{
+			glm::vec2 position;
+			glm::vec2 velocity;
+			float life;
+			float maxLife;
+			uint32_t color;
+			float size;
+		};
+
+		// Indirect draw command followed by the compaction counter, one per particle buffer
+		struct DrawArgs
+		{
+			VkDrawIndirectCommand draw;
+			uint32_t aliveCount;
+			uint32_t padding[3];
+		};
+
+		struct PushConstants
+		{
+			glm::vec2 emitterPosition;
+			float deltaTime;
+			float minLife;
+			float maxLife;
+			uint32_t capacity;
+			uint32_t emitCount;
+			// Particle buffer read this step, the other one is written
+			uint32_t inIndex;
+			uint32_t seed;
+		};
+
+		void CreateBuffers();
+		void CreateDescriptorSets(DescriptorAllocator& descriptorAllocator);
+		void CreatePipelines(const RenderTargetInfo& target);
+		// Emit, simulate and compact, reading particle buffer current and writing the other one
+		void RecordStep(VkCommandBuffer commandBuffer, float deltaTime, uint32_t emitCount);
+
+		Device& device;
+		AsyncCompute& asyncCompute;
+		uint32_t capacity;
+		Emitter emitter;
+
+		std::array<VkBuffer, 2> particleBuffers;
+		std::array<VkDeviceMemory, 2> particleMemories;
+		VkBuffer scratchBuffer;
+		VkDeviceMemory scratchMemory;
+		VkBuffer argsBuffer;
+		VkDeviceMemory argsMemory;
+
+		VkDescriptorSetLayout setLayout;
+		// Set i reads particle buffer i and writes the other one
+		std::array<VkDescriptorSet, 2> descriptorSets;
+		VkPipelineLayout pipelineLayout;
+		std::unique_ptr<ComputePipeline> simulatePipeline;
+		std::unique_ptr<ComputePipeline> compactPipeline;
+		std::unique_ptr<ComputePipeline> emitPipeline;
+		std::unique_ptr<Pipeline> renderPipeline;
+
+		// Particle buffer holding the last simulated step
+		uint32_t current = 0;
+		uint32_t step = 0;
+		float emitRemainder = 0.0f;
+	};
+}
@@ -20,9 +20,24 @@ namespace Application
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 		std::vector<VkDynamicState> dynamicStateEnables;
 		VkPipelineDynamicStateCreateInfo dynamicStateInfo;
+		// Model vertices by default, empty for shaders that fetch their data from buffers
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		// Used instead of the render pass when it is null, with dynamic rendering
+		std::vector<VkFormat> colorAttachmentFormats;
+		VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+	};
+
+	// What a pipeline renders to. With dynamic rendering there is no render pass, a pipeline
+	// is compatible with every target that has the same attachment formats.
+	struct RenderTargetInfo
+	{
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		std::vector<VkFormat> colorFormats;
+		VkFormat depthFormat = VK_FORMAT_UNDEFINED;
 	};
 
 	class Pipeline
@@ -39,10 +54,14 @@ namespace Application
 		Pipeline& operator=(const Pipeline&) = delete;
 
 		static void DefaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+		static void SetRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& target);
 
 		void Bind(VkCommandBuffer commandBuffer);
 	private:
+		friend class ComputePipeline;
+
 		static std::vector<char> ReadFile(const std::string& filepath);
+		static bool HasStencil(VkFormat format);
 
 		void CreatePipeline(
 			const std::string vertFilepath,
@@ -56,4 +75,28 @@ namespace Application
 		VkShaderModule vertShaderModule;
 		VkShaderModule fragShaderModule;
 	};
+
+	// Single compute shader pipeline, can be recorded on the graphics or the compute queue
+	class ComputePipeline
+	{
+	public:
+		ComputePipeline(
+			Device& device,
+			const std::string& compFilepath,
+			VkPipelineLayout pipelineLayout,
+			const VkSpecializationInfo* specializationInfo = nullptr);
+		~ComputePipeline();
+
+		ComputePipeline(const ComputePipeline&) = delete;
+		ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+		void Bind(VkCommandBuffer commandBuffer);
+
+		// Groups needed to cover count invocations
+		static uint32_t GroupCount(uint32_t count, uint32_t groupSize) { return (count + groupSize - 1) / groupSize; }
+
+	private:
+		Device& device;
+		VkPipeline computePipeline;
+	};
 }
\ No newline at end of file
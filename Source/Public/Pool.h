@@ -0,0 +1,222 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <new>
+#include <utility>
+#include <cassert>
+#include <cstdint>
+
+namespace Application
+{
+	// Reference to an object in a Pool, stale once the object is destroyed even if its slot
+	// has been reused since
+	template<typename T>
+	struct Handle
+	{
+		uint32_t index = ~0u;
+		// 0 for the null handle, slots start at generation 1
+		uint32_t generation = 0;
+
+		bool IsNull() const { return generation == 0; }
+		bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const Handle& other) const { return !(*this == other); }
+	};
+
+	// Objects stored in fixed size chunks that never move, addressed by generational handles.
+	// Create and Destroy are O(1) and only allocate when every chunk is full, freed slots are
+	// reused first, the last freed one first. Objects keep their address for their lifetime.
+	template<typename T, uint32_t ChunkSize = 1024>
+	class Pool
+	{
+	public:
+		Pool() = default;
+		~Pool() { Clear(); }
+
+		Pool(const Pool&) = delete;
+		Pool& operator=(const Pool&) = delete;
+
+		// Allocates the chunks up front so creating up to capacity objects never allocates
+		void Reserve(uint32_t capacity)
+		{
+			while (GetCapacity() < capacity)
+			{
+				AddChunk();
+			}
+		}
+
+		template<typename... Args>
+		Handle<T> Create(Args&&... args)
+		{
+			const uint32_t index = AcquireSlot();
+			try
+			{
+				new (SlotMemory(index)) T(std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				ReleaseSlot(index);
+				throw;
+			}
+			return Publish(index);
+		}
+
+		// The slot index is passed to the constructor before args, for objects using it as their id
+		template<typename... Args>
+		Handle<T> CreateIndexed(Args&&... args)
+		{
+			const uint32_t index = AcquireSlot();
+			try
+			{
+				new (SlotMemory(index)) T(index, std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				ReleaseSlot(index);
+				throw;
+			}
+			return Publish(index);
+		}
+
+		// False for a stale or null handle
+		bool Destroy(Handle<T> handle)
+		{
+			if (!IsValid(handle))
+			{
+				return false;
+			}
+			Get(handle)->~T();
+			// Skipping 0, the null handle's generation
+			if (++generations[handle.index] == 0)
+			{
+				generations[handle.index] = 1;
+			}
+			alive[handle.index] = 0;
+			ReleaseSlot(handle.index);
+			count--;
+			return true;
+		}
+
+		// Destroys every object, the chunks are kept
+		void Clear()
+		{
+			for (uint32_t index = 0; index < slotCount; index++)
+			{
+				if (alive[index])
+				{
+					Destroy(GetHandle(index));
+				}
+			}
+		}
+
+		bool IsValid(Handle<T> handle) const
+		{
+			return handle.index < slotCount && alive[handle.index] && generations[handle.index] == handle.generation;
+		}
+		// Null for a stale handle
+		T* Get(Handle<T> handle) { return IsValid(handle) ? SlotMemory(handle.index) : nullptr; }
+		const T* Get(Handle<T> handle) const { return IsValid(handle) ? SlotMemory(handle.index) : nullptr; }
+
+		// Slot access for walking the pool, indices below GetSlotCount
+		bool IsAlive(uint32_t index) const { return index < slotCount && alive[index]; }
+		T& operator[](uint32_t index)
+		{
+			assert(IsAlive(index) && "Pool slot is empty");
+			return *SlotMemory(index);
+		}
+		const T& operator[](uint32_t index) const
+		{
+			assert(IsAlive(index) && "Pool slot is empty");
+			return *SlotMemory(index);
+		}
+		Handle<T> GetHandle(uint32_t index) const { return { index, generations[index] }; }
+
+		// Calls function on every object, in slot order
+		template<typename Function>
+		void ForEach(Function&& function)
+		{
+			for (uint32_t index = 0; index < slotCount; index++)
+			{
+				if (alive[index])
+				{
+					function(*SlotMemory(index));
+				}
+			}
+		}
+		template<typename Function>
+		void ForEach(Function&& function) const
+		{
+			for (uint32_t index = 0; index < slotCount; index++)
+			{
+				if (alive[index])
+				{
+					function(*SlotMemory(index));
+				}
+			}
+		}
+
+		uint32_t GetCount() const { return count; }
+		// Slots ever used, the free ones among them are reused first
+		uint32_t GetSlotCount() const { return slotCount; }
+		uint32_t GetCapacity() const { return static_cast<uint32_t>(chunks.size()) * ChunkSize; }
+
+	private:
+		static constexpr uint32_t END_OF_LIST = ~0u;
+
+		struct Chunk
+		{
+			alignas(T) unsigned char storage[ChunkSize][sizeof(T)];
+		};
+
+		T* SlotMemory(uint32_t index) const
+		{
+			return std::launder(reinterpret_cast<T*>(chunks[index / ChunkSize]->storage[index % ChunkSize]));
+		}
+
+		void AddChunk()
+		{
+			// Left uninitialized, slots are constructed on Create
+			chunks.emplace_back(new Chunk);
+			generations.resize(GetCapacity(), 1);
+			alive.resize(GetCapacity(), 0);
+			nextFree.resize(GetCapacity());
+		}
+
+		// Freed slots first, then the ones never used in order
+		uint32_t AcquireSlot()
+		{
+			if (freeHead != END_OF_LIST)
+			{
+				const uint32_t index = freeHead;
+				freeHead = nextFree[index];
+				return index;
+			}
+			if (slotCount == GetCapacity())
+			{
+				AddChunk();
+			}
+			return slotCount++;
+		}
+
+		void ReleaseSlot(uint32_t index)
+		{
+			nextFree[index] = freeHead;
+			freeHead = index;
+		}
+
+		Handle<T> Publish(uint32_t index)
+		{
+			alive[index] = 1;
+			count++;
+			return { index, generations[index] };
+		}
+
+		std::vector<std::unique_ptr<Chunk>> chunks;
+		// By slot
+		std::vector<uint32_t> generations;
+		std::vector<uint8_t> alive;
+		std::vector<uint32_t> nextFree;
+		uint32_t freeHead = END_OF_LIST;
+		uint32_t count = 0;
+		uint32_t slotCount = 0;
+	};
+}
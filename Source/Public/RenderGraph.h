@@ -0,0 +1,236 @@
+#pragma once
+#include "Device.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <ostream>
+
+namespace Application
+{
+	// Frame graph: systems declare passes with the resources they read and write, the graph
+	// orders them, culls the ones nothing depends on, inserts the barriers and layout
+	// transitions between them and places transient images in shared memory when their
+	// lifetimes don't overlap. It is rebuilt every frame, the transient images are kept for as
+	// long as the set of transient resources and their lifetimes doesn't change.
+	class RenderGraph
+	{
+	public:
+		using Resource = uint32_t;
+		static constexpr Resource INVALID_RESOURCE = ~0u;
+
+		struct ImageDesc
+		{
+			VkFormat format;
+			VkExtent2D extent;
+			// Usage the passes don't imply, like transfer source for a readback
+			VkImageUsageFlags extraUsage = 0;
+		};
+
+		enum class LoadOp { Load, Clear, DontCare };
+
+		class PassBuilder
+		{
+		public:
+			// Color attachments get their location in the order they are declared
+			void WriteColor(Resource image, LoadOp loadOp = LoadOp::Clear, VkClearColorValue clearValue = {});
+			void WriteDepth(Resource image, LoadOp loadOp = LoadOp::Clear, VkClearDepthStencilValue clearValue = { 1.0f, 0 });
+			void ReadTexture(Resource image, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+			void ReadStorageImage(Resource image, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			void WriteStorageImage(Resource image, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+			void ReadBuffer(Resource buffer, VkPipelineStageFlags stages, VkAccessFlags access);
+			void WriteBuffer(Resource buffer, VkPipelineStageFlags stages, VkAccessFlags access);
+			// Never culled, for passes with effects the graph can't see
+			void SetSideEffect();
+
+		private:
+			friend class RenderGraph;
+			PassBuilder(RenderGraph& graph, uint32_t passIndex) : graph{graph}, passIndex{passIndex} {}
+
+			void Use(Resource resource, VkPipelineStageFlags stages, VkAccessFlags access, VkImageLayout layout,
+				bool read, bool write);
+
+			RenderGraph& graph;
+			uint32_t passIndex;
+		};
+
+		using SetupCallback = std::function<void(PassBuilder&)>;
+		using ExecuteCallback = std::function<void(VkCommandBuffer)>;
+
+		RenderGraph(Device& device);
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		// Graph owned image, its content only lives between its first and last use in the frame
+		Resource CreateImage(const std::string& name, const ImageDesc& desc);
+		// Image owned outside the graph, left in finalLayout after its last use. initialStages are
+		// the stages the graph must wait for before the first use (the acquire semaphore wait
+		// stage for a swap chain image). A finalLayout of VK_IMAGE_LAYOUT_UNDEFINED discards the
+		// content after the last use, it isn't stored.
+		Resource ImportImage(
+			const std::string& name,
+			VkImage image,
+			VkImageView view,
+			VkFormat format,
+			VkExtent2D extent,
+			VkImageLayout initialLayout,
+			VkImageLayout finalLayout,
+			VkPipelineStageFlags initialStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		// Buffer owned outside the graph, initialStages and initialAccess describe its last write
+		Resource ImportBuffer(
+			const std::string& name,
+			VkBuffer buffer,
+			VkPipelineStageFlags initialStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VkAccessFlags initialAccess = 0);
+		// Passes contributing to an output are kept, the others are culled
+		void MarkOutput(Resource resource);
+
+		void AddPass(const std::string& name, const SetupCallback& setup, ExecuteCallback&& execute);
+
+		void Compile();
+		void Execute(VkCommandBuffer commandBuffer);
+		// Forget this frame's passes and resources, the transient images stay cached
+		void Reset();
+
+		VkImage GetImage(Resource resource) const { return resources[resource].image; }
+		VkImageView GetImageView(Resource resource) const { return resources[resource].view; }
+		VkBuffer GetBuffer(Resource resource) const { return resources[resource].buffer; }
+
+		// Drops the cached framebuffers attached to these views, call before destroying views
+		// that were imported
+		void ReleaseImageViews(const std::vector<VkImageView>& views);
+
+		// Compiled order, culled passes, barriers, transient lifetimes and memory saved by aliasing
+		void Dump(std::ostream& out) const;
+
+	private:
+		struct ResourceUse
+		{
+			Resource resource;
+			VkPipelineStageFlags stages;
+			VkAccessFlags access;
+			VkImageLayout layout;
+			bool read;
+			bool write;
+		};
+
+		struct Attachment
+		{
+			Resource resource = INVALID_RESOURCE;
+			LoadOp loadOp = LoadOp::Clear;
+			VkClearValue clearValue{};
+		};
+
+		struct Pass
+		{
+			std::string name;
+			std::vector<ResourceUse> uses;
+			std::vector<Attachment> colorAttachments;
+			Attachment depthAttachment;
+			bool sideEffect = false;
+			bool culled = false;
+			ExecuteCallback execute;
+
+			// Filled by Compile
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+			std::vector<VkImageMemoryBarrier> imageBarriers;
+			std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		};
+
+		struct ResourceEntry
+		{
+			std::string name;
+			bool isImage = true;
+			bool imported = false;
+			bool output = false;
+			ImageDesc desc{};
+			VkImageAspectFlags aspect = 0;
+			VkImageUsageFlags usage = 0;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags initialStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+			VkAccessFlags initialAccess = 0;
+
+			// Filled by Compile, positions in the compiled order
+			uint32_t firstUse = ~0u;
+			uint32_t lastUse = 0;
+			VkPipelineStageFlags usedStages = 0;
+			VkAccessFlags writeAccess = 0;
+			uint32_t physicalIndex = ~0u;
+		};
+
+		// What a transient image needs, the cached images are reused while these match
+		struct TransientKey
+		{
+			VkFormat format;
+			VkExtent2D extent;
+			VkImageUsageFlags usage;
+			uint32_t firstUse;
+			uint32_t lastUse;
+
+			bool operator==(const TransientKey& other) const;
+		};
+
+		struct PhysicalImage
+		{
+			VkImage image;
+			VkImageView view;
+			VkDeviceSize size;
+			uint32_t block;
+			VkDeviceSize offset;
+			// Transient occupying the same memory before this one, itself when alone
+			uint32_t aliasPredecessor;
+		};
+
+		void OrderPasses();
+		void CullPasses();
+		void ComputeLifetimes();
+		void AllocateTransients();
+		void DestroyTransients();
+		void BuildBarriers();
+		// Dynamic rendering when the device supports it, a cached render pass otherwise
+		void BeginRendering(VkCommandBuffer commandBuffer, const Pass& pass, uint32_t position);
+		void BeginRenderPass(VkCommandBuffer commandBuffer, const Pass& pass, uint32_t position);
+		VkRenderPass GetRenderPass(const Pass& pass, uint32_t position);
+		VkFramebuffer GetFramebuffer(VkRenderPass renderPass, const std::vector<VkImageView>& views, VkExtent2D extent);
+		VkExtent2D GetRenderArea(const Pass& pass) const;
+		VkAttachmentStoreOp GetStoreOp(Resource resource, uint32_t position) const;
+
+		static VkImageAspectFlags GetAspect(VkFormat format);
+
+		Device& device;
+		std::vector<Pass> passes;
+		std::vector<ResourceEntry> resources;
+		std::vector<uint32_t> order;
+		bool compiled = false;
+
+		// Final transitions of imported images, recorded after the last pass
+		VkPipelineStageFlags finalSrcStages = 0;
+		std::vector<VkImageMemoryBarrier> finalBarriers;
+
+		std::vector<TransientKey> transientKeys;
+		std::vector<PhysicalImage> physicalImages;
+		std::vector<VkDeviceMemory> memoryBlocks;
+		VkDeviceSize aliasedBytes = 0;
+		VkDeviceSize unaliasedBytes = 0;
+
+		// Compatible render passes only depend on formats and load operations, they are kept.
+		// Unused with dynamic rendering.
+		std::map<std::vector<uint64_t>, VkRenderPass> renderPasses;
+
+		// Keyed by render pass, attachment views and extent, released with their views
+		struct CachedFramebuffer
+		{
+			VkFramebuffer framebuffer;
+			std::vector<VkImageView> views;
+		};
+		std::map<std::vector<uint64_t>, CachedFramebuffer> framebuffers;
+	};
+}
@@ -2,6 +2,9 @@
 #include "Pipline.h"
 #include "Device.h"
 #include "GameObject.h"
+#include "BindlessDescriptors.h"
+#include "SpatialIndex.h"
+#include "InstanceBuffer.h"
 
 #include <memory>
 #include <vector>
@@ -11,20 +14,32 @@ namespace Application
 	class RenderSystem
 	{
 	public:
-		RenderSystem(Device& device, VkRenderPass renderPass);
+		// With bindless descriptors objects are drawn with their texture index, without a rebind per texture.
+		// Only models created with vertexLayout can be drawn.
+		RenderSystem(Device& device, const RenderTargetInfo& target, BindlessDescriptors* bindless = nullptr,
+			const Model::VertexLayout& vertexLayout = Model::VertexLayout::Full());
 		~RenderSystem();
 
 		RenderSystem(const RenderSystem&) = delete;
 		RenderSystem& operator=(const RenderSystem&) = delete;
 
-		void RenderGameObjects(VkCommandBuffer commandBuffer, std::vector<GameObject> &gameObjects);
+		// Objects are drawn with the instance of their pool slot. With a spatial index only the
+		// objects it finds on screen are drawn.
+		void RenderGameObjects(VkCommandBuffer commandBuffer, const GameObjectPool& gameObjects,
+			const ModelPool& models, const InstanceBuffer& instances, const SpatialIndex* cullIndex = nullptr);
 	private:
 		void CreatePipelineLayout();
-		void CreatePipeline(VkRenderPass renderPass);
+		void CreatePipeline(const RenderTargetInfo& target);
 
 
 		Device& device;
+		BindlessDescriptors* bindless;
+		Model::VertexLayout vertexLayout;
 		std::unique_ptr<Pipeline> pipeline;
 		VkPipelineLayout pipelineLayout;
+
+		// Reused between frames
+		std::vector<SpatialIndex::Id> visibleIds;
+		std::vector<uint8_t> visible;
 	};
 }
\ No newline at end of file
@@ -2,23 +2,75 @@
 #include "window.h"
 #include "Device.h"
 #include "SwapChain.h"
+#include "Descriptors.h"
+#include "RenderGraph.h"
+#include "Pipline.h"
+#include "AsyncCompute.h"
 
 #include <memory>
 #include <cassert>
+#include <chrono>
+#include <deque>
 
 namespace Application
 {
 	class Renderer
 	{
 	public:
-		Renderer(Device& device, Window& window);
+		// Time spent recreating the swap chain, the hitch a resize adds to the frame
+		struct SwapChainRecreateStats
+		{
+			uint32_t count = 0;
+			double lastMs = 0.0;
+			double maxMs = 0.0;
+			double totalMs = 0.0;
+		};
+
+		// Frame pacing and latency since the last settings change
+		struct FrameStats
+		{
+			uint64_t frameCount = 0;
+			double meanFrameMs = 0.0;
+			// Sum of squared differences from the mean frame time
+			double frameM2 = 0.0;
+			// From sampling input to the image being displayed with present wait, to the GPU
+			// finishing the frame otherwise
+			bool latencyToDisplay = false;
+			uint64_t latencyCount = 0;
+			double meanLatencyMs = 0.0;
+			double maxLatencyMs = 0.0;
+
+			double GetFrameTimeVariance() const { return frameCount > 1 ? frameM2 / (frameCount - 1) : 0.0; }
+		};
+
+		Renderer(Device& device, Window& window, const SwapChainSettings& settings = {});
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		
+		// Null with dynamic rendering
 		VkRenderPass GetSwapChainRenderPass() const { return swapChain->GetRenderPass(); }
+		RenderTargetInfo GetSwapChainRenderTarget() const
+		{
+			return { swapChain->GetRenderPass(), { swapChain->GetSwapChainImageFormat() }, swapChain->GetSwapChainDepthFormat() };
+		}
+		VkFormat GetSwapChainDepthFormat() const { return swapChain->GetSwapChainDepthFormat(); }
+		VkExtent2D GetSwapChainExtent() const { return swapChain->GetSwapChainExtent(); }
+		DescriptorAllocator& GetDescriptorAllocator() { return descriptorAllocator; }
+		AsyncCompute& GetAsyncCompute() { return asyncCompute; }
 		bool IsFrameInProgress() const { return isFrameStarted; }
+		const SwapChainRecreateStats& GetSwapChainRecreateStats() const { return recreateStats; }
+		const FrameStats& GetFrameStats() const { return frameStats; }
+		const SwapChainSettings& GetSwapChainSettings() const { return swapChainSettings; }
+		void SetSwapChainSettings(const SwapChainSettings& settings);
+		bool WaitForPresent(uint32_t maxQueuedPresents, uint64_t timeoutNs)
+		{
+			return swapChain->WaitForPresent(maxQueuedPresents, timeoutNs);
+		}
+		uint64_t GetRefreshDurationNs() const { return swapChain->GetRefreshDurationNs(); }
+		// Prints the frame stats gathered so far and starts a new measurement
+		void ReportFrameStats();
 		VkCommandBuffer getCurrentCommandBuffer() const
 		{
 			assert(isFrameStarted && "Cannot get frame buffer if frame isn't started");
@@ -32,19 +84,40 @@ namespace Application
 
 		VkCommandBuffer BeginFrame();
 		void EndFrame();
-		void BeginSwapChainRenderPass(VkCommandBuffer commandBuffer);
-		void EndSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// The acquired swap chain image as a graph output, left ready to present
+		RenderGraph::Resource ImportSwapChainImage(RenderGraph& graph);
+		// The depth image of the current frame slot, its content doesn't outlive the frame
+		RenderGraph::Resource ImportSwapChainDepth(RenderGraph& graph);
 
 	private:
 		void CreateCommandBuffers();
 		void FreeCommandBuffers();
 		void RecreateSwapChain();
+		void RecordFrameStats(std::chrono::high_resolution_clock::time_point frameStart);
 
 		Window& window;
 		Device& device;
 		std::unique_ptr<SwapChain> swapChain;
+		DescriptorAllocator descriptorAllocator{ device };
+		AsyncCompute asyncCompute{ device };
 
 		std::vector<VkCommandBuffer> commandBuffers;
+		SwapChainRecreateStats recreateStats;
+		SwapChainSettings swapChainSettings;
+		bool swapChainSettingsChanged = false;
+		// Views of retired swap chains the render graph may still have framebuffers for
+		std::vector<VkImageView> retiredImageViews;
+
+		struct PendingLatency
+		{
+			uint64_t frame;
+			std::chrono::high_resolution_clock::time_point inputTime;
+		};
+		FrameStats frameStats;
+		std::deque<PendingLatency> pendingLatencies;
+		std::chrono::high_resolution_clock::time_point frameInputTime;
+		std::chrono::high_resolution_clock::time_point lastFrameStart;
+		bool hasLastFrameStart = false;
 
 		bool isFrameStarted = false;
 		int currentFrameIndex = 0;
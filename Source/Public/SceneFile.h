@@ -0,0 +1,95 @@
+#pragma once
+#include "GameObject.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace Application
+{
+	// Binary scene: a header followed by flat little-endian arrays, one per component, indexed
+	// by object. Sections are addressed by their offset from the start of the file, so the file
+	// is used in place once mapped, nothing is parsed per object. Models are referenced by
+	// index in a table of names the application resolves to its own models.
+	class SceneFile
+	{
+	public:
+		static constexpr uint32_t VERSION = 1;
+		// Objects without a model
+		static constexpr uint32_t NO_MODEL = ~0u;
+
+		// Model names and the handles they stand for, the file stores indices in this table
+		using ModelTable = std::vector<std::pair<std::string, Handle<Model>>>;
+
+		// Maps the file and checks its header and section bounds, throws if they don't match
+		SceneFile(const std::string& filepath);
+
+		uint32_t GetObjectCount() const { return header->objectCount; }
+		uint32_t GetModelCount() const { return header->modelCount; }
+		std::string GetModelName(uint32_t model) const;
+
+		// Point into the mapped file, valid for the lifetime of this object
+		const glm::vec2* GetTranslations() const { return Section<glm::vec2>(TRANSLATIONS); }
+		const float* GetRotations() const { return Section<float>(ROTATIONS); }
+		const glm::vec2* GetScales() const { return Section<glm::vec2>(SCALES); }
+		const glm::vec3* GetColors() const { return Section<glm::vec3>(COLORS); }
+		const uint32_t* GetTextureIndices() const { return Section<uint32_t>(TEXTURE_INDICES); }
+		const uint32_t* GetModelIndices() const { return Section<uint32_t>(MODEL_INDICES); }
+
+		// Creates the objects in gameObjects, models[i] is the handle of model i of the file
+		void Instantiate(GameObjectPool& gameObjects, const std::vector<Handle<Model>>& models) const;
+
+		// Writes every object of gameObjects, models missing from modelTable are written as NO_MODEL
+		static void Write(const std::string& filepath, const GameObjectPool& gameObjects, const ModelTable& modelTable);
+
+		// 1M objects: write, map and instantiate times against a text format
+		static void RunBenchmark();
+
+	private:
+		enum SectionIndex : uint32_t
+		{
+			MODEL_NAMES,
+			STRINGS,
+			TRANSLATIONS,
+			ROTATIONS,
+			SCALES,
+			COLORS,
+			TEXTURE_INDICES,
+			MODEL_INDICES,
+			SECTION_COUNT
+		};
+
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			// 0x01020304 as written by a little-endian machine
+			uint32_t byteOrder;
+			uint32_t objectCount;
+			uint32_t modelCount;
+			uint32_t reserved;
+			uint64_t fileSize;
+			// From the start of the file, 16 byte aligned
+			uint64_t sectionOffsets[SECTION_COUNT];
+			uint64_t sectionSizes[SECTION_COUNT];
+		};
+
+		// Offset and length of a name in the strings section
+		struct ModelName
+		{
+			uint32_t offset;
+			uint32_t length;
+		};
+
+		template<typename T>
+		const T* Section(SectionIndex section) const
+		{
+			return reinterpret_cast<const T*>(file.GetData() + header->sectionOffsets[section]);
+		}
+
+		MappedFile file;
+		const Header* header;
+	};
+}
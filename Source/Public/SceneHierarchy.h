@@ -0,0 +1,129 @@
+#pragma once
+#include "GameObject.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+namespace Application
+{
+	// 2D affine transform composed with its ancestors'
+	struct WorldTransform2d
+	{
+		glm::mat2 matrix{ 1.0f };
+		glm::vec2 translation{ 0.0f };
+
+		glm::vec2 Apply(glm::vec2 point) const { return matrix * point + translation; }
+
+		static WorldTransform2d FromLocal(const Transform2dComponent& local) { return { local.mat2(), local.GetTranslation() }; }
+	};
+
+	// Parent / child transforms stored breadth first: the nodes are sorted by depth, a level's
+	// nodes are contiguous and come after their parents' level. World transforms are computed
+	// one level at a time with a linear walk over the arrays, the nodes of a level in
+	// parallel, instead of recursing through child pointers. Structural changes only mark the
+	// order dirty, it is rebuilt once by the next Update.
+	//
+	// Game objects join it with Attach, their transform2d is then relative to the parent
+	// object and their world transform, which the instance buffer and the spatial index use,
+	// comes from Update. Nodes point to their objects, which never move in their pool, and an
+	// object leaves the hierarchy when it is destroyed.
+	class SceneHierarchy
+	{
+	public:
+		using NodeId = uint32_t;
+		static constexpr NodeId INVALID_NODE = ~0u;
+
+		SceneHierarchy() = default;
+		// Detaches the objects still attached
+		~SceneHierarchy();
+
+		SceneHierarchy(const SceneHierarchy&) = delete;
+		SceneHierarchy& operator=(const SceneHierarchy&) = delete;
+
+		NodeId AddNode(NodeId parent = INVALID_NODE);
+		// Removed with its subtree at the next Update, its descendants' ids are invalid from then
+		// on. The objects of the subtree are detached right away.
+		void RemoveNode(NodeId node);
+		// Throws if parent is node or one of its descendants
+		void SetParent(NodeId node, NodeId parent);
+		NodeId GetParent(NodeId node) const { return nodes[node].parent; }
+
+		Transform2dComponent& GetLocal(NodeId node) { return locals[nodes[node].index]; }
+		const Transform2dComponent& GetLocal(NodeId node) const { return locals[nodes[node].index]; }
+		// As of the last Update, the identity for nodes added since
+		const WorldTransform2d& GetWorld(NodeId node) const { return worlds[nodes[node].index]; }
+		// False once the node is removed by an Update, its id may be reused from then on
+		bool IsValid(NodeId node) const { return node < nodes.size() && nodes[node].index != NOT_SORTED; }
+		// The world transform differs from the one before the last Update
+		bool IsWorldChanged(NodeId node) const { return worldChanged[nodes[node].index] != 0; }
+
+		// Gives object a node under parent's, or moves it there, a parent without a node
+		// becomes a root first. Without parent the object becomes a root.
+		void Attach(GameObject& object, GameObject* parent = nullptr);
+		// Removes the object's node with its subtree, the object and the descendants' objects
+		// are detached and use their own transform2d again
+		void Detach(GameObject& object);
+		// The object's world transform, its own transform2d when it has no node
+		WorldTransform2d GetWorld(const GameObject& object) const
+		{
+			return object.hierarchyNode == INVALID_NODE || !IsValid(object.hierarchyNode) ?
+				WorldTransform2d::FromLocal(object.transform2d) : GetWorld(object.hierarchyNode);
+		}
+		// Copies the transform2d of the attached objects that changed into their nodes, call
+		// before Update
+		void SyncLocals();
+		// Attached objects whose world transform the last Update changed, and the objects
+		// detached since the Update before
+		const std::vector<GameObject::id_t>& GetChangedObjects() const { return changedObjects; }
+
+		// Rebuilds the order if the structure changed and recomputes every world transform,
+		// the levels wide enough are split across the pool's threads
+		void Update(ThreadPool* threadPool = nullptr);
+
+		size_t GetNodeCount() const { return order.size(); }
+		uint32_t GetLevelCount() const { return levelStarts.empty() ? 0 : static_cast<uint32_t>(levelStarts.size() - 1); }
+
+		// Deep and wide trees of 1M nodes: recursive pointer walk against the level sorted
+		// arrays on one thread and on a thread pool
+		static void RunBenchmark();
+
+	private:
+		static constexpr uint32_t NOT_SORTED = ~0u;
+
+		struct Node
+		{
+			NodeId parent = INVALID_NODE;
+			// Position in the sorted arrays
+			uint32_t index = NOT_SORTED;
+			bool alive = false;
+			// Attached object and the version of its transform2d last copied into the local
+			GameObject* object = nullptr;
+			uint32_t objectVersion = ~0u;
+		};
+
+		void ReleaseObject(Node& node);
+		void RebuildOrder();
+		void UpdateLevel(uint32_t begin, uint32_t end);
+
+		// By id
+		std::vector<Node> nodes;
+		std::vector<NodeId> freeIds;
+
+		// Breadth first, by depth
+		std::vector<NodeId> order;
+		std::vector<uint32_t> parentIndices;
+		std::vector<Transform2dComponent> locals;
+		std::vector<WorldTransform2d> worlds;
+		// Local versions the worlds were computed from, and whether the last Update changed them
+		std::vector<uint32_t> localVersions;
+		std::vector<uint8_t> worldChanged;
+		// First index of every level, and the node count at the end
+		std::vector<uint32_t> levelStarts;
+		bool orderDirty = false;
+		// Every world counts as changed after a rebuild
+		bool orderRebuilt = false;
+		std::vector<GameObject::id_t> changedObjects;
+		// Detached since the last Update, their world transform is their transform2d now
+		std::vector<GameObject::id_t> releasedObjects;
+	};
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include "GameObject.h"
+#include "SceneHierarchy.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace Application
+{
+	struct Aabb2d
+	{
+		glm::vec2 min;
+		glm::vec2 max;
+
+		glm::vec2 Center() const { return (min + max) * 0.5f; }
+		glm::vec2 Size() const { return max - min; }
+		bool Intersects(const Aabb2d& other) const
+		{
+			return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y;
+		}
+		bool Contains(const Aabb2d& other) const
+		{
+			return min.x <= other.min.x && max.x >= other.max.x && min.y <= other.min.y && max.y >= other.max.y;
+		}
+	};
+
+	// 2D broadphase over object bounds, for culling and gameplay queries. Objects are
+	// identified by their GameObject id and updated one by one when they move, an update that
+	// doesn't change the cell the object is stored in only writes its new bounds.
+	class SpatialIndex
+	{
+	public:
+		using Id = GameObject::id_t;
+
+		virtual ~SpatialIndex() = default;
+
+		// Inserts the object or moves it
+		virtual void Update(Id id, const Aabb2d& bounds) = 0;
+		virtual void Remove(Id id) = 0;
+		// Appends the ids of the objects whose bounds overlap rect, each one once
+		virtual void QueryRect(const Aabb2d& rect, std::vector<Id>& results) const = 0;
+		virtual bool Contains(Id id) const = 0;
+		virtual const Aabb2d& GetBounds(Id id) const = 0;
+		virtual size_t GetCount() const = 0;
+
+		// Appends the ids of the objects whose bounds overlap the circle
+		void QueryRadius(glm::vec2 center, float radius, std::vector<Id>& results) const;
+
+		// Adds a created object, objects are the [-0.5, 0.5] model square. A destroyed object
+		// is taken out with Remove before its slot is reused.
+		void Insert(const GameObject& object, const SceneHierarchy* hierarchy = nullptr);
+		// Moves the inserted objects listed in changes and the ones the last Update of hierarchy
+		// moved, only those are visited. Objects attached to hierarchy are placed with its world
+		// transforms, call after its Update and before changes is cleared.
+		void Sync(const GameObjectPool& gameObjects, const TransformChangeList& changes,
+			const SceneHierarchy* hierarchy = nullptr);
+		static Aabb2d BoundsOf(const Transform2dComponent& transform);
+		static Aabb2d BoundsOf(const WorldTransform2d& transform);
+		static Aabb2d BoundsOf(const GameObject& object, const SceneHierarchy* hierarchy);
+
+		// 1M moving objects: update cost and rect / radius query times of both indices, and
+		// Sync with a few of them moving
+		static void RunBenchmark();
+	};
+
+	// Uniform grid hashed into a fixed number of buckets, for dense scenes of similar sized
+	// objects. An object is stored once, in the cell of its center, queries look one half cell
+	// further. Objects larger than a cell are kept in a list every query checks.
+	class SpatialHashGrid : public SpatialIndex
+	{
+	public:
+		SpatialHashGrid(float cellSize, uint32_t bucketCount = 1 << 16);
+
+		void Update(Id id, const Aabb2d& bounds) override;
+		void Remove(Id id) override;
+		void QueryRect(const Aabb2d& rect, std::vector<Id>& results) const override;
+		bool Contains(Id id) const override { return id < entries.size() && entries[id].bucket != NOT_PRESENT; }
+		const Aabb2d& GetBounds(Id id) const override { return entries[id].bounds; }
+		size_t GetCount() const override { return count; }
+
+	private:
+		static constexpr uint32_t NOT_PRESENT = ~0u;
+
+		struct Entry
+		{
+			Aabb2d bounds;
+			glm::ivec2 cell;
+			uint32_t bucket = NOT_PRESENT;
+			// Position in the bucket
+			uint32_t slot;
+		};
+
+		glm::ivec2 CellOf(glm::vec2 position) const;
+		uint32_t BucketOf(glm::ivec2 cell) const;
+		void RemoveFromBucket(Id id);
+
+		float cellSize;
+		float inverseCellSize;
+		uint32_t bucketMask;
+		// The last bucket holds the objects larger than a cell
+		std::vector<std::vector<Id>> buckets;
+		uint32_t oversizedBucket;
+		std::vector<Entry> entries;
+		size_t count = 0;
+	};
+
+	// Loose quadtree with nodes twice the size of their cell, for sparse scenes and objects of
+	// very different sizes. An object goes to the deepest level its size fits in, in the node
+	// holding its center, so inserting never walks the tree. Only nodes with objects in their
+	// subtree exist, objects outside the world bounds are kept at the root.
+	class LooseQuadtree : public SpatialIndex
+	{
+	public:
+		LooseQuadtree(const Aabb2d& worldBounds, uint32_t maxDepth = 10);
+
+		void Update(Id id, const Aabb2d& bounds) override;
+		void Remove(Id id) override;
+		void QueryRect(const Aabb2d& rect, std::vector<Id>& results) const override;
+		bool Contains(Id id) const override { return id < entries.size() && entries[id].node != NOT_PRESENT; }
+		const Aabb2d& GetBounds(Id id) const override { return entries[id].bounds; }
+		size_t GetCount() const override { return count; }
+
+	private:
+		static constexpr uint64_t NOT_PRESENT = ~0ull;
+		static constexpr uint32_t MAX_DEPTH = 28;
+
+		struct Entry
+		{
+			Aabb2d bounds;
+			uint64_t node = NOT_PRESENT;
+			// Position in the node's objects
+			uint32_t slot;
+		};
+
+		struct Node
+		{
+			std::vector<Id> objects;
+			// Objects in this node and below, the node is removed when it drops to zero
+			uint32_t subtreeCount = 0;
+		};
+
+		static uint64_t MakeKey(uint32_t level, uint32_t x, uint32_t y)
+		{
+			return static_cast<uint64_t>(level) << 58 | static_cast<uint64_t>(x) << 29 | y;
+		}
+		static uint64_t ParentKey(uint64_t key);
+
+		uint64_t NodeOf(const Aabb2d& bounds) const;
+		void QueryNode(uint32_t level, uint32_t x, uint32_t y, const Aabb2d& rect, std::vector<Id>& results) const;
+
+		Aabb2d worldBounds;
+		float worldSize;
+		uint32_t maxDepth;
+		std::unordered_map<uint64_t, Node> nodes;
+		std::vector<Entry> entries;
+		size_t count = 0;
+	};
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "Device.h"
+#include "Pipline.h"
+#include "FrameRingBuffer.h"
+#include "BindlessDescriptors.h"
+
+#include <memory>
+#include <vector>
+#include <array>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace Application
+{
+	// Draws many 2D sprites with a few indexed draws. Quads are written straight into a
+	// persistently mapped per-frame vertex region and drawn with a shared quad index buffer,
+	// consecutive sprites with the same texture and blend mode end up in one draw. Sprites
+	// are drawn in submission order.
+	class SpriteBatcher
+	{
+	public:
+		enum class BlendMode { Alpha, Additive, Count };
+
+		struct Sprite
+		{
+			// Center, in clip space like the rest of the 2D scene
+			glm::vec2 position{ 0.0f };
+			glm::vec2 size{ 0.1f };
+			float rotation = 0.0f;
+			glm::vec2 uvMin{ 0.0f };
+			glm::vec2 uvMax{ 1.0f };
+			glm::vec4 color{ 1.0f };
+			// Bindless texture index, untextured with INVALID_INDEX or without bindless support
+			uint32_t textureIndex = BindlessDescriptors::INVALID_INDEX;
+			BlendMode blendMode = BlendMode::Alpha;
+		};
+
+		// Since the last Begin
+		struct Stats
+		{
+			uint32_t spriteCount = 0;
+			uint32_t batchCount = 0;
+			// Time spent in Draw writing vertices
+			double writeMs = 0.0;
+
+			double GetSpritesPerMs() const { return writeMs > 0.0 ? spriteCount / writeMs : 0.0; }
+		};
+
+		static constexpr uint32_t MAX_SPRITES_PER_FRAME = 100'000;
+
+		SpriteBatcher(Device& device, const RenderTargetInfo& target, BindlessDescriptors* bindless = nullptr);
+		~SpriteBatcher();
+
+		SpriteBatcher(const SpriteBatcher&) = delete;
+		SpriteBatcher& operator=(const SpriteBatcher&) = delete;
+
+		// Starts writing in frameIndex's region, its previous frame must have completed
+		void Begin(int frameIndex);
+		void Draw(const Sprite& sprite);
+		void Draw(const Sprite* sprites, size_t count);
+		// Records the batches drawn since Begin
+		void Render(VkCommandBuffer commandBuffer);
+
+		const Stats& GetStats() const { return stats; }
+
+		// Vertex write throughput and batch counts for 10k and 100k sprites, printed to the console
+		static void RunBenchmark(Device& device, const RenderTargetInfo& target, BindlessDescriptors* bindless);
+
+	private:
+		struct Vertex
+		{
+			glm::vec2 position;
+			glm::vec2 uv;
+			// RGBA8 unorm
+			uint32_t color;
+
+			static std::vector<VkVertexInputBindingDescription> GetBindingDescriptions();
+			static std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions();
+		};
+
+		struct Batch
+		{
+			uint32_t firstSprite;
+			uint32_t spriteCount;
+			uint32_t textureIndex;
+			BlendMode blendMode;
+		};
+
+		void CreateIndexBuffer();
+		void CreatePipelineLayout();
+		void CreatePipelines(const RenderTargetInfo& target);
+		void WriteSprite(const Sprite& sprite, Vertex* vertices);
+
+		static uint32_t PackColor(const glm::vec4& color);
+
+		Device& device;
+		BindlessDescriptors* bindless;
+		VkPipelineLayout pipelineLayout;
+		std::array<std::unique_ptr<Pipeline>, static_cast<size_t>(BlendMode::Count)> pipelines;
+
+		// Quad indices shared by every frame, sprite i uses vertices 4i to 4i + 3
+		VkBuffer indexBuffer;
+		VkDeviceMemory indexBufferMemory;
+		uint64_t indexUploadTicket;
+
+		FrameRingBuffer vertexRing;
+		Vertex* vertices = nullptr;
+		uint32_t vertexOffset = 0;
+		std::vector<Batch> batches;
+		Stats stats;
+	};
+}
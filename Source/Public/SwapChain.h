@@ -10,27 +10,59 @@
 
 namespace Application {
 
+    // What the present mode is chosen for, falls back to FIFO (always supported) when the
+    // preferred modes are missing
+    enum class PresentPolicy
+    {
+        LowestLatency,  // Mailbox, else immediate: newest frame shown at the next vblank, no tearing
+        VSync,          // FIFO: one frame per vblank, the queue of frames adds latency
+        Uncapped,       // Immediate, else mailbox: maximum throughput, may tear
+        Adaptive        // FIFO relaxed: vsync, tears instead of stuttering when a frame is late
+    };
+
+    struct SwapChainSettings
+    {
+        PresentPolicy presentPolicy = PresentPolicy::LowestLatency;
+        // Frames the CPU may record ahead of the GPU, between 1 and SwapChain::MAX_FRAMES_IN_FLIGHT
+        uint32_t framesInFlight = 2;
+    };
+
     class SwapChain 
     {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+        // Upper bound for SwapChainSettings::framesInFlight, per-frame resources are sized for it
+        static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
 
-        SwapChain(Device& deviceRef, VkExtent2D windowExtent);
-        SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
+        SwapChain(Device& deviceRef, VkExtent2D windowExtent, const SwapChainSettings& settings = {});
+        SwapChain(
+            Device& deviceRef,
+            VkExtent2D windowExtent,
+            std::shared_ptr<SwapChain> previous,
+            const SwapChainSettings& settings = {});
 
         ~SwapChain();
 
         SwapChain(const SwapChain&) = delete;
         SwapChain& operator=(const SwapChain&) = delete;
 
-        VkFramebuffer GetFrameBuffer(int index) { return swapChainFramebuffers[index]; }
+        // Null with dynamic rendering. Only for pipeline compatibility, the render graph begins
+        // the passes with its own render passes and framebuffers.
         VkRenderPass GetRenderPass() { return renderPass; }
+        VkImage GetImage(int index) { return swapChainImages[index]; }
         VkImageView GetImageView(int index) { return swapChainImageViews[index]; }
         size_t GetImageCount() { return swapChainImages.size(); }
         VkFormat GetSwapChainImageFormat() { return swapChainImageFormat; }
         VkExtent2D GetSwapChainExtent() { return swapChainExtent; }
+        VkFormat GetSwapChainDepthFormat() { return swapChainDepthFormat; }
+        VkImage GetDepthImage(int frameIndex) { return depthImages[frameIndex]; }
+        VkImageView GetDepthImageView(int frameIndex) { return depthImageViews[frameIndex]; }
+        size_t GetDepthImageCount() { return depthImages.size(); }
         uint32_t GetWidth() { return swapChainExtent.width; }
         uint32_t GetHeight() { return swapChainExtent.height; }
+        const SwapChainSettings& GetSettings() const { return settings; }
+        VkPresentModeKHR GetPresentMode() const { return presentMode; }
+        // Frame slot used by the next AcquireNextImage/SubmitCommandBuffers pair
+        uint32_t GetCurrentFrame() const { return static_cast<uint32_t>(currentFrame); }
 
         float ExtentAspectRatio()
         {
@@ -41,19 +73,33 @@ namespace Application {
         VkResult AcquireNextImage(uint32_t* imageIndex);
         VkResult SubmitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
 
+        // Blocks until no more than maxQueuedPresents presents of this swap chain are waiting
+        // to be displayed, returns false when present wait is unavailable
+        bool WaitForPresent(uint32_t maxQueuedPresents, uint64_t timeoutNs);
+        // Present ids are only known with present wait and only for presents of this swap chain
+        bool CanPollPresent(uint64_t presentId) const
+        {
+            return waitForPresent != nullptr && firstPresentId != 0 && presentId >= firstPresentId;
+        }
+        // VK_SUCCESS once the present with this id is displayed, VK_TIMEOUT before, never blocks
+        VkResult PollPresent(uint64_t presentId);
+        // Display refresh period from VK_GOOGLE_display_timing, 0 when unknown
+        uint64_t GetRefreshDurationNs() const { return refreshDurationNs; }
+
         bool CompareSwapFormats(const SwapChain& swapChain) const
         {
             return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
                 swapChain.swapChainImageFormat == swapChainImageFormat;
         }
 
+        static const char* GetPresentPolicyName(PresentPolicy policy);
+
     private:
         void Init();
         void CreateSwapChain();
         void CreateImageViews();
         void CreateDepthResources();
         void CreateRenderPass();
-        void CreateFramebuffers();
         void CreateSyncObjects();
 
         // Helper functions
@@ -67,9 +113,10 @@ namespace Application {
         VkFormat swapChainDepthFormat;
         VkExtent2D swapChainExtent;
 
-        std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkRenderPass renderPass;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
 
+        // Allocated size of the depth images, may be larger than the swap chain extent
+        VkExtent2D depthExtent;
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
         std::vector<VkImageView> depthImageViews;
@@ -78,15 +125,24 @@ namespace Application {
         
         Device& device;
         VkExtent2D windowExtent;
+        SwapChainSettings settings;
+        VkPresentModeKHR presentMode;
 
         VkSwapchainKHR swapChain;
         std::shared_ptr<SwapChain> oldSwapChain;
 
         std::vector<VkSemaphore> imageAvailableSemaphores;
         std::vector<VkSemaphore> renderFinishedSemaphores;
-        std::vector<VkFence> inFlightFences;
-        std::vector<VkFence> imagesInFlight;
+        // Device frame timeline values last signaled by each frame slot and each image
+        std::vector<uint64_t> inFlightFrames;
+        std::vector<uint64_t> imagesInFlight;
         size_t currentFrame = 0;
+
+        // Present ids are the frame timeline values, they only increase across swap chains
+        uint64_t firstPresentId = 0;
+        uint64_t lastPresentId = 0;
+        PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+        uint64_t refreshDurationNs = 0;
     };
 
 }
@@ -0,0 +1,62 @@
+#pragma once
+#include "Device.h"
+#include "Ktx2.h"
+
+#include <string>
+#include <vector>
+
+namespace Application
+{
+	class Texture
+	{
+	public:
+		// Load a KTX2 texture, block compressed data is uploaded as is when the device supports it.
+		// The levels are copied on the transfer queue, the texture can't be sampled before IsReady.
+		Texture(Device& device, const std::string& filepath);
+		~Texture();
+
+		Texture(const Texture&) = delete;
+		Texture& operator=(const Texture&) = delete;
+
+		// False until the upload has reached the graphics queue, for good when it failed
+		// (Uploader::GetError). Register the descriptor in a bindless slot once it is true.
+		bool IsReady() const;
+
+		VkImageView GetImageView() const { return imageView; }
+		VkSampler GetSampler() const { return sampler; }
+		VkFormat GetFormat() const { return format; }
+		uint32_t GetWidth() const { return width; }
+		uint32_t GetHeight() const { return height; }
+		uint32_t GetMipLevels() const { return mipLevels; }
+		VkDeviceSize GetSizeInBytes() const { return sizeInBytes; }
+		VkDescriptorImageInfo GetDescriptorInfo() const
+		{
+			return { sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		}
+
+		// Pick the format the file will be uploaded as, may differ from the file format when
+		// the data has to be transcoded or decoded on the CPU
+		static VkFormat ChooseUploadFormat(Device& device, const Ktx2File& file);
+
+	private:
+		std::vector<std::vector<uint8_t>> LoadLevels(const Ktx2File& file);
+		std::vector<std::vector<uint8_t>> TranscodeLevels(const Ktx2File& file);
+		void CreateImage(const std::vector<std::vector<uint8_t>>& levels);
+		void CreateImageView();
+		void CreateSampler();
+
+		Device& device;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+		VkImageView imageView = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		uint64_t uploadTicket = 0;
+
+		VkFormat format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		VkDeviceSize sizeInBytes = 0;
+	};
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "Device.h"
+#include "Ktx2.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace Application
+{
+	// Keeps only the mip levels that are needed on screen resident. The small mip tail is
+	// loaded when the texture is registered, larger levels are read from disk on a worker
+	// thread when RequestSize asks for them and least recently used levels are dropped when
+	// the resident size goes over the memory budget. Images are rebuilt with the new level
+	// range in the frame's command buffer, the replaced ones are destroyed once their frames
+	// retire, so streaming never waits for the GPU.
+	class TextureStreamer
+	{
+	public:
+		using Handle = uint32_t;
+
+		// Levels at or below this size are always resident
+		static constexpr uint32_t MIP_TAIL_SIZE = 64;
+
+		// A budget of 0 uses a quarter of the device local memory budget reported by Device
+		TextureStreamer(Device& device, VkDeviceSize memoryBudget = 0);
+		~TextureStreamer();
+
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		Handle Load(const std::string& filepath);
+
+		// Tell the streamer how many pixels the texture covers on screen this frame
+		void RequestSize(Handle handle, float screenWidth, float screenHeight);
+
+		// Upload finished reads, evict over budget and queue new reads, call once per frame
+		// before any render pass of commandBuffer
+		void Update(VkCommandBuffer commandBuffer);
+
+		// The image view changes when levels are streamed in or out, fetch it every frame. Null
+		// until the Update after Load.
+		VkDescriptorImageInfo GetDescriptorInfo(Handle handle) const;
+		uint32_t GetResidentMip(Handle handle) const { return textures[handle]->residentMip; }
+		VkDeviceSize GetResidentBytes() const { return residentBytes; }
+		VkDeviceSize GetMemoryBudget() const { return memoryBudget; }
+
+	private:
+		struct StreamedTexture
+		{
+			std::unique_ptr<Ktx2File> file;
+			VkFormat format;
+			uint32_t tailMip;
+			uint32_t residentMip;
+			uint32_t requestedMip;
+			uint64_t lastUsedFrame = 0;
+			bool loadPending = false;
+
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+			VkImageView imageView = VK_NULL_HANDLE;
+			VkDeviceSize residentSize = 0;
+		};
+
+		struct LoadRequest
+		{
+			Handle handle;
+			uint32_t firstMip;
+			uint32_t lastMip;
+		};
+
+		struct LoadResult
+		{
+			Handle handle;
+			uint32_t firstMip;
+			std::vector<std::vector<uint8_t>> levels;
+		};
+
+		void WorkerLoop();
+		std::vector<std::vector<uint8_t>> ReadLevels(const StreamedTexture& texture, uint32_t firstMip, uint32_t lastMip);
+		// Recreate the texture image with levels [newResidentMip, mipCount), keeping the levels
+		// that are already on the GPU and copying the new ones from stagingBuffer with uploads
+		void Rebuild(VkCommandBuffer commandBuffer, StreamedTexture& texture, uint32_t newResidentMip,
+			VkBuffer stagingBuffer, const std::vector<VkBufferImageCopy>& uploads);
+		// Drops levels until the budget is met, every texture is rebuilt once however many it loses
+		void EvictOverBudget(VkCommandBuffer commandBuffer);
+		void CreateSampler();
+
+		Device& device;
+		VkDeviceSize memoryBudget;
+		VkDeviceSize residentBytes = 0;
+		uint64_t currentFrame = 0;
+		VkSampler sampler;
+
+		std::vector<std::unique_ptr<StreamedTexture>> textures;
+
+		std::thread worker;
+		std::mutex queueMutex;
+		std::condition_variable queueCondition;
+		std::deque<LoadRequest> requests;
+		std::vector<LoadResult> results;
+		bool stopWorker = false;
+	};
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace Application
+{
+	// Worker threads for data parallel loops. ParallelFor splits a range in batches the workers
+	// and the calling thread take from a shared counter, it returns once every batch ran. Loops
+	// too small to be worth waking the workers run on the calling thread.
+	class ThreadPool
+	{
+	public:
+		using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+		// Without a count, one worker per hardware thread besides the calling one
+		explicit ThreadPool(uint32_t workerCount = DefaultWorkerCount());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Calls function over [0, count) in batches of at least minBatch elements. Called from
+		// one thread at a time.
+		void ParallelFor(uint32_t count, uint32_t minBatch, const RangeFunction& function);
+
+		uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+		static uint32_t DefaultWorkerCount();
+
+	private:
+		void WorkerLoop();
+		void RunBatches();
+
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wakeCondition;
+		std::condition_variable doneCondition;
+		bool stopping = false;
+		// Bumped for every loop, workers run each one once
+		uint64_t generation = 0;
+		uint32_t activeWorkers = 0;
+
+		// Current loop
+		const RangeFunction* function = nullptr;
+		uint32_t count = 0;
+		uint32_t batchSize = 0;
+		uint32_t batchCount = 0;
+		std::atomic<uint32_t> nextBatch{ 0 };
+	};
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "Device.h"
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Application
+{
+	// Copies data into device local buffers and images from a worker thread submitting to the
+	// transfer queue, so uploads overlap rendering instead of stalling the graphics queue. With
+	// a dedicated transfer family the resources are released by the transfer queue and acquired
+	// by the graphics queue at the start of the frame that first can use them.
+	class Uploader
+	{
+	public:
+		// Increases with every upload, uploads become available in ticket order
+		using Ticket = uint64_t;
+
+		Uploader(Device& device);
+		~Uploader();
+
+		Uploader(const Uploader&) = delete;
+		Uploader& operator=(const Uploader&) = delete;
+
+		// dstStages and dstAccess describe how the graphics queue uses the resource afterward.
+		// Buffers must be created with exclusive sharing, the graphics queue family owns them
+		// once available.
+		Ticket UploadBuffer(
+			VkBuffer buffer,
+			VkDeviceSize offset,
+			std::vector<uint8_t>&& data,
+			VkPipelineStageFlags dstStages,
+			VkAccessFlags dstAccess);
+		// regions offsets are relative to data, the image is left in finalLayout
+		Ticket UploadImage(
+			VkImage image,
+			const VkImageSubresourceRange& range,
+			std::vector<uint8_t>&& data,
+			std::vector<VkBufferImageCopy>&& regions,
+			VkImageLayout finalLayout,
+			VkPipelineStageFlags dstStages,
+			VkAccessFlags dstAccess);
+
+		// Hands the finished uploads to the graphics queue, recorded at the start of the frame's
+		// command buffer. Uploads still in flight are left for a later frame, the frame never waits.
+		void AcquireCompleted(VkCommandBuffer commandBuffer);
+
+		// The resource can be used by commands recorded after the AcquireCompleted that made it available
+		bool IsAvailable(Ticket ticket) const { return ticket <= availableTicket && GetError(ticket) == nullptr; }
+		// Why the upload never happened, null while it is pending and once it is available. A
+		// failed upload leaves the resource unwritten and owned by the graphics queue family.
+		const std::string* GetError(Ticket ticket) const;
+
+		// Runs destroy once the transfer queue is done with the upload and every frame that may
+		// use the resource has retired. Render thread only, like AcquireCompleted.
+		void DeferDestroy(Ticket ticket, std::function<void()>&& destroy);
+
+	private:
+		struct Request
+		{
+			Ticket ticket;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageSubresourceRange range{};
+			std::vector<uint8_t> data;
+			std::vector<VkBufferImageCopy> regions;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VkPipelineStageFlags dstStages;
+			VkAccessFlags dstAccess;
+		};
+
+		// One submission of every request queued at the time
+		struct Batch
+		{
+			uint64_t timelineValue;
+			VkCommandBuffer commandBuffer;
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingMemory;
+		};
+
+		// Graphics queue half of a batch, filled by the worker and consumed by AcquireCompleted.
+		// A batch that couldn't be submitted only carries its error.
+		struct PendingAcquire
+		{
+			uint64_t timelineValue;
+			Ticket firstTicket;
+			Ticket lastTicket;
+			std::string error;
+			VkPipelineStageFlags dstStages;
+			std::vector<VkBufferMemoryBarrier> bufferBarriers;
+			std::vector<VkImageMemoryBarrier> imageBarriers;
+		};
+
+		struct Failure
+		{
+			Ticket firstTicket;
+			Ticket lastTicket;
+			std::string error;
+		};
+
+		struct PendingDestroy
+		{
+			Ticket ticket;
+			std::function<void()> destroy;
+		};
+
+		Ticket Enqueue(Request&& request);
+		void WorkerLoop();
+		// Fills batch as it goes, the caller destroys it when this throws
+		void Submit(std::vector<Request>& requests, Batch& batch);
+		void ReleaseCompletedBatches();
+		void DestroyBatch(const Batch& batch);
+
+		Device& device;
+		VkCommandPool commandPool;
+		VkSemaphore timeline;
+		// Queue shared with the render thread, submits take the device queue lock
+		bool sharedQueue;
+
+		// Worker thread only
+		uint64_t submittedValue = 0;
+		std::deque<Batch> batches;
+
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<Request> requests;
+		std::deque<PendingAcquire> pendingAcquires;
+		Ticket nextTicket = 1;
+		bool stopWorker = false;
+
+		// Render thread only, availableTicket covers the failed uploads too
+		Ticket availableTicket = 0;
+		std::vector<Failure> failures;
+		std::vector<PendingDestroy> pendingDestroys;
+	};
+}
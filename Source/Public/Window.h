@@ -3,6 +3,7 @@
 #include <GLFW/glfw3.h>
 
 #include <string>
+#include <unordered_set>
 
 namespace Application
 {
@@ -19,17 +20,24 @@ namespace Application
 		void CreateWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 		bool WasWindowResized() { return frameBufferResized; }
 		void ResetWindowResizedFlag() { frameBufferResized = false; }
+		// True once when key was pressed since the last call or ClearKeyPresses
+		bool ConsumeKeyPress(int key);
+		// Drops the presses nobody consumed, called once per frame after input handling so they
+		// don't fire in a later frame
+		void ClearKeyPresses() { pressedKeys.clear(); }
 		VkExtent2D GetExtend() 
 		{ 
 			return { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; 
 		}
 	private:
 		static void FrameBufferResizeCallback(GLFWwindow* window, int width, int height);
+		static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 		void InitWindow();
 
 		int width;
 		int height;
 		bool frameBufferResized = false;
+		std::unordered_set<int> pressedKeys;
 
 		std::string windowName;
 		GLFWwindow* window;
@@ -1,3 +1,26 @@
-C:\VulkanSDK\1.3.268.0\Bin\glslc.exe Resources\Shaders\SimpleShader.vert -o Resources\Shaders\SimpleShader.vert.spv
-C:\VulkanSDK\1.3.268.0\Bin\glslc.exe Resources\Shaders\SimpleShader.frag -o Resources\Shaders\SimpleShader.frag.spv
-pause
\ No newline at end of file
+@echo off
+rem Compiles every shader and validates the result, stops at the first failure so a build never
+rem runs with stale or missing binaries
+set GLSLC=C:\VulkanSDK\1.3.268.0\Bin\glslc.exe
+set SPIRV_VAL=C:\VulkanSDK\1.3.268.0\Bin\spirv-val.exe
+set SHADERS=%~dp0Resources\Shaders
+
+call :Compile SimpleShader.vert || exit /b 1
+call :Compile SimpleShader.frag || exit /b 1
+call :Compile BindlessShader.vert || exit /b 1
+call :Compile BindlessShader.frag || exit /b 1
+call :Compile ParticleSimulate.comp || exit /b 1
+call :Compile ParticleCompact.comp || exit /b 1
+call :Compile ParticleEmit.comp || exit /b 1
+call :Compile Particle.vert || exit /b 1
+call :Compile Particle.frag || exit /b 1
+call :Compile Sprite.vert || exit /b 1
+call :Compile Sprite.frag || exit /b 1
+call :Compile SpriteBindless.frag || exit /b 1
+pause
+exit /b 0
+
+:Compile
+%GLSLC% --target-env=vulkan1.2 %SHADERS%\%1 -o %SHADERS%\%1.spv || exit /b 1
+%SPIRV_VAL% --target-env vulkan1.2 %SHADERS%\%1.spv || exit /b 1
+exit /b 0
\ No newline at end of file